@@ -21,6 +21,10 @@ int Find_First_Free_Bit(void *bitSet, ulong_t totalBits);
 int Find_First_N_Free(void *bitSet, uint_t runLength, ulong_t totalBits);
 void Destroy_Bit_Set(void *bitSet);
 
+#ifdef BITSET_BENCHMARK
+void Bit_Set_Benchmark(void);
+#endif
+
 #if 0
 struct Bit_Set {
     int size;
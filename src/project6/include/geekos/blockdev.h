@@ -15,6 +15,7 @@
 #include <geekos/kthread.h>
 #include <geekos/list.h>
 #include <geekos/fileio.h>
+#include <geekos/workqueue.h>
 
 #ifdef GEEKOS
 
@@ -46,10 +47,13 @@ struct Block_Request {
     struct Block_Device *dev;
     enum Request_Type type;
     int blockNum;
+    int numBlocks;			 /* Number of consecutive blocks to transfer */
     void *buf;
     volatile enum Request_State state;
     volatile int errorCode;
     struct Thread_Queue waitQueue;
+    enum Request_State completedState;	 /* state to enter when completion runs */
+    struct Work_Item completionWork;
 
     DEFINE_LINK(Block_Request_List, Block_Request);
 };
@@ -105,6 +109,8 @@ void Notify_Request_Completion(struct Block_Request *request, enum Request_State
  */
 int Block_Read(struct Block_Device *dev, int blockNum, void *buf);
 int Block_Write(struct Block_Device *dev, int blockNum, void *buf);
+int Block_Read_Multiple(struct Block_Device *dev, int blockNum, int numBlocks, void *buf);
+int Block_Write_Multiple(struct Block_Device *dev, int blockNum, int numBlocks, void *buf);
 int Get_Num_Blocks(struct Block_Device *dev);
 
 /*
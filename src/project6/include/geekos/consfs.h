@@ -14,6 +14,7 @@ struct File;
 
 struct File *Open_Console_Input(void);
 struct File *Open_Console_Output(void);
+struct File *Open_Serial_Output(void);
 
 #endif /* GEEKOS_CONSFS_H */
 
@@ -0,0 +1,148 @@
+/*
+ * Low level processor access routines
+ * $Revision: 1.1 $
+ * 
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#ifndef GEEKOS_CPU_H
+#define GEEKOS_CPU_H
+
+#include <geekos/ktypes.h>
+
+/*
+ * Read the processor's time stamp counter,
+ * which counts clock cycles since reset.
+ */
+static __inline__ unsigned long long Read_TSC(void)
+{
+    unsigned long long tsc;
+    __asm__ __volatile__ ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+/*
+ * Divide a 64 bit value by a 32 bit one, without needing
+ * the compiler's 64 bit division support routines.
+ */
+static __inline__ unsigned long long Div_64_32(unsigned long long dividend, ulong_t divisor)
+{
+    ulong_t hi = (ulong_t) (dividend >> 32), lo = (ulong_t) dividend;
+    ulong_t quotHi = hi / divisor, quotLo, rem;
+
+    /* The high word's remainder is less than divisor, so divl can't overflow */
+    hi %= divisor;
+    __asm__ ("divl %4" : "=a" (quotLo), "=d" (rem) : "a" (lo), "d" (hi), "rm" (divisor));
+    return ((unsigned long long) quotHi << 32) | quotLo;
+}
+
+/*
+ * Feature bits reported in EDX by CPUID leaf 1.
+ */
+#define CPUID_FEATURE_TSC	(1 << 4)
+#define CPUID_FEATURE_SEP	(1 << 11)	 /* sysenter/sysexit */
+
+/*
+ * Model specific registers used to set up sysenter.
+ */
+#define MSR_SYSENTER_CS		0x174
+#define MSR_SYSENTER_ESP	0x175
+#define MSR_SYSENTER_EIP	0x176
+
+/*
+ * Execute the CPUID instruction for given leaf.
+ */
+static __inline__ void Get_CPUID(ulong_t leaf, ulong_t *eax, ulong_t *ebx, ulong_t *ecx, ulong_t *edx)
+{
+    __asm__ __volatile__ ("cpuid"
+	: "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+	: "a" (leaf));
+}
+
+/*
+ * Determine whether the processor supports CPUID.
+ * It does if the ID bit (21) of EFLAGS can be toggled.
+ */
+static __inline__ bool Has_CPUID(void)
+{
+    ulong_t before, after;
+
+    __asm__ __volatile__ (
+	"pushfl\n\t"
+	"popl %0\n\t"
+	"movl %0, %1\n\t"
+	"xorl $0x200000, %1\n\t"
+	"pushl %1\n\t"
+	"popfl\n\t"
+	"pushfl\n\t"
+	"popl %1\n\t"
+	"pushl %0\n\t"
+	"popfl"
+	: "=&r" (before), "=&r" (after));
+    return ((before ^ after) & 0x200000) != 0;
+}
+
+/*
+ * Determine whether the processor has a time stamp counter.
+ */
+static __inline__ bool Has_TSC(void)
+{
+    ulong_t eax, ebx, ecx, edx;
+
+    if (!Has_CPUID())
+	return false;
+    Get_CPUID(0, &eax, &ebx, &ecx, &edx);
+    if (eax < 1)
+	return false;
+    Get_CPUID(1, &eax, &ebx, &ecx, &edx);
+    return (edx & CPUID_FEATURE_TSC) != 0;
+}
+
+/*
+ * Determine whether the processor has working sysenter/sysexit
+ * instructions.  Early Pentium Pro steppings report the feature
+ * but don't implement it.
+ */
+static __inline__ bool Has_Sysenter(void)
+{
+    ulong_t eax, ebx, ecx, edx;
+    ulong_t family, model, stepping;
+
+    if (!Has_CPUID())
+	return false;
+    Get_CPUID(0, &eax, &ebx, &ecx, &edx);
+    if (eax < 1)
+	return false;
+    Get_CPUID(1, &eax, &ebx, &ecx, &edx);
+    if ((edx & CPUID_FEATURE_SEP) == 0)
+	return false;
+
+    family = (eax >> 8) & 0xf;
+    model = (eax >> 4) & 0xf;
+    stepping = eax & 0xf;
+    return !(family == 6 && model < 3 && stepping < 3);
+}
+
+/*
+ * Write a model specific register.
+ */
+static __inline__ void Write_MSR(ulong_t msr, unsigned long long value)
+{
+    __asm__ __volatile__ ("wrmsr"
+	:
+	: "c" (msr), "a" ((ulong_t) value), "d" ((ulong_t) (value >> 32)));
+}
+
+/*
+ * Enable interrupts and halt the processor until one arrives.
+ * The sti instruction delays interrupts until after the
+ * following instruction, so an interrupt arriving between
+ * the two still wakes the hlt.
+ */
+static __inline__ void Enable_Interrupts_And_Halt(void)
+{
+    __asm__ __volatile__ ("sti; hlt");
+}
+
+#endif  /* GEEKOS_CPU_H */
@@ -4,7 +4,23 @@
 #include <stddef.h>
 #include <geekos/ktypes.h>
 
+/*
+ * Running state for computing a CRC over data
+ * supplied in pieces.
+ */
+struct CRC32_Context {
+    ulong_t crc;
+};
+
 void Init_CRC32(void);
 ulong_t crc32(ulong_t crc, char const *buf, size_t len);
 
+void CRC32_Init(struct CRC32_Context *ctx);
+void CRC32_Update(struct CRC32_Context *ctx, const void *buf, size_t len);
+ulong_t CRC32_Final(struct CRC32_Context *ctx);
+
+#ifdef CRC32_BENCHMARK
+void CRC32_Benchmark(void);
+#endif
+
 #endif /* GEEKOS_CRC32_H */
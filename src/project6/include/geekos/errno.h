@@ -33,5 +33,7 @@
 #define ENOSPACE		-16	 /* Out of space on device */
 #define EPIPE			-17	 /* Pipe has no reader */
 #define ENOEXEC			-18	 /* Invalid executable format */
+#define ETIMEDOUT		-19	 /* Timed out */
+#define ECHECKSUM		-20	 /* Checksum mismatch */
 
 #endif  /* GEEKOS_ERRNO_H */
@@ -80,4 +80,51 @@ struct VFS_Mount_Request {
     char fstype[VFS_MAX_FS_NAME_LEN+1];	/* Filesystem type: e.g., "gosfs". */
 };
 
+/*
+ * One buffer of a Read_Vector() or Write_Vector() request.
+ */
+struct IO_Vector {
+    void *buf;
+    ulong_t len;
+};
+
+/* Most buffers a single vector request may have. */
+#define IO_VECTOR_MAX 16
+
+/*
+ * Submission and completion rings, for running a batch of
+ * file system calls with a single IO_Ring_Enter() system call.
+ * The process queues operations at sqTail and takes results
+ * from cqHead; the kernel consumes operations at sqHead and
+ * posts results at cqTail.  Indices run freely and are
+ * reduced modulo IO_RING_ENTRIES.
+ */
+#define IO_RING_ENTRIES 32	/* must be a power of 2 */
+
+/*
+ * A queued operation: the system call number and register
+ * arguments it would be called with.
+ */
+struct IO_Ring_SQE {
+    int op;
+    ulong_t args[5];
+    ulong_t userData;		/* copied to the completion */
+};
+
+struct IO_Ring_CQE {
+    int result;			/* the system call's return value */
+    ulong_t userData;
+};
+
+struct IO_Ring_Indices {
+    ulong_t sqHead, sqTail;
+    ulong_t cqHead, cqTail;
+};
+
+struct IO_Ring {
+    struct IO_Ring_Indices indices;
+    struct IO_Ring_SQE sq[IO_RING_ENTRIES];
+    struct IO_Ring_CQE cq[IO_RING_ENTRIES];
+};
+
 #endif
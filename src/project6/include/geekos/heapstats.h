@@ -0,0 +1,46 @@
+/*
+ * Kernel heap statistics
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#ifndef GEEKOS_HEAPSTATS_H
+#define GEEKOS_HEAPSTATS_H
+
+/*
+ * Number of size classes for small kernel heap objects.
+ * Larger allocations are made from whole pages.
+ */
+#define HEAP_NUM_CLASSES	14
+
+/*
+ * Usage of one size class.
+ */
+struct Heap_Class_Stats {
+    unsigned long objectSize;		 /* Size of objects in this class */
+    unsigned long slabPages;		 /* Pages carved into objects of this size */
+    unsigned long objectsInUse;		 /* Objects currently allocated */
+    unsigned long peakObjects;		 /* Most objects ever allocated at once */
+};
+
+/*
+ * Kernel heap usage, for the Get_Heap_Stats() system call.
+ * Bytes in use are counted by size class, so the difference
+ * between them and the pages held shows fragmentation.
+ */
+struct Heap_Stats {
+    unsigned long heapPages;		 /* Pages currently held by the heap */
+    unsigned long peakHeapPages;	 /* Most pages ever held */
+    unsigned long bytesInUse;		 /* Bytes allocated, rounded up to size class or page */
+    unsigned long peakBytesInUse;	 /* Most bytes ever allocated at once */
+    unsigned long largeAllocs;		 /* Page-backed allocations currently live */
+    unsigned long largePages;		 /* Pages used by them */
+    unsigned long mallocCalls;		 /* Successful Malloc() calls */
+    unsigned long freeCalls;		 /* Free() calls */
+    unsigned long failedCalls;		 /* Malloc() calls which ran out of memory */
+    struct Heap_Class_Stats classes[HEAP_NUM_CLASSES];
+};
+
+#endif  /* GEEKOS_HEAPSTATS_H */
@@ -100,6 +100,29 @@ void Init_Interrupts(void);
  */
 bool Interrupts_Enabled(void);
 
+/*
+ * Interrupts-disabled interval tracing.  Build with
+ * KERNEL_DEFS=-DTRACE_IRQS_OFF to record the longest interval
+ * between disabling and re-enabling interrupts, and where it began.
+ */
+struct Irqs_Off_Stats {
+    unsigned long long maxCycles;	 /* longest interval, in TSC cycles */
+    const char *file;			 /* ...where it began */
+    int line;
+    ulong_t eip;
+    ulong_t numIntervals;		 /* intervals measured */
+};
+
+#ifdef TRACE_IRQS_OFF
+void Trace_Interrupts_Off(const char *file, int line);
+void Trace_Interrupts_On(void);
+void Get_Irqs_Off_Stats(struct Irqs_Off_Stats *stats);
+void Print_Irqs_Off_Stats(void);
+#else
+#  define Trace_Interrupts_Off(file, line)
+#  define Trace_Interrupts_On()
+#endif
+
 /*
  * Block interrupts.
  */
@@ -111,6 +134,7 @@ static __inline__ void __Disable_Interrupts(void)
 do {					\
     KASSERT(Interrupts_Enabled());	\
     __Disable_Interrupts();		\
+    Trace_Interrupts_Off(__FILE__, __LINE__); \
 } while (0)
 
 /*
@@ -123,6 +147,7 @@ static __inline__ void __Enable_Interrupts(void)
 #define Enable_Interrupts()		\
 do {					\
     KASSERT(!Interrupts_Enabled());	\
+    Trace_Interrupts_On();		\
     __Enable_Interrupts();		\
 } while (0)
 
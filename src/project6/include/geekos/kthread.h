@@ -12,6 +12,7 @@
 
 #include <geekos/ktypes.h>
 #include <geekos/list.h>
+#include <geekos/sched.h>
 
 struct Kernel_Thread;
 struct User_Context;
@@ -41,7 +42,7 @@ struct Kernel_Thread {
     int priority;
     DEFINE_LINK(Thread_Queue, Kernel_Thread);
     void* stackPage;
-    struct User_Context* userContext;
+    struct User_Context* userContext;	 /* offset 24 */
     struct Kernel_Thread* owner;
     int refCount;
 
@@ -66,6 +67,22 @@ struct Kernel_Thread {
      */
     int currentReadyQueue;
     bool blocked;
+
+    /* CPU accounting, in nanoseconds since boot. */
+    unsigned long long runtime;		 /* CPU time used */
+    unsigned long long execStart;	 /* when it last got the CPU */
+    unsigned long long createTime;
+    unsigned long long firstRunTime;	 /* 0 until it first runs */
+
+    /*
+     * SCHED_FAIR state: CPU time used, scaled by the weight for the
+     * thread's nice value, and links in the leftist heap of runnable
+     * threads ordered by it.
+     */
+    int nice;
+    unsigned long long vruntime;
+    struct Kernel_Thread *heapLeft, *heapRight;
+    int heapRank;
 };
 
 /*
@@ -117,6 +134,9 @@ void Make_Runnable_Atomic(struct Kernel_Thread* kthread);
 struct Kernel_Thread* Get_Current(void);
 struct Kernel_Thread* Get_Next_Runnable(void);
 void Schedule(void);
+int Set_Scheduling_Policy(int policy, int quantum);
+int Set_Nice(struct Kernel_Thread* kthread, int nice);
+void Get_Process_Times(struct Kernel_Thread* kthread, struct Process_Times* times);
 void Yield(void);
 void Exit(int exitCode) __attribute__ ((noreturn));
 int Join(struct Kernel_Thread* kthread);
@@ -131,6 +151,8 @@ void Switch_To_Thread(struct Kernel_Thread*);
  * Wait queue functions.
  */
 void Wait(struct Thread_Queue* waitQueue);
+int Wait_Timeout(struct Thread_Queue* waitQueue, int us);
+int Sleep(int us);
 void Wake_Up(struct Thread_Queue* waitQueue);
 void Wake_Up_One(struct Thread_Queue* waitQueue);
 
@@ -144,6 +166,11 @@ extern struct Kernel_Thread* g_currentThread;
  */
 extern int g_needReschedule;
 
+/*
+ * Current scheduling policy (SCHED_RR, SCHED_MLF, or SCHED_FAIR).
+ */
+extern int g_schedulingPolicy;
+
 /*
  * Boolean flag indicating that preemption should be disabled.
  */
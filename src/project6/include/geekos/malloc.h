@@ -1,7 +1,7 @@
 /*
  * GeekOS memory allocation API
  * Copyright (c) 2001, David H. Hovemeyer <daveho@cs.umd.edu>
- * $Revision: 1.9 $
+ * $Revision: 1.10 $
  * 
  * This is free software.  You are permitted to use,
  * redistribute, and modify it as specified in the file "COPYING".
@@ -11,9 +11,11 @@
 #define GEEKOS_MALLOC_H
 
 #include <geekos/ktypes.h>
+#include <geekos/heapstats.h>
 
-void Init_Heap(ulong_t start, ulong_t size);
+void Init_Heap(void);
 void* Malloc(ulong_t size);
 void Free(void* buf);
+void Get_Heap_Stats(struct Heap_Stats *stats);
 
 #endif  /* GEEKOS_MALLOC_H */
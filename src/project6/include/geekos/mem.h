@@ -29,6 +29,8 @@ struct Boot_Info;
 #define PAGE_HEAP      0x0010	 /* page is in kernel heap */
 #define PAGE_PAGEABLE  0x0020	 /* page can be paged out */
 #define PAGE_LOCKED    0x0040    /* page is taken should not be freed */
+#define PAGE_ZEROED    0x0080	 /* free page is on the pre-zeroed list */
+#define PAGE_SLAB      0x0100	 /* heap page holds small objects */
 
 /*
  * PC memory map
@@ -43,9 +45,27 @@ struct Boot_Info;
 #define HIGHMEM_START (ISA_HOLE_END + 8192)
 
 /*
- * Make the kernel heap this size
+ * Number of free pages that pageable pages never take, so the
+ * kernel heap can still grow when memory is short.  Pageable pages
+ * are paged out to make room instead, and the swap code itself
+ * allocates from the heap while doing that.
  */
-#define KERNEL_HEAP_SIZE (1024*1024)
+#define KERNEL_HEAP_RESERVE_PAGES 64
+
+/*
+ * Number of pre-zeroed pages the idle thread tries to keep on hand.
+ */
+#define ZEROED_POOL_TARGET 64
+
+/*
+ * Pre-zeroed page pool counters.
+ */
+struct Zeroed_Page_Stats {
+    ulong_t poolHits;		 /* Alloc_Zeroed_Page() calls satisfied from the pool */
+    ulong_t poolMisses;		 /* ...and those which had to clear a page */
+    ulong_t pagesZeroed;	 /* Pages cleared ahead of time */
+    ulong_t poolPages;		 /* Pages currently in the pool */
+};
 
 struct Page;
 
@@ -71,8 +91,19 @@ IMPLEMENT_LIST(Page_List, Page);
 void Init_Mem(struct Boot_Info* bootInfo);
 void Init_BSS(void);
 void* Alloc_Page(void);
+void* Alloc_Zeroed_Page(void);
+bool Refill_Zeroed_Page_Pool(void);
+void Get_Zeroed_Page_Stats(struct Zeroed_Page_Stats *stats);
 void* Alloc_Pageable_Page(pte_t *entry, ulong_t vaddr);
+void* Alloc_Pageable_Zeroed_Page(pte_t *entry, ulong_t vaddr);
 void Free_Page(void* pageAddr);
+void* Alloc_Pages(int numPages);
+void Free_Pages(void* pageAddr, int numPages);
+void Wait_For_Page_Out(void);
+
+#ifdef STRING_BENCHMARK
+void String_Benchmark(void);
+#endif
 
 /*
  * Determine if given address is a multiple of the page size.
@@ -85,14 +85,62 @@ typedef struct {
 } faultcode_t;
 
 /*
- * Bits used in the kernelInfo field of the PTE's:
+ * Values used in the kernelInfo field of the PTE's:
  */
 #define KINFO_PAGE_ON_DISK	0x4	 /* Page not present; contents in paging file */
+#define KINFO_PAGE_PAGING_OUT	0x3	 /* Page not present; still in memory, being evicted */
+#define KINFO_PAGE_COMPRESSED	0x2	 /* Page not present; contents in compressed pool */
+#define KINFO_PAGE_SHARED	0x1	 /* Kernel page shared by all processes; never freed */
+
+/*
+ * Maximum number of pages moved to or from the paging file
+ * by a single block request.  Victim pages are evicted in
+ * clusters of virtually adjacent pages, and page faults read
+ * ahead the rest of the cluster.
+ */
+#define PAGING_CLUSTER_MAX	8
+
+/*
+ * Paging file activity counters.
+ */
+struct Paging_Stats {
+    ulong_t pagesOut;		 /* Pages written to the paging file */
+    ulong_t pagesIn;		 /* Pages read from the paging file */
+    ulong_t writeOps;		 /* Block requests used to write them */
+    ulong_t readOps;		 /* Block requests used to read them */
+    ulong_t readaheadPages;	 /* Pages read in ahead of a fault */
+    ulong_t diskFaults;		 /* Faults satisfied from the paging file */
+    ulong_t diskFaultUsecs;	 /* Time spent in them, in microseconds */
+    ulong_t zswapFaults;	 /* Faults satisfied from the compressed pool */
+    ulong_t zswapFaultUsecs;	 /* Time spent in them, in microseconds */
+    ulong_t checksumErrors;	 /* Pages read back with the wrong checksum */
+};
+
+/*
+ * The kernel's own page directory, which kernel threads use
+ * when no user address space is active.
+ */
+extern pde_t *g_kernelPageDir;
+
+/*
+ * If nonzero when paging is initialized, a CRC of each page
+ * written to the paging file is kept, and checked when the
+ * page is read back.
+ */
+extern int g_checksumPagingFile;
 
 void Init_VM(struct Boot_Info *bootInfo);
 void Init_Paging(void);
 
+/*
+ * Above this many pages, flushing a range of the TLB one
+ * page at a time costs more than reloading cr3.
+ */
+#define TLB_FLUSH_RANGE_THRESHOLD 32
+
 extern void Flush_TLB(void);
+extern void Flush_TLB_Page(ulong_t vaddr);
+void Flush_TLB_Range(ulong_t vaddr, ulong_t numPages);
 extern void Set_PDBR(pde_t *pageDir);
 extern pde_t *Get_PDBR(void);
 extern void Enable_Paging(pde_t *pageDir);
@@ -114,6 +162,11 @@ int Find_Space_On_Paging_File(void);
 void Free_Space_On_Paging_File(int pagefileIndex);
 void Write_To_Paging_File(void *paddr, ulong_t vaddr, int pagefileIndex);
 void Read_From_Paging_File(void *paddr, ulong_t vaddr, int pagefileIndex);
+int Find_Run_On_Paging_File(int numPages);
+int Write_Cluster_To_Paging_File(void *paddrs[], int numPages, int pagefileIndex);
+int Read_Cluster_From_Paging_File(void *paddrs[], int numPages, int pagefileIndex);
+void Get_Paging_Stats(struct Paging_Stats *stats);
+void Print_Paging_Stats(void);
 
 
 #endif
@@ -0,0 +1,37 @@
+/*
+ * Scheduling policies and process times
+ * $Revision: 1.1 $
+ * 
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#ifndef GEEKOS_SCHED_H
+#define GEEKOS_SCHED_H
+
+/*
+ * Scheduling policies, for Set_Scheduling_Policy().
+ */
+#define SCHED_RR		0	 /* round robin */
+#define SCHED_MLF		1	 /* multilevel feedback */
+#define SCHED_FAIR		2	 /* weighted virtual runtime */
+#define NUM_SCHED_POLICIES	3
+
+/*
+ * Range of nice values.  Under SCHED_FAIR, each step
+ * changes a thread's share of the CPU by about 10%.
+ */
+#define NICE_MIN		-20
+#define NICE_MAX		19
+
+/*
+ * Times for a process, in microseconds since boot.
+ */
+struct Process_Times {
+    unsigned long cpuTime;		 /* CPU time used */
+    unsigned long startTime;		 /* when it was created */
+    unsigned long firstRunTime;		 /* when it first ran */
+    unsigned long now;
+};
+
+#endif  /* GEEKOS_SCHED_H */
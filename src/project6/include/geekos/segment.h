@@ -87,4 +87,6 @@ void Init_LDT_Descriptor(
     int numEntries
 );
 
+void Load_LDTR(ushort_t selector);
+
 #endif  /* GEEKOS_SEGMENT_H */
@@ -0,0 +1,77 @@
+/*
+ * 16550 UART (serial port) driver
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#ifndef GEEKOS_SERIAL_H
+#define GEEKOS_SERIAL_H
+
+#include <geekos/ktypes.h>
+
+/* COM1 */
+#define SERIAL_BASE_PORT	0x3F8
+#define SERIAL_IRQ		4
+
+/*
+ * Registers, as offsets from the base port.
+ * DLL and DLM overlay THR and IER while LCR_DLAB is set.
+ */
+#define SERIAL_THR	0	 /* Transmit holding register (write) */
+#define SERIAL_RBR	0	 /* Receive buffer register (read) */
+#define SERIAL_DLL	0	 /* Divisor latch, low byte */
+#define SERIAL_IER	1	 /* Interrupt enable register */
+#define SERIAL_DLM	1	 /* Divisor latch, high byte */
+#define SERIAL_IIR	2	 /* Interrupt identification register (read) */
+#define SERIAL_FCR	2	 /* FIFO control register (write) */
+#define SERIAL_LCR	3	 /* Line control register */
+#define SERIAL_MCR	4	 /* Modem control register */
+#define SERIAL_LSR	5	 /* Line status register */
+#define SERIAL_MSR	6	 /* Modem status register */
+
+#define IER_RX_DATA	0x01	 /* Interrupt when data received */
+#define IER_THR_EMPTY	0x02	 /* Interrupt when transmitter empty */
+
+#define IIR_NO_INT	0x01	 /* No interrupt pending */
+#define IIR_ID_MASK	0x0E
+#define IIR_MSR		0x00	 /* Modem status changed */
+#define IIR_THR_EMPTY	0x02	 /* Transmitter empty */
+#define IIR_RX_DATA	0x04	 /* Data received */
+#define IIR_LSR		0x06	 /* Line status changed */
+#define IIR_RX_TIMEOUT	0x0C	 /* Data received, FIFO not at threshold */
+
+#define FCR_ENABLE	0x01	 /* Enable FIFOs */
+#define FCR_CLEAR_RX	0x02
+#define FCR_CLEAR_TX	0x04
+#define FCR_TRIGGER_14	0xC0	 /* Receive interrupt at 14 bytes */
+
+#define LCR_8N1		0x03	 /* 8 data bits, no parity, 1 stop bit */
+#define LCR_DLAB	0x80	 /* Divisor latch access */
+
+#define MCR_DTR		0x01
+#define MCR_RTS		0x02
+#define MCR_OUT2	0x08	 /* Connects the interrupt line on PCs */
+#define MCR_LOOPBACK	0x10
+
+#define LSR_DATA_READY	0x01
+#define LSR_THR_EMPTY	0x20
+
+/* Bytes the transmit FIFO holds */
+#define SERIAL_FIFO_SIZE 16
+
+/* Divisor of the 115200 baud base clock */
+#define SERIAL_DIVISOR	1
+
+#ifdef GEEKOS
+
+extern bool g_serialPresent;
+
+void Init_Serial(void);
+void Serial_Write(const char *buf, ulong_t length);
+void Serial_Flush(void);
+
+#endif  /* GEEKOS */
+
+#endif  /* GEEKOS_SERIAL_H */
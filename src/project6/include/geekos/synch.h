@@ -35,6 +35,7 @@ void Mutex_Unlock(struct Mutex* mutex);
 
 void Cond_Init(struct Condition* cond);
 void Cond_Wait(struct Condition* cond, struct Mutex* mutex);
+int Cond_Timed_Wait(struct Condition* cond, struct Mutex* mutex, int us);
 void Cond_Signal(struct Condition* cond);
 void Cond_Broadcast(struct Condition* cond);
 
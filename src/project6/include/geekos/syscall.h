@@ -33,6 +33,24 @@ extern const Syscall g_syscallTable[];
 
 #define SYSCALL "int $0x90"	 /* Assembly instruction for the system call trap. */
 
+/*
+ * Fast system call entry, used when the processor supports it.
+ * The kernel finds the return address on the user stack at ebp,
+ * and returns with esp pointing just above it.
+ * Other registers are passed and preserved as for SYSCALL.
+ */
+#define SYSENTER_SYSCALL	\
+    "pushl %%ebp\n\t"		\
+    "pushl $1f\n\t"		\
+    "movl %%esp, %%ebp\n\t"	\
+    "sysenter\n"		\
+    "1:\tpopl %%ebp"
+
+#if !defined(GEEKOS)
+/* Set by the program entry code if SYSENTER_SYSCALL can be used. */
+extern int g_useSysenter;
+#endif
+
 /*
  * System call numbers
  */
@@ -68,6 +86,20 @@ enum {
     SYS_SYNC,		 /* Sync filesystems system call  */
     SYS_FORMAT,		 /* Format filesystem system call  */
     SYS_CREATEPIPE,	 /* CreatePipe system call. */
+    SYS_GETMONOTONICTIME, /* Get nanoseconds since boot system call */
+    SYS_SLEEP,		 /* Sleep system call */
+    SYS_SETNICE,	 /* Set nice value system call */
+    SYS_GETPROCESSTIMES, /* Get process CPU times system call */
+    SYS_IORINGENTER,	 /* Run queued file operations system call */
+    SYS_GETHEAPSTATS,	 /* Get kernel heap statistics system call */
+    SYS_BRK,		 /* Move end of process heap system call */
+    SYS_SPLICE,		 /* Move data between open files system call */
+    SYS_READAT,		 /* Read at position system call */
+    SYS_WRITEAT,	 /* Write at position system call */
+    SYS_READVECTOR,	 /* Read into several buffers system call */
+    SYS_WRITEVECTOR,	 /* Write from several buffers system call */
+    SYS_PRINTPAGINGSTATS, /* Print swap tier statistics system call */
+    SYS_HASVDSO,	 /* Are kernel data pages mapped system call */
 };
 
 /*
@@ -84,6 +116,9 @@ enum {
  * edx - third argument [input]
  * esi - fourth argument [input]
  * edi - fifth argument [input]
+ *
+ * The kernel reads and writes user memory through pointer
+ * arguments, so the asm clobbers "memory".
  */
 
 #define SYSCALL_REGS_0
@@ -97,7 +132,10 @@ enum {
 retType name params {							\
     int sysNum = (num), rc;						\
     argDefs								\
-    __asm__ __volatile__ (SYSCALL : "=a" (rc) :"a" (sysNum) regs);	\
+    if (g_useSysenter)							\
+	__asm__ __volatile__ (SYSENTER_SYSCALL : "=a" (rc) :"a" (sysNum) regs : "memory"); \
+    else								\
+	__asm__ __volatile__ (SYSCALL : "=a" (rc) :"a" (sysNum) regs : "memory"); \
     return (retType) rc;						\
 }
 
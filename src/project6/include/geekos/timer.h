@@ -10,27 +10,89 @@
 #ifndef GEEKOS_TIMER_H
 #define GEEKOS_TIMER_H
 
+#include <geekos/ktypes.h>
+#include <geekos/list.h>
+
 #define TIMER_IRQ 0
 
+/*
+ * Timer interrupt frequency.  The PIT can tick at anything
+ * from 19 Hz up; build with KERNEL_DEFS=-DTIMER_HZ=<n> to change it.
+ */
+#ifndef TIMER_HZ
+#  define TIMER_HZ 100
+#endif
+
+#define NS_PER_TICK		(1000000000UL / TIMER_HZ)
+
+/*
+ * Convert milliseconds to timer ticks, rounding up.
+ */
+#define MS_TO_TICKS(ms)		(((ms) * TIMER_HZ + 999) / 1000)
+
+/*
+ * Convert microseconds to timer ticks, rounding up.
+ * Rounding is done unsigned, so any us from 0 to INT_MAX gives
+ * a tick count that fits in an int.
+ */
+#define US_PER_TICK		(1000000 / TIMER_HZ)
+#define US_TO_TICKS(us)		((int) (((ulong_t) (us) + US_PER_TICK - 1) / US_PER_TICK))
+
 extern volatile ulong_t g_numTicks;
 
+/*
+ * Scheduling quantum, in ticks.
+ */
+extern int g_Quantum;
+#define MAX_QUANTUM		(TIMER_HZ * 10)
+
 typedef void (*timerCallback)(int);
+typedef void (*timerContextCallback)(int, void*);
 
 void Init_Timer(void);
 
 void Micro_Delay(int us);
 
-typedef struct {
-    int ticks;				 /* timer code decrements this */
+unsigned long long Get_Monotonic_Time_NS(void);
+unsigned long long Cycles_To_NS(unsigned long long cycles);
+ulong_t Get_TSC_KHz(void);
+
+struct timerEvent;
+DEFINE_LIST(Timer_Event_List, timerEvent);
+DEFINE_LIST(Timer_Id_List, timerEvent);
+
+typedef struct timerEvent {
+    ulong_t expires;			 /* tick on which the timer fires */
     int id;				 /* unqiue id for this timer even */
     timerCallback callBack;		 /* Queue to wakeup on timer expire */
+    timerContextCallback contextCallBack; /* ...or called with context */
+    void *context;
     int origTicks;
+    struct Timer_Event_List *list;	 /* timer wheel slot holding the event */
+    DEFINE_LINK(Timer_Event_List, timerEvent);
+    DEFINE_LINK(Timer_Id_List, timerEvent);
 } timerEvent;
 
+/*
+ * Idle and tickless counters.
+ */
+struct Timer_Idle_Stats {
+    ulong_t idleHalts;			 /* Times the idle thread halted the CPU */
+    ulong_t ticklessSleeps;		 /* ...with the periodic tick stopped */
+    ulong_t ticksSkipped;		 /* Ticks that elapsed without an interrupt */
+};
+
+void Timer_Enter_Idle(void);
+void Timer_Exit_Idle(void);
+void Get_Timer_Idle_Stats(struct Timer_Idle_Stats *stats);
+
 int Start_Timer(int ticks, timerCallback);
+int Start_Timer_With_Context(int ticks, timerContextCallback, void *context);
 int Get_Remaing_Timer_Ticks(int id);
 int Cancel_Timer(int id);
 
-void Micro_Delay(int us);
+#ifdef TIMER_STRESS_TEST
+void Timer_Stress_Test(void);
+#endif
 
 #endif  /* GEEKOS_TIMER_H */
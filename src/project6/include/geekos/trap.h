@@ -10,6 +10,11 @@
 #ifndef GEEKOS_TRAP_H
 #define GEEKOS_TRAP_H
 
+#include <geekos/ktypes.h>
+
+struct Interrupt_State;
+
 void Init_Traps(void);
+void Sysenter_Handler(struct Interrupt_State* state);
 
 #endif  /* GEEKOS_TRAP_H */
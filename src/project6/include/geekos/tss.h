@@ -83,6 +83,8 @@ struct TSS {
     ushort_t ioMapBase;
 };
 
+extern ulong_t g_kernelStackTop;
+
 void Init_TSS(void);
 void Set_Kernel_Stack_Pointer(ulong_t esp0);
 
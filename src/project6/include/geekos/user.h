@@ -17,10 +17,24 @@
 #include <geekos/paging.h>
 
 struct File;
+struct VDSO_Process_Data;
 
 /* Number of files user process can have open. */
 #define USER_MAX_FILES		10
 
+/*
+ * User code and data segments start at this linear address;
+ * add it to a user address to get the linear address.
+ */
+#define USER_SEGMENT_BASE	0x80000000UL
+
+/*
+ * The heap may not grow to within this many bytes of the
+ * kernel data pages at the top of the address space, so
+ * that there is always room for the stack.
+ */
+#define USER_STACK_RESERVE	(1024 * 1024)
+
 /*
  * A user mode context which can be attached to a Kernel_Thread,
  * to allow it to execute in user mode (ring 3).  This struct
@@ -57,6 +71,9 @@ struct User_Context {
     /* Page directory for user address space. */
     pde_t *pageDir;
 
+    /* Kernel address of the process's read-only data page (see vdso.h) */
+    struct VDSO_Process_Data *vdsoData;
+
     /* Code entry point */
     ulong_t entryAddr;
 
@@ -66,6 +83,17 @@ struct User_Context {
     /* Initial stack pointer */
     ulong_t stackPointerAddr;
 
+    /*
+     * User addresses of the start and end of the heap, which
+     * follows the data segment.  Heap pages are allocated when
+     * first touched (see Map_User_Heap_Page()).
+     */
+    ulong_t heapStart;
+    ulong_t heapEnd;
+
+    /* Open files, indexed by file descriptor (null if not in use) */
+    struct File *fileList[USER_MAX_FILES];
+
     /*
      * May use this in future to allow multiple threads
      * in the same user context
@@ -102,6 +130,8 @@ int Load_User_Program(char *exeFileData, ulong_t exeFileLength,
 bool Copy_From_User(void* destInKernel, ulong_t srcInUser, ulong_t bufSize);
 bool Copy_To_User(ulong_t destInUser, void* srcInKernel, ulong_t bufSize);
 void Switch_To_Address_Space(struct User_Context *userContext);
+int Set_User_Heap_End(struct User_Context *userContext, ulong_t newEnd);
+int Map_User_Heap_Page(struct User_Context *userContext, ulong_t vaddr);
 
 
 #endif  /* GEEKOS_USER_H */
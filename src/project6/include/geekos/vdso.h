@@ -0,0 +1,59 @@
+/*
+ * Kernel data pages mapped read-only into user processes
+ * $Revision: 1.1 $
+ * 
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#ifndef GEEKOS_VDSO_H
+#define GEEKOS_VDSO_H
+
+/*
+ * User address of the pages.  The first is shared by all
+ * processes and kept up to date by the kernel; the second
+ * belongs to the process.  libc reads them instead of making
+ * system calls for the time and the process id, if the kernel
+ * could map them.
+ */
+#define VDSO_USER_ADDR		0x7FFFE000
+#define VDSO_NUM_PAGES		2
+
+struct VDSO_Time_Data {
+    volatile unsigned long ticks;	 /* timer ticks since boot */
+    unsigned long nsPerTick;
+
+    /*
+     * If haveTSC is set, nanoseconds since boot are
+     * ((tsc - tscBoot) * tscMult) >> tscShift.
+     */
+    int haveTSC;
+    unsigned long tscMult;
+    unsigned long tscShift;
+    unsigned long long tscBoot;
+};
+
+struct VDSO_Process_Data {
+    int pid;
+};
+
+#define VDSO_TIME_DATA		((const struct VDSO_Time_Data*) VDSO_USER_ADDR)
+#define VDSO_PROCESS_DATA	((const struct VDSO_Process_Data*) (VDSO_USER_ADDR + 4096))
+
+#if !defined(GEEKOS)
+/* Set by the program entry code if the pages are mapped. */
+extern int g_haveVDSO;
+#endif
+
+#if defined(GEEKOS)
+
+struct User_Context;
+
+extern struct VDSO_Time_Data *g_vdsoTimeData;
+
+void Init_VDSO(void);
+int Map_VDSO(struct User_Context *userContext);
+
+#endif  /* defined(GEEKOS) */
+
+#endif  /* GEEKOS_VDSO_H */
@@ -86,6 +86,20 @@ struct File_Ops {
     int (*Close)(struct File *file);
     int (*Read_Entry)(struct File *dir, struct VFS_Dir_Entry *entry);  /* Read next directory entry. */
     int (*Clone)(struct File *file, struct File **pClone); /* Create a new File for underlying data source. */
+    /*
+     * Optional: point at up to numBytes of kernel memory holding the
+     * file's data from the current position, without copying it or
+     * moving the position.  Returns number of bytes available there,
+     * 0 at end of file, or error code (< 0).
+     */
+    int (*Map_Data)(struct File *file, ulong_t numBytes, void **pData);
+    /*
+     * Optional: read or write at given position, without using or
+     * moving the current position.  Files without them are served
+     * by a Seek() and Read() or Write() pair.
+     */
+    int (*Read_At)(struct File *file, ulong_t pos, void *buf, ulong_t numBytes);
+    int (*Write_At)(struct File *file, ulong_t pos, void *buf, ulong_t numBytes);
 };
 
 /*
@@ -123,6 +137,11 @@ int FStat(struct File *file, struct VFS_File_Stat *stat);
 int Read(struct File *file, void *buf, ulong_t len);
 int Write(struct File *file, void *buf, ulong_t len);
 int Read_Fully(const char *path, void **pBuffer, ulong_t *pLen);
+int Splice(struct File *in, struct File *out, ulong_t len);
+int Read_At(struct File *file, ulong_t pos, void *buf, ulong_t len);
+int Write_At(struct File *file, ulong_t pos, void *buf, ulong_t len);
+int Read_Vector(struct File *file, const struct IO_Vector *vec, int count);
+int Write_Vector(struct File *file, const struct IO_Vector *vec, int count);
 int Clone_File(struct File *file, struct File **pClone);
 
 /* Directory operations. */
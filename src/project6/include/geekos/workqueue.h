@@ -0,0 +1,58 @@
+/*
+ * Deferred work
+ * $Revision: 1.1 $
+ * 
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#ifndef GEEKOS_WORKQUEUE_H
+#define GEEKOS_WORKQUEUE_H
+
+#include <geekos/ktypes.h>
+#include <geekos/list.h>
+
+/*
+ * Work queue priorities.  Higher priority work is always
+ * run first.
+ */
+enum {
+    WORK_PRIORITY_HIGH,			 /* timer expiry */
+    WORK_PRIORITY_NORMAL,		 /* I/O completion */
+    NUM_WORK_PRIORITIES
+};
+
+typedef void (*Work_Func)(ulong_t arg);
+
+struct Work_Item;
+DEFINE_LIST(Work_List, Work_Item);
+
+/*
+ * A piece of work to be run later, in thread context.
+ * Work items are embedded in the structures they work on,
+ * so queueing one never needs to allocate memory.
+ */
+struct Work_Item {
+    Work_Func func;
+    ulong_t arg;
+    bool queued;			 /* on a work queue, not yet run */
+    int priority;			 /* ...at this priority */
+    DEFINE_LINK(Work_List, Work_Item);
+};
+
+/*
+ * Deferred work counters.
+ */
+struct Work_Stats {
+    ulong_t itemsQueued;
+    ulong_t itemsRun;
+    ulong_t maxQueued;			 /* most items waiting at once */
+};
+
+void Init_Work_Queues(void);
+void Init_Work_Item(struct Work_Item *item, Work_Func func, ulong_t arg);
+bool Queue_Work(struct Work_Item *item, int priority);
+bool Cancel_Work(struct Work_Item *item);
+void Get_Work_Stats(struct Work_Stats *stats);
+
+#endif  /* GEEKOS_WORKQUEUE_H */
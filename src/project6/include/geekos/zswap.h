@@ -0,0 +1,53 @@
+/*
+ * Compressed in-memory swap cache
+ * $Revision: 1.1 $
+ * 
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#ifndef GEEKOS_ZSWAP_H
+#define GEEKOS_ZSWAP_H
+
+#include <geekos/ktypes.h>
+#include <geekos/paging.h>
+
+/*
+ * Number of bytes of kernel heap the compressed pool may use.
+ */
+#define ZSWAP_POOL_SIZE		(128*1024)
+
+/*
+ * Maximum number of pages held in the pool.
+ */
+#define ZSWAP_MAX_ENTRIES	2048
+
+/*
+ * Pages which do not compress to this size or smaller
+ * are sent straight to the paging file.
+ */
+#define ZSWAP_MAX_COMPRESSED	(PAGE_SIZE * 3 / 4)
+
+/*
+ * Compressed pool counters.
+ */
+struct Zswap_Stats {
+    ulong_t storedPages;	 /* Pages ever stored in the pool */
+    ulong_t zeroPages;		 /* ...of which were entirely zero */
+    ulong_t rejectedPages;	 /* Pages that did not compress well enough */
+    ulong_t spilledPages;	 /* Cold pages moved on to the paging file */
+    ulong_t loadedPages;	 /* Pages faulted back in from the pool */
+    ulong_t compressedBytes;	 /* Total compressed size of stored pages */
+    ulong_t poolEntries;	 /* Pages currently in the pool */
+    ulong_t poolBytes;		 /* Bytes of compressed data currently in the pool */
+};
+
+void Init_Zswap(void);
+void Zswap_Make_Room(int numPages);
+int Zswap_Store(void *paddr, pte_t *entry);
+void Zswap_Load(int handle, void *paddr);
+void Zswap_Invalidate(int handle);
+bool Zswap_Holds(int handle, pte_t *entry);
+void Get_Zswap_Stats(struct Zswap_Stats *stats);
+
+#endif  /* GEEKOS_ZSWAP_H */
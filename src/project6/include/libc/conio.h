@@ -15,8 +15,15 @@
 #include <geekos/keyboard.h>	 /* key codes */
 #include <geekos/screen.h>	 /* screen attributes */
 
+/* Console output buffering modes (see Set_Output_Buffering()) */
+#define OUTPUT_UNBUFFERED	0
+#define OUTPUT_LINE_BUFFERED	1
+#define OUTPUT_FULLY_BUFFERED	2
+
 void Print(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
 int Print_String(const char* msg);
+int Flush_Output(void);
+int Set_Output_Buffering(int mode);
 int Put_Char(int ch);
 Keycode Get_Key(void);
 int Set_Attr(int attr);
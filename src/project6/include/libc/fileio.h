@@ -22,6 +22,11 @@ int Close(int fd);
 int Read_Entry(int fd, struct VFS_Dir_Entry *dirEntry);
 int Read(int fd, void *buf, unsigned long len);
 int Write(int fd, const void *buf, unsigned long len);
+int Splice(int inFd, int outFd, unsigned long len);
+int Read_At(int fd, unsigned long pos, void *buf, unsigned long len);
+int Write_At(int fd, unsigned long pos, const void *buf, unsigned long len);
+int Read_Vector(int fd, const struct IO_Vector *vec, int count);
+int Write_Vector(int fd, const struct IO_Vector *vec, int count);
 int Sync(void);
 int Format(const char *dev, const char *fstype);
 int Mount(const char *dev, const char *prefix, const char *fstype);
@@ -29,5 +34,16 @@ int Seek(int fd, int pos);
 int Delete(const char *path);
 int Create_Pipe(int *readfd, int *writefd);
 
+void IO_Ring_Init(struct IO_Ring *ring);
+int IO_Ring_Prep_Open(struct IO_Ring *ring, const char *path, int mode, ulong_t userData);
+int IO_Ring_Prep_Close(struct IO_Ring *ring, int fd, ulong_t userData);
+int IO_Ring_Prep_Read(struct IO_Ring *ring, int fd, void *buf, ulong_t len, ulong_t userData);
+int IO_Ring_Prep_Write(struct IO_Ring *ring, int fd, const void *buf, ulong_t len, ulong_t userData);
+int IO_Ring_Prep_Seek(struct IO_Ring *ring, int fd, int pos, ulong_t userData);
+int IO_Ring_Prep_Stat(struct IO_Ring *ring, const char *path, struct VFS_File_Stat *stat, ulong_t userData);
+int IO_Ring_Prep_FStat(struct IO_Ring *ring, int fd, struct VFS_File_Stat *stat, ulong_t userData);
+int IO_Ring_Enter(struct IO_Ring *ring);
+bool IO_Ring_Get_Completion(struct IO_Ring *ring, struct IO_Ring_CQE *cqe);
+
 #endif  /* FILEIO_H */
 
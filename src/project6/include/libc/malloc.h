@@ -0,0 +1,17 @@
+/*
+ * User mode memory allocation
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#ifndef MALLOC_H
+#define MALLOC_H
+
+#include <stddef.h>
+
+void *Malloc(size_t size);
+void Free(void *buf);
+
+#endif  /* MALLOC_H */
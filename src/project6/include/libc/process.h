@@ -11,12 +11,17 @@
 #ifndef PROCESS_H
 #define PROCESS_H
 
+#include <geekos/heapstats.h>
+
 int Null(void);
 int Exit(int exitCode);
 int Spawn_Program(const char *program, const char* command, int stdinFd, int stdoutFd);
 int Spawn_With_Path(const char *program, const char *command, int stdinFd, int stdoutFd, const char *path);
 int Wait(int pid);
 int Get_PID(void);
+int Get_Heap_Stats(struct Heap_Stats *stats);
+int Brk(unsigned long end);
+int Print_Paging_Stats(void);
 
 #endif  /* PROCESS_H */
 
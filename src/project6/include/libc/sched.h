@@ -11,8 +11,15 @@
 #ifndef SCHED_H
 #define SCHED_H
 
+#include <geekos/sched.h>
+
 int Set_Scheduling_Policy(int policy, int quantum);
 int Get_Time_Of_Day(void);
+int Get_Monotonic_Time(unsigned long long *ns);
+int Sleep(int us);
+int Set_Nice(int nice);
+int Get_Process_Times(struct Process_Times *times);
+void Print_Process_Times(const char *name);
 
 #endif  /* SCHED_H */
 
@@ -29,29 +29,56 @@ PERFORMANCE OF THIS SOFTWARE.
 
 ******************************************************************/
 
-/* A perhaps slow but I hope correct implementation of memmove */
+/*
+ * Forward copies (and non-overlapping ones) go through memcpy(),
+ * which always copies from low to high addresses.  Overlapping
+ * copies to a higher address run backwards; large ones go a word
+ * at a time with the direction flag set.  Setting and clearing the
+ * flag is slow on some processors, so short moves stay bytewise.
+ */
 
 #include <string.h>
 
+#define MEMMOVE_WORD_THRESHOLD 64
+
 void *
 memmove(void *d, const void *s, size_t n)
 {
 	char *dst = (char*) d;
 	const char *src = (const char*) s;
-	char *realdst = dst;
-	if (n <= 0)
-		return dst;
-	if (src >= dst+n || dst >= src+n)
+	size_t words;
+
+	if (n == 0 || dst == src)
+		return d;
+	if (dst < src || dst >= src+n)
 		return memcpy(dst, src, n);
-	if (src > dst) {
-		while (--n >= 0)
-			*dst++ = *src++;
+
+	/* Overlapping, destination above source: copy backwards. */
+	dst += n;
+	src += n;
+	while (n > 0 && ((unsigned long) dst & 3) != 0) {
+		*--dst = *--src;
+		--n;
+	}
+	words = n >= MEMMOVE_WORD_THRESHOLD ? n >> 2 : 0;
+	n -= words << 2;
+	if (words > 0) {
+		dst -= 4;
+		src -= 4;
+		__asm__ __volatile__ (
+			"std\n\t"
+			"rep movsl\n\t"
+			"cld"
+			: "+D" (dst), "+S" (src), "+c" (words)
+			:
+			: "memory"
+		);
+		dst += 4;
+		src += 4;
 	}
-	else if (src < dst) {
-		src += n;
-		dst += n;
-		while (--n >= 0)
-			*--dst = *--src;
+	while (n > 0) {
+		*--dst = *--src;
+		--n;
 	}
-	return realdst;
+	return d;
 }
@@ -2,8 +2,8 @@
  * Bit set data structure
  * Copyright (c) 2003, Jeffrey K. Hollingsworth <hollings@cs.umd.edu>
  * Copyright (c) 2003,2004 David Hovemeyer <daveho@cs.umd.edu>
- * $Revision: 1.13 $
- * 
+ * $Revision: 1.14 $
+ *
  * This is free software.  You are permitted to use,
  * redistribute, and modify it as specified in the file "COPYING".
  */
@@ -13,97 +13,369 @@
 #include <geekos/bitset.h>
 #include <geekos/string.h>
 #include <geekos/screen.h>
+#ifdef BITSET_BENCHMARK
+#include <geekos/timer.h>
+#endif
 
-#define FIND_OFFSET_AND_BIT(bitPos,offset,bit)	\
-do {						\
-    offset = bitPos / 8;			\
-    bit = bitPos % 8;				\
-} while (0)
+/*
+ * Bits are stored least significant first in 32 bit words, so bit n
+ * is bit (n % 8) of byte (n / 8), just as when the set was scanned a
+ * byte at a time.  Searches look at a whole word per step.
+ *
+ * The bits of the last word beyond the end of the set are kept set,
+ * so searches never find them free.
+ *
+ * Large sets also have a summary bitmap, with one bit per word of
+ * the set, which is set when that word is full.  Searches use it to
+ * skip 32 full words (1024 bits) at a time.
+ *
+ * A header in front of the bits records the size and the summary;
+ * the pointer handed out points at the bits themselves.
+ */
+
+#define BITS_PER_WORD		32
+#define ALL_ONES		0xffffffffUL
+
+/* Sets with at least this many words get a summary bitmap. */
+#define BITSET_SUMMARY_MIN_WORDS	64
+
+#define FIND_NUM_WORDS(totalBits) \
+    (((totalBits) + BITS_PER_WORD - 1) / BITS_PER_WORD)
+
+struct Bit_Set_Header {
+    ulong_t totalBits;
+    ulong_t numWords;
+    ulong_t *summary;		/* One bit per word: set if word is full, or null */
+};
+
+static __inline__ struct Bit_Set_Header *Get_Header(void *bitSet)
+{
+    return ((struct Bit_Set_Header *) bitSet) - 1;
+}
+
+/*
+ * Index of least significant set bit of a nonzero word.
+ */
+static __inline__ ulong_t Lowest_Set_Bit(ulong_t word)
+{
+    ulong_t bit;
+    __asm__ ("bsfl %1, %0" : "=r" (bit) : "rm" (word));
+    return bit;
+}
+
+/*
+ * Index of most significant set bit of a nonzero word.
+ */
+static __inline__ ulong_t Highest_Set_Bit(ulong_t word)
+{
+    ulong_t bit;
+    __asm__ ("bsrl %1, %0" : "=r" (bit) : "rm" (word));
+    return bit;
+}
+
+/*
+ * Number of consecutive clear bits at the bottom of a word.
+ */
+static __inline__ ulong_t Low_Clear_Run(ulong_t word)
+{
+    return word == 0 ? BITS_PER_WORD : Lowest_Set_Bit(word);
+}
 
-#define FIND_NUM_BYTES(totalBits) \
-    ((totalBits / 8) + ((totalBits % 8 != 0) ? 1 : 0))
+/*
+ * Number of consecutive clear bits at the top of a word.
+ */
+static __inline__ ulong_t High_Clear_Run(ulong_t word)
+{
+    return word == 0 ? BITS_PER_WORD : BITS_PER_WORD - 1 - Highest_Set_Bit(word);
+}
+
+/*
+ * Return a mask of the positions in given word at which a run of
+ * runLength (< 32) clear bits starts and fits within the word.
+ */
+static ulong_t Clear_Run_Starts(ulong_t word, uint_t runLength)
+{
+    ulong_t starts = ~word;
+    uint_t have = 1;
+
+    /* Each step doubles the run length covered, up to runLength */
+    while (have < runLength && starts != 0) {
+	uint_t shift = have <= runLength - have ? have : runLength - have;
+	starts &= starts >> shift;
+	have += shift;
+    }
+    return starts;
+}
+
+/*
+ * Record whether given word of the set is full in the summary.
+ */
+static __inline__ void Update_Summary(struct Bit_Set_Header *hdr, ulong_t *words, ulong_t index)
+{
+    ulong_t mask = 1UL << (index % BITS_PER_WORD);
+
+    if (words[index] == ALL_ONES)
+	hdr->summary[index / BITS_PER_WORD] |= mask;
+    else
+	hdr->summary[index / BITS_PER_WORD] &= ~mask;
+}
+
+/*
+ * Return the index of the first word at or after given one
+ * which is not full, or numWords if there isn't one.
+ * Uses the summary, so the set must have one.
+ */
+static ulong_t Skip_Full_Words(struct Bit_Set_Header *hdr, ulong_t index)
+{
+    while (index < hdr->numWords) {
+	ulong_t shift = index % BITS_PER_WORD;
+	ulong_t notFull = ~(hdr->summary[index / BITS_PER_WORD] >> shift);
+
+	/*
+	 * Shifting brings in zero bits at the top, so if every
+	 * remaining word in this part of the summary is full we
+	 * land on the next summary word.
+	 */
+	if (shift == 0 && notFull == 0)
+	    index += BITS_PER_WORD;
+	else
+	    return index + Lowest_Set_Bit(notFull);
+    }
+    return hdr->numWords;
+}
 
 void* Create_Bit_Set(uint_t totalBits)
 {
-    ulong_t numBytes;
-    void *bitSet;
+    ulong_t numWords = FIND_NUM_WORDS(totalBits);
+    ulong_t numSummaryWords = 0;
+    struct Bit_Set_Header *hdr;
+    ulong_t *words;
 
-    numBytes = FIND_NUM_BYTES(totalBits);
+    if (numWords >= BITSET_SUMMARY_MIN_WORDS)
+	numSummaryWords = FIND_NUM_WORDS(numWords);
 
-    bitSet = Malloc(numBytes);
-    if (bitSet != 0)
-	memset(bitSet, '\0', numBytes);
+    hdr = Malloc(sizeof(*hdr) + (numWords + numSummaryWords) * sizeof(ulong_t));
+    if (hdr == 0)
+	return 0;
 
-    return bitSet;
+    hdr->totalBits = totalBits;
+    hdr->numWords = numWords;
+    words = (ulong_t *) (hdr + 1);
+    memset(words, '\0', numWords * sizeof(ulong_t));
+
+    /* Bits past the end are permanently in use */
+    if (totalBits % BITS_PER_WORD != 0)
+	words[numWords - 1] = ALL_ONES << (totalBits % BITS_PER_WORD);
+
+    hdr->summary = 0;
+    if (numSummaryWords > 0) {
+	hdr->summary = words + numWords;
+	memset(hdr->summary, '\0', numSummaryWords * sizeof(ulong_t));
+	/* Likewise for summary bits past the last word */
+	if (numWords % BITS_PER_WORD != 0)
+	    hdr->summary[numSummaryWords - 1] = ALL_ONES << (numWords % BITS_PER_WORD);
+    }
+
+    return words;
 }
 
 void Set_Bit(void *bitSet, uint_t bitPos)
 {
-    ulong_t offset, bit;
+    struct Bit_Set_Header *hdr = Get_Header(bitSet);
+    ulong_t *words = (ulong_t *) bitSet;
+    ulong_t index = bitPos / BITS_PER_WORD;
 
-    FIND_OFFSET_AND_BIT(bitPos, offset, bit);
-    ((uchar_t*)bitSet)[offset] |= (1 << bit);
+    KASSERT(bitPos < hdr->totalBits);
+    words[index] |= 1UL << (bitPos % BITS_PER_WORD);
+    if (hdr->summary != 0 && words[index] == ALL_ONES)
+	Update_Summary(hdr, words, index);
 }
 
 void Clear_Bit(void *bitSet, uint_t bitPos)
 {
-    ulong_t offset, bit;
+    struct Bit_Set_Header *hdr = Get_Header(bitSet);
+    ulong_t *words = (ulong_t *) bitSet;
+    ulong_t index = bitPos / BITS_PER_WORD;
 
-    FIND_OFFSET_AND_BIT(bitPos, offset, bit);
-    ((uchar_t*)bitSet)[offset] &= ~(1 << bit);
+    KASSERT(bitPos < hdr->totalBits);
+    words[index] &= ~(1UL << (bitPos % BITS_PER_WORD));
+    if (hdr->summary != 0)
+	Update_Summary(hdr, words, index);
 }
 
 bool Is_Bit_Set(void *bitSet, uint_t bitPos)
 {
-    ulong_t offset, bit;
+    ulong_t *words = (ulong_t *) bitSet;
 
-    FIND_OFFSET_AND_BIT(bitPos, offset, bit);
-    return (((uchar_t*)bitSet)[offset] & (1 << bit)) != 0;
+    KASSERT(bitPos < Get_Header(bitSet)->totalBits);
+    return (words[bitPos / BITS_PER_WORD] & (1UL << (bitPos % BITS_PER_WORD))) != 0;
 }
 
 int Find_First_Free_Bit(void *bitSet, ulong_t totalBits)
 {
-    uint_t numBytes = FIND_NUM_BYTES(totalBits);
-    ulong_t offset;
-    uchar_t *bits = (uchar_t*) bitSet;
+    struct Bit_Set_Header *hdr = Get_Header(bitSet);
+    ulong_t *words = (ulong_t *) bitSet;
+    ulong_t index = 0, bitPos;
 
-    for (offset = 0; offset < numBytes; ++offset) {
-	if (bits[offset] != 0xff) {
-	    uint_t bit;
-	    for (bit = 0; bit < 8; ++bit) {
-		if ((bits[offset] & (1 << bit)) == 0)
-		    return (offset * 8) + bit;
-	    }
-	    KASSERT(false);
-	}
+    KASSERT(totalBits <= hdr->totalBits);
+
+    for (;;) {
+	if (hdr->summary != 0)
+	    index = Skip_Full_Words(hdr, index);
+	if (index >= hdr->numWords)
+	    return -1;
+	if (words[index] != ALL_ONES)
+	    break;
+	++index;
     }
 
-    return -1;
+    bitPos = index * BITS_PER_WORD + Lowest_Set_Bit(~words[index]);
+    return bitPos < totalBits ? (int) bitPos : -1;
+}
+
+/*
+ * Return the start of a run of runLength clear bits found ending in,
+ * or just before, given word, provided it lies within the first
+ * totalBits bits; otherwise -1.
+ */
+static __inline__ int Run_Start(ulong_t index, ulong_t run, uint_t runLength, ulong_t totalBits)
+{
+    ulong_t bitPos = index * BITS_PER_WORD - run;
+    return bitPos + runLength <= totalBits ? (int) bitPos : -1;
 }
 
 /*
- * This is slow!!
+ * Find the first run of runLength clear bits.  Runs are tracked
+ * across word boundaries, whole clear words extend a run by 32
+ * bits at once, and full words end one without looking at bits.
  */
 int Find_First_N_Free(void *bitSet, uint_t runLength, ulong_t totalBits)
 {
-    uint_t i,j;
+    struct Bit_Set_Header *hdr = Get_Header(bitSet);
+    ulong_t *words = (ulong_t *) bitSet;
+    ulong_t index, run = 0;
+
+    KASSERT(totalBits <= hdr->totalBits);
+
+    if (runLength == 0 || runLength > totalBits)
+	return -1;
+
+    for (index = 0; index < hdr->numWords; ++index) {
+	ulong_t word;
+
+	/* Not in a run: skip straight to the next word with space */
+	if (run == 0 && hdr->summary != 0) {
+	    index = Skip_Full_Words(hdr, index);
+	    if (index >= hdr->numWords)
+		break;
+	}
 
-    for (i=0; i < totalBits - runLength; i++) {
-        if (!Is_Bit_Set(bitSet, i)) {
-	    for (j=1; j < runLength; j++) {
-	        if (Is_Bit_Set(bitSet, i+j)) {
-		    break;
+	word = words[index];
+	if (word == 0) {
+	    run += BITS_PER_WORD;
+	    if (run >= runLength)
+		return Run_Start(index + 1, run, runLength, totalBits);
+	} else if (word == ALL_ONES) {
+	    run = 0;
+	} else {
+	    /* A run ending in the bottom of this word? */
+	    if (run + Low_Clear_Run(word) >= runLength)
+		return Run_Start(index, run, runLength, totalBits);
+
+	    /* A run wholly inside this word? */
+	    if (runLength < BITS_PER_WORD) {
+		ulong_t starts = Clear_Run_Starts(word, runLength);
+		if (starts != 0) {
+		    ulong_t bitPos = index * BITS_PER_WORD + Lowest_Set_Bit(starts);
+		    return bitPos + runLength <= totalBits ? (int) bitPos : -1;
 		}
 	    }
-	    if (j == runLength) {
-	        return i;
-	    }
+
+	    /* Otherwise a run may start at the top of this word */
+	    run = High_Clear_Run(word);
 	}
     }
+
     return -1;
 }
 
 void Destroy_Bit_Set(void *bitSet)
 {
-    Free(bitSet);
+    Free(Get_Header(bitSet));
+}
+
+#ifdef BITSET_BENCHMARK
+
+/*
+ * Time searches of a bit set covering a 10M disk, one bit per
+ * sector, with the first three quarters full and the rest 90%
+ * randomly allocated.  Each search is checked against a plain
+ * bit by bit search, which is also timed.
+ */
+#define BENCH_TOTAL_BITS	(10 * 1024 * 1024 / 512)
+#define BENCH_ITERS		100
+
+static int Slow_Find_First_N_Free(void *bitSet, uint_t runLength, ulong_t totalBits)
+{
+    uint_t i, j;
+
+    for (i = 0; i + runLength <= totalBits; i++) {
+	for (j = 0; j < runLength && !Is_Bit_Set(bitSet, i + j); j++)
+	    ;
+	if (j == runLength)
+	    return i;
+    }
+    return -1;
+}
+
+static void Time_Bit_Set_Search(void *bitSet, uint_t runLength)
+{
+    unsigned long long start;
+    ulong_t fastNs, slowNs;
+    int i, fast = -1, slow = -1;
+
+    start = Get_Monotonic_Time_NS();
+    for (i = 0; i < BENCH_ITERS; ++i)
+	fast = runLength == 1 ? Find_First_Free_Bit(bitSet, BENCH_TOTAL_BITS)
+	    : Find_First_N_Free(bitSet, runLength, BENCH_TOTAL_BITS);
+    fastNs = (ulong_t) (Get_Monotonic_Time_NS() - start);
+
+    start = Get_Monotonic_Time_NS();
+    for (i = 0; i < BENCH_ITERS; ++i)
+	slow = Slow_Find_First_N_Free(bitSet, runLength, BENCH_TOTAL_BITS);
+    slowNs = (ulong_t) (Get_Monotonic_Time_NS() - start);
+
+    Print("bitset: run of %3u at %6d: %7lu ns per search, bit by bit %8lu ns%s\n",
+	runLength, fast, fastNs / BENCH_ITERS, slowNs / BENCH_ITERS,
+	fast == slow ? "" : " (MISMATCH)");
+}
+
+void Bit_Set_Benchmark(void)
+{
+    static const uint_t runLengths[] = { 1, 4, 16, 64, 256 };
+    void *bitSet = Create_Bit_Set(BENCH_TOTAL_BITS);
+    ulong_t seed = 12345;
+    uint_t i;
+
+    if (bitSet == 0) {
+	Print("bitset: benchmark could not allocate bit set\n");
+	return;
+    }
+
+    for (i = 0; i < BENCH_TOTAL_BITS; ++i) {
+	seed = seed * 1103515245 + 12345;
+	if (i < BENCH_TOTAL_BITS / 4 * 3 || (seed >> 16) % 10 != 0)
+	    Set_Bit(bitSet, i);
+    }
+    /* Leave one long run near the end */
+    for (i = BENCH_TOTAL_BITS - 300; i < BENCH_TOTAL_BITS - 20; ++i)
+	Clear_Bit(bitSet, i);
+
+    Print("bitset: %d bits\n", BENCH_TOTAL_BITS);
+    for (i = 0; i < sizeof(runLengths) / sizeof(runLengths[0]); ++i)
+	Time_Bit_Set_Search(bitSet, runLengths[i]);
+
+    Destroy_Bit_Set(bitSet);
 }
+
+#endif /* BITSET_BENCHMARK */
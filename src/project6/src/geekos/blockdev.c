@@ -45,17 +45,36 @@ IMPLEMENT_LIST(Block_Device_List, Block_Device);
 static struct Block_Device_List s_deviceList;
 
 /*
- * Perform a block IO request.
+ * Work function which finishes a completed request and
+ * wakes up the thread waiting for it.
+ */
+static void Complete_Request(ulong_t arg)
+{
+    struct Block_Request *request = (struct Block_Request*) arg;
+
+    /* Once the state changes, the waiter may free the request */
+    Disable_Interrupts();
+    request->state = request->completedState;
+    Wake_Up(&request->waitQueue);
+    Enable_Interrupts();
+}
+
+/*
+ * Perform a block IO request covering numBlocks consecutive blocks.
  * Returns 0 if successful, error code on failure.
  */
-static int Do_Request(struct Block_Device *dev, enum Request_Type type, int blockNum, void *buf)
+static int Do_Request(struct Block_Device *dev, enum Request_Type type, int blockNum,
+    int numBlocks, void *buf)
 {
     struct Block_Request *request;
     int rc;
 
+    KASSERT(numBlocks > 0);
+
     request = Create_Request(dev, type, blockNum, buf);
     if (request == 0)
 	return ENOMEM;
+    request->numBlocks = numBlocks;
     Post_Request_And_Wait(request);
     rc = request->errorCode;
     Free(request);
@@ -169,9 +188,11 @@ struct Block_Request *Create_Request(struct Block_Device *dev, enum Request_Type
 	request->dev = dev;
 	request->type = type;
 	request->blockNum = blockNum;
+	request->numBlocks = 1;
 	request->buf = buf;
 	request->state = PENDING;
 	Clear_Thread_Queue(&request->waitQueue);
+	Init_Work_Item(&request->completionWork, &Complete_Request, (ulong_t) request);
     }
     return request;
 }
@@ -227,14 +248,16 @@ struct Block_Request *Dequeue_Request(struct Block_Request_List *requestQueue,
 
 /*
  * Signal the completion of a block request.
+ * The requesting thread is woken up by the work thread, so the
+ * driver can go straight on to its next request.
  */
 void Notify_Request_Completion(struct Block_Request *request, enum Request_State state, int errorCode)
 {
-    Disable_Interrupts();
-    request->state = state;
+    bool iflag = Begin_Int_Atomic();
     request->errorCode = errorCode;
-    Wake_Up(&request->waitQueue);
-    Enable_Interrupts();
+    request->completedState = state;
+    Queue_Work(&request->completionWork, WORK_PRIORITY_NORMAL);
+    End_Int_Atomic(iflag);
 }
 
 /*
@@ -243,7 +266,7 @@ void Notify_Request_Completion(struct Block_Request *request, enum Request_State
  */
 int Block_Read(struct Block_Device *dev, int blockNum, void *buf)
 {
-    return Do_Request(dev, BLOCK_READ, blockNum, buf);
+    return Do_Request(dev, BLOCK_READ, blockNum, 1, buf);
 }
 
 /*
@@ -252,7 +275,27 @@ int Block_Read(struct Block_Device *dev, int blockNum, void *buf)
  */
 int Block_Write(struct Block_Device *dev, int blockNum, void *buf)
 {
-    return Do_Request(dev, BLOCK_WRITE, blockNum, buf);
+    return Do_Request(dev, BLOCK_WRITE, blockNum, 1, buf);
+}
+
+/*
+ * Read numBlocks consecutive blocks from given device
+ * into a contiguous buffer, as a single request.
+ * Return 0 if successful, error code on error.
+ */
+int Block_Read_Multiple(struct Block_Device *dev, int blockNum, int numBlocks, void *buf)
+{
+    return Do_Request(dev, BLOCK_READ, blockNum, numBlocks, buf);
+}
+
+/*
+ * Write numBlocks consecutive blocks from a contiguous buffer
+ * to given device, as a single request.
+ * Return 0 if successful, error code on error.
+ */
+int Block_Write_Multiple(struct Block_Device *dev, int blockNum, int numBlocks, void *buf)
+{
+    return Do_Request(dev, BLOCK_WRITE, blockNum, numBlocks, buf);
 }
 
 /*
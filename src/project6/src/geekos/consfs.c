@@ -13,6 +13,7 @@
 #include <geekos/malloc.h>
 #include <geekos/screen.h>
 #include <geekos/keyboard.h>
+#include <geekos/serial.h>
 #include <geekos/consfs.h>
 
 /* ----------------------------------------------------------------------
@@ -34,7 +35,23 @@ static int Console_Read(struct File *file, void *buf, ulong_t numBytes)
  */
 static int Console_Write(struct File *file, void *buf, ulong_t numBytes)
 {
-    TODO("Write to console");
+    /* The whole buffer is drawn with a single cursor update */
+    Put_Buf((const char*) buf, numBytes);
+#ifdef SERIAL_CONSOLE
+    /* Copy console output to the serial port, for headless runs */
+    Serial_Write((const char*) buf, numBytes);
+#endif
+    return (int) numBytes;
+}
+
+/*
+ * Write to the serial port.
+ * Returns number of bytes written.
+ */
+static int Serial_Output_Write(struct File *file, void *buf, ulong_t numBytes)
+{
+    Serial_Write((const char*) buf, numBytes);
+    return (int) numBytes;
 }
 
 /*
@@ -55,6 +72,8 @@ static int Console_Clone(struct File *file, struct File **pClone)
 
     if (file->ops->Write == 0)
 	clone = Open_Console_Input();
+    else if (file->ops->Write == &Serial_Output_Write)
+	clone = Open_Serial_Output();
     else
 	clone = Open_Console_Output();
 
@@ -92,6 +111,19 @@ static struct File_Ops s_consOutputFileOps = {
     &Console_Clone,
 };
 
+/*
+ * File_Ops for serial port output.
+ */
+static struct File_Ops s_serialOutputFileOps = {
+    0,			/* FStat() */
+    0,			/* Read() */
+    &Serial_Output_Write,
+    0,			/* Seek() */
+    &Console_Close,
+    0,			/* Read_Entry() */
+    &Console_Clone,
+};
+
 /*
  * Create a File object for console input or output.
  * Returns null pointer if File can't be created.
@@ -121,3 +153,12 @@ struct File *Open_Console_Output(void)
     return Do_Open(&s_consOutputFileOps, O_WRITE);
 }
 
+/*
+ * Open a File which will write to the serial port (COM1),
+ * as an alternative to the screen.  Output is discarded if
+ * there is no serial port.
+ */
+struct File *Open_Serial_Output(void)
+{
+    return Do_Open(&s_serialOutputFileOps, O_WRITE);
+}
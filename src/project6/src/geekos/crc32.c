@@ -6,11 +6,68 @@
  * Code downloaded from OVM (http://www.ovmj.org)
  */
 
+/*
+ * The table driven loop consumes one byte per iteration.  To go
+ * faster we use "slice-by-8": seven further tables give the effect
+ * of each byte position in an 8 byte block on the CRC, so a whole
+ * block is folded in with eight independent table lookups.  The
+ * tables take 8K instead of 1K.
+ */
+
 #include <geekos/crc32.h>
 #include <geekos/kassert.h>
+#ifdef CRC32_BENCHMARK
+#include <geekos/screen.h>
+#include <geekos/malloc.h>
+#include <geekos/string.h>
+#include <geekos/timer.h>
+#include <geekos/cpu.h>
+#endif
 
 #define POLYNOMIAL (ulong_t)0xedb88320
-static ulong_t crc_table[256];
+#define NUM_SLICES 8
+static ulong_t crc_table[NUM_SLICES][256];
+
+/* Word type which may alias the bytes of the buffer. */
+typedef ulong_t __attribute__((__may_alias__)) crc_word_t;
+
+/*
+ * Fold bytes into a (non-inverted) CRC one at a time.
+ */
+static ulong_t crc32_bytes(ulong_t crc, const uchar_t *p, size_t len) {
+  while (len--)
+    crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+  return crc;
+}
+
+/*
+ * Fold bytes into a (non-inverted) CRC eight at a time.
+ * Relies on the x86 being little-endian.
+ */
+static ulong_t crc32_slice8(ulong_t crc, const uchar_t *p, size_t len) {
+  /* Get the buffer word aligned */
+  while (len > 0 && ((ulong_t) p & 3) != 0) {
+    crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+    --len;
+  }
+
+  while (len >= 8) {
+    ulong_t one = ((const crc_word_t *) p)[0] ^ crc;
+    ulong_t two = ((const crc_word_t *) p)[1];
+    crc = crc_table[7][one & 0xff] ^
+          crc_table[6][(one >> 8) & 0xff] ^
+          crc_table[5][(one >> 16) & 0xff] ^
+          crc_table[4][one >> 24] ^
+          crc_table[3][two & 0xff] ^
+          crc_table[2][(two >> 8) & 0xff] ^
+          crc_table[1][(two >> 16) & 0xff] ^
+          crc_table[0][two >> 24];
+    p += 8;
+    len -= 8;
+  }
+
+  return crc32_bytes(crc, p, len);
+}
 
 /*
  * This routine writes each crc_table entry exactly once,
@@ -20,13 +77,21 @@ static ulong_t crc_table[256];
 void Init_CRC32(void) {
   unsigned int i, j;
   ulong_t h = 1;
-  crc_table[0] = 0;
+  crc_table[0][0] = 0;
   for (i = 128; i; i >>= 1) {
     h = (h >> 1) ^ ((h & 1) ? POLYNOMIAL : 0);
-    /* h is now crc_table[i] */
+    /* h is now crc_table[0][i] */
     for (j = 0; j < 256; j += 2*i)
-      crc_table[i+j] = crc_table[j] ^ h;
+      crc_table[0][i+j] = crc_table[0][j] ^ h;
   }
+
+  /* crc_table[k][i] is the CRC of byte i followed by k zero bytes */
+  for (i = 0; i < 256; i++)
+    for (j = 1; j < NUM_SLICES; j++)
+      crc_table[j][i] = (crc_table[j-1][i] >> 8) ^ crc_table[0][crc_table[j-1][i] & 0xff];
+
+  /* Standard check value */
+  KASSERT(crc32(0, "123456789", 9) == 0xcbf43926);
 }
 
 /*
@@ -40,11 +105,74 @@ void Init_CRC32(void) {
  * property of detecting all burst errors of length 32 bits or less.
  */
 ulong_t crc32(ulong_t crc, char const *buf, size_t len) {
-  KASSERT(crc_table[255] != 0);
-  crc ^= 0xffffffff;
-  while (len--)
-    crc = (crc >> 8) ^ crc_table[(crc ^ *buf++) & 0xff];
-  return crc ^ 0xffffffff;
+  KASSERT(crc_table[0][255] != 0);
+  return crc32_slice8(crc ^ 0xffffffff, (const uchar_t *) buf, len) ^ 0xffffffff;
 }
 
+/*
+ * Streaming interface: CRC32_Init(), then CRC32_Update() on each
+ * piece of the data in order, then CRC32_Final() to get the same
+ * value crc32() would give for the whole.  The running value is
+ * kept preset, so no inversion is done per piece.
+ */
+void CRC32_Init(struct CRC32_Context *ctx) {
+  ctx->crc = 0xffffffff;
+}
+
+void CRC32_Update(struct CRC32_Context *ctx, const void *buf, size_t len) {
+  KASSERT(crc_table[0][255] != 0);
+  ctx->crc = crc32_slice8(ctx->crc, (const uchar_t *) buf, len);
+}
+
+ulong_t CRC32_Final(struct CRC32_Context *ctx) {
+  return ctx->crc ^ 0xffffffff;
+}
+
+#ifdef CRC32_BENCHMARK
+
+/*
+ * Compare the byte at a time and slice-by-8 loops on a page sized
+ * buffer, and check that they agree.
+ */
+#define BENCH_BUF_SIZE 4096
+#define BENCH_ITERS 1024
+
+static ulong_t crc32_rate(int slice8, const uchar_t *buf, ulong_t *result) {
+  unsigned long long start;
+  ulong_t ns, crc = 0;
+  int i;
+
+  start = Get_Monotonic_Time_NS();
+  for (i = 0; i < BENCH_ITERS; i++)
+    crc = slice8 ? crc32_slice8(crc, buf, BENCH_BUF_SIZE) : crc32_bytes(crc, buf, BENCH_BUF_SIZE);
+  ns = (ulong_t) (Get_Monotonic_Time_NS() - start);
+  *result = crc;
+
+  /* Bytes per microsecond is MB/s */
+  return ns == 0 ? 0 :
+    (ulong_t) Div_64_32((unsigned long long) BENCH_ITERS * BENCH_BUF_SIZE * 1000, ns);
+}
+
+void CRC32_Benchmark(void) {
+  uchar_t *buf = Malloc(BENCH_BUF_SIZE);
+  ulong_t bytesCrc, sliceCrc, bytesRate, sliceRate;
+  int i;
+
+  if (buf == 0) {
+    Print("crc32: benchmark could not allocate buffer\n");
+    return;
+  }
+  for (i = 0; i < BENCH_BUF_SIZE; i++)
+    buf[i] = (uchar_t) (i * 31 + 7);
+
+  bytesRate = crc32_rate(0, buf, &bytesCrc);
+  sliceRate = crc32_rate(1, buf, &sliceCrc);
+  Print("crc32: byte at a time %lu MB/s, slice-by-8 %lu MB/s%s\n",
+    bytesRate, sliceRate, bytesCrc == sliceCrc ? "" : " (MISMATCH)");
+
+  Free(buf);
+}
+
+#endif /* CRC32_BENCHMARK */
+
 /* end of crc32.c */
@@ -477,20 +477,22 @@ static int Floppy_Transfer(int direction, int driveNum, int blockNum, char *buf)
     if (!Floppy_Seek(driveNum, cylinder, head))
 	return -1;
 
-    Disable_Interrupts();
-
-    /* Set up DMA for transfer */
-    Setup_DMA(dmaDirection, FDC_DMA, s_transferBuf, SECTOR_SIZE);
-
     /* Turn the floppy motor on */
     Start_Motor(driveNum);
 
     /*
      * According to The Undocumented PC, we should wait 8 millis
-     * before attempting a read or write.
+     * before attempting a read or write.  Only this thread touches
+     * the controller, so there is no need to wait with interrupts
+     * disabled.
      */
     Micro_Delay(8000);
 
+    Disable_Interrupts();
+
+    /* Set up DMA for transfer */
+    Setup_DMA(dmaDirection, FDC_DMA, s_transferBuf, SECTOR_SIZE);
+
     if (direction == FLOPPY_READ)
 	command = FDC_COMMAND_READ_SECTOR | FDC_MFM | FDC_SKIP_DELETED;
     else
@@ -576,6 +578,8 @@ static void Floppy_Request_Thread(ulong_t arg)
 
     for (;;) {
 	struct Block_Request *request;
+	char *buf;
+	int i;
 
 	/* Wait for an I/O request to arrive */
 	Debug("FRQ: Request thread waiting for a request\n");
@@ -583,11 +587,20 @@ static void Floppy_Request_Thread(ulong_t arg)
 	Debug("FRQ: Got a floppy request [@%x]\n", request);
 	KASSERT(request->type == BLOCK_READ || request->type == BLOCK_WRITE);
 
-	/* Perform the I/O. */
-	if (request->type == BLOCK_READ)
-	    rc = Floppy_Read(request->dev->unit, request->blockNum, request->buf);
-	else
-	    rc = Floppy_Write(request->dev->unit, request->blockNum, request->buf);
+	/*
+	 * Perform the I/O.
+	 * The controller is programmed one sector at a time,
+	 * so multi-block requests are split here.
+	 */
+	buf = request->buf;
+	rc = 0;
+	for (i = 0; i < request->numBlocks && rc == 0; ++i) {
+	    if (request->type == BLOCK_READ)
+		rc = Floppy_Read(request->dev->unit, request->blockNum + i, buf);
+	    else
+		rc = Floppy_Write(request->dev->unit, request->blockNum + i, buf);
+	    buf += SECTOR_SIZE;
+	}
 
 	/* Notify the requesting thread of the outcome of the I/O. */
 	Debug("FRQ: Notifying requesting thread...\n");
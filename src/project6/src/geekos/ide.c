@@ -91,6 +91,13 @@
 
 #define IDE_MAX_DRIVES			2
 
+/*
+ * Largest number of sectors we transfer with one command.
+ * The sector count register is 8 bits; we stay below the
+ * value 0 (which means 256 sectors) to keep things simple.
+ */
+#define IDE_MAX_SECTORS_PER_COMMAND	255
+
 typedef struct {
     short num_Cylinders;
     short num_Heads;
@@ -121,31 +128,14 @@ static int IDE_getNumBlocks(int driveNum)
 }
 
 /*
- * Read a block at the logical block number indicated.
+ * Compute the head, cylinder, and sector of given logical block,
+ * and load them (along with the sector count) into the task file.
  */
-static int IDE_Read(int driveNum, int blockNum, char *buffer)
+static void IDE_Setup_Transfer(int driveNum, int blockNum, int numBlocks)
 {
-    int i;
     int head;
     int sector;
     int cylinder;
-    short *bufferW;
-    int reEnable = 0;
-
-    if (driveNum < 0 || driveNum > (numDrives-1)) {
-	if (ideDebug) Print("ide: invalid drive %d\n", driveNum);
-        return IDE_ERROR_BAD_DRIVE;
-    }
-
-    if (blockNum < 0 || blockNum >= IDE_getNumBlocks(driveNum)) {
-	if (ideDebug) Print("ide: invalid block %d\n", blockNum);
-        return IDE_ERROR_INVALID_BLOCK;
-    }
-
-    if (Interrupts_Enabled()) {
-	Disable_Interrupts();
-	reEnable = 1;
-    }
 
     /* now compute the head, cylinder, and sector */
     sector = blockNum % drives[driveNum].num_SectorsPerTrack + 1;
@@ -155,13 +145,13 @@ static int IDE_Read(int driveNum, int blockNum, char *buffer)
         drives[driveNum].num_Heads;
 
     if (ideDebug >= 2) {
-	Print ("request to read block %d\n", blockNum);
+	Print ("request to transfer %d block(s) at %d\n", numBlocks, blockNum);
 	Print ("    head %d\n", head);
 	Print ("    cylinder %d\n", cylinder);
 	Print ("    sector %d\n", sector);
     }
 
-    Out_Byte(IDE_SECTOR_COUNT_REGISTER, 1);
+    Out_Byte(IDE_SECTOR_COUNT_REGISTER, numBlocks);
     Out_Byte(IDE_SECTOR_NUMBER_REGISTER, sector);
     Out_Byte(IDE_CYLINDER_LOW_REGISTER, LOW_BYTE(cylinder));
     Out_Byte(IDE_CYLINDER_HIGH_REGISTER, HIGH_BYTE(cylinder));
@@ -170,24 +160,63 @@ static int IDE_Read(int driveNum, int blockNum, char *buffer)
     } else if (driveNum == 1) {
 	Out_Byte(IDE_DRIVE_HEAD_REGISTER, IDE_DRIVE_1 | head);
     }
+}
 
-    Out_Byte(IDE_COMMAND_REGISTER, IDE_COMMAND_READ_SECTORS);
+/*
+ * Read numBlocks consecutive blocks starting at the logical
+ * block number indicated.  All of the sectors are transferred
+ * by a single READ SECTORS command.
+ */
+static int IDE_Read(int driveNum, int blockNum, int numBlocks, char *buffer)
+{
+    int i, j;
+    short *bufferW;
+    int reEnable = 0;
 
-    if (ideDebug > 2) Print("About to wait for Read \n");
+    if (driveNum < 0 || driveNum > (numDrives-1)) {
+	if (ideDebug) Print("ide: invalid drive %d\n", driveNum);
+        return IDE_ERROR_BAD_DRIVE;
+    }
 
-    /* wait for the drive */
-    while (In_Byte(IDE_STATUS_REGISTER) & IDE_STATUS_DRIVE_BUSY);
+    if (blockNum < 0 || numBlocks < 1 || numBlocks > IDE_MAX_SECTORS_PER_COMMAND ||
+	blockNum + numBlocks > IDE_getNumBlocks(driveNum)) {
+	if (ideDebug) Print("ide: invalid block %d (count %d)\n", blockNum, numBlocks);
+        return IDE_ERROR_INVALID_BLOCK;
+    }
 
-    if (In_Byte(IDE_STATUS_REGISTER) & IDE_STATUS_DRIVE_ERROR) {
-	Print("ERROR: Got Read %d\n", In_Byte(IDE_STATUS_REGISTER));
-	return IDE_ERROR_DRIVE_ERROR;
+    if (Interrupts_Enabled()) {
+	Disable_Interrupts();
+	reEnable = 1;
     }
 
-    if (ideDebug > 2) Print("got buffer \n");
+    IDE_Setup_Transfer(driveNum, blockNum, numBlocks);
+
+    Out_Byte(IDE_COMMAND_REGISTER, IDE_COMMAND_READ_SECTORS);
+
+    if (ideDebug > 2) Print("About to wait for Read \n");
 
     bufferW = (short *) buffer;
-    for (i=0; i < 256; i++) {
-        bufferW[i] = In_Word(IDE_DATA_REGISTER);
+    for (j = 0; j < numBlocks; j++) {
+	/* wait for the drive */
+	while (In_Byte(IDE_STATUS_REGISTER) & IDE_STATUS_DRIVE_BUSY);
+
+	if (In_Byte(IDE_STATUS_REGISTER) & IDE_STATUS_DRIVE_ERROR) {
+	    Print("ERROR: Got Read %d\n", In_Byte(IDE_STATUS_REGISTER));
+	    if (reEnable) Enable_Interrupts();
+	    return IDE_ERROR_DRIVE_ERROR;
+	}
+
+	if (ideDebug > 2) Print("got buffer \n");
+
+	for (i=0; i < 256; i++) {
+	    *bufferW++ = In_Word(IDE_DATA_REGISTER);
+	}
+
+	/* Let pending interrupts in between sectors */
+	if (reEnable) {
+	    Enable_Interrupts();
+	    Disable_Interrupts();
+	}
     }
 
     if (reEnable) Enable_Interrupts();
@@ -196,14 +225,12 @@ static int IDE_Read(int driveNum, int blockNum, char *buffer)
 }
 
 /*
- * Write a block at the logical block number indicated.
+ * Write numBlocks consecutive blocks starting at the logical
+ * block number indicated, using a single WRITE SECTORS command.
  */
-static int IDE_Write(int driveNum, int blockNum, char *buffer)
+static int IDE_Write(int driveNum, int blockNum, int numBlocks, char *buffer)
 {
-    int i;
-    int head;
-    int sector;
-    int cylinder;
+    int i, j;
     short *bufferW;
     int reEnable = 0;
 
@@ -211,7 +238,8 @@ static int IDE_Write(int driveNum, int blockNum, char *buffer)
         return IDE_ERROR_BAD_DRIVE;
     }
 
-    if (blockNum < 0 || blockNum >= IDE_getNumBlocks(driveNum)) {
+    if (blockNum < 0 || numBlocks < 1 || numBlocks > IDE_MAX_SECTORS_PER_COMMAND ||
+	blockNum + numBlocks > IDE_getNumBlocks(driveNum)) {
         return IDE_ERROR_INVALID_BLOCK;
     }
 
@@ -220,39 +248,24 @@ static int IDE_Write(int driveNum, int blockNum, char *buffer)
 	reEnable = 1;
     }
 
-    /* now compute the head, cylinder, and sector */
-    sector = blockNum % drives[driveNum].num_SectorsPerTrack + 1;
-    cylinder = blockNum / (drives[driveNum].num_Heads * 
-     	drives[driveNum].num_SectorsPerTrack);
-    head = (blockNum / drives[driveNum].num_SectorsPerTrack) % 
-        drives[driveNum].num_Heads;
-
-    if (ideDebug) {
-	Print ("request to write block %d\n", blockNum);
-	Print ("    head %d\n", head);
-	Print ("    cylinder %d\n", cylinder);
-	Print ("    sector %d\n", sector);
-    }
-
-    Out_Byte(IDE_SECTOR_COUNT_REGISTER, 1);
-    Out_Byte(IDE_SECTOR_NUMBER_REGISTER, sector);
-    Out_Byte(IDE_CYLINDER_LOW_REGISTER, LOW_BYTE(cylinder));
-    Out_Byte(IDE_CYLINDER_HIGH_REGISTER, HIGH_BYTE(cylinder));
-    if (driveNum == 0) {
-	Out_Byte(IDE_DRIVE_HEAD_REGISTER, IDE_DRIVE_0 | head);
-    } else if (driveNum == 1) {
-	Out_Byte(IDE_DRIVE_HEAD_REGISTER, IDE_DRIVE_1 | head);
-    }
+    IDE_Setup_Transfer(driveNum, blockNum, numBlocks);
 
     Out_Byte(IDE_COMMAND_REGISTER, IDE_COMMAND_WRITE_SECTORS);
 
+    bufferW = (short *) buffer;
+    for (j = 0; j < numBlocks; j++) {
+	/* wait for the drive to ask for the next sector */
+	while (In_Byte(IDE_STATUS_REGISTER) & IDE_STATUS_DRIVE_BUSY);
 
-    /* wait for the drive */
-    while (In_Byte(IDE_STATUS_REGISTER) & IDE_STATUS_DRIVE_BUSY);
+	for (i=0; i < 256; i++) {
+	    Out_Word(IDE_DATA_REGISTER, *bufferW++);
+	}
 
-    bufferW = (short *) buffer;
-    for (i=0; i < 256; i++) {
-        Out_Word(IDE_DATA_REGISTER, bufferW[i]);
+	/* Let pending interrupts in between sectors */
+	if (reEnable) {
+	    Enable_Interrupts();
+	    Disable_Interrupts();
+	}
     }
 
     if (ideDebug) Print("About to wait for Write \n");
@@ -262,6 +275,7 @@ static int IDE_Write(int driveNum, int blockNum, char *buffer)
 
     if (In_Byte(IDE_STATUS_REGISTER) & IDE_STATUS_DRIVE_ERROR) {
 	Print("ERROR: Got Read %d\n", In_Byte(IDE_STATUS_REGISTER));
+	if (reEnable) Enable_Interrupts();
 	return IDE_ERROR_DRIVE_ERROR;
     }
 
@@ -304,9 +318,9 @@ static void IDE_Request_Thread(ulong_t arg)
 
 	/* Do the I/O */
 	if (request->type == BLOCK_READ)
-	    rc = IDE_Read(request->dev->unit, request->blockNum, request->buf);
+	    rc = IDE_Read(request->dev->unit, request->blockNum, request->numBlocks, request->buf);
 	else
-	    rc = IDE_Write(request->dev->unit, request->blockNum, request->buf);
+	    rc = IDE_Write(request->dev->unit, request->blockNum, request->numBlocks, request->buf);
 
 	/* Notify requesting thread of final status */
 	Notify_Request_Completion(request, rc == 0 ? COMPLETED : ERROR, rc);
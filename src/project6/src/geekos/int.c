@@ -12,6 +12,8 @@
 #include <geekos/kassert.h>
 #include <geekos/paging.h>
 #include <geekos/int.h>
+#include <geekos/cpu.h>
+#include <geekos/timer.h>
 
 /*
  * Defined in lowlevel.asm.
@@ -34,6 +36,19 @@ static void Dummy_Interrupt_Handler(struct Interrupt_State* state)
     STOP();
 }
 
+#ifdef TRACE_IRQS_OFF
+/*
+ * Start of the current interrupts-disabled interval,
+ * or 0 if its start was not seen.
+ */
+static unsigned long long s_irqsOffStart;
+static const char *s_irqsOffFile;
+static int s_irqsOffLine;
+static ulong_t s_irqsOffEIP;
+
+static struct Irqs_Off_Stats s_irqsOffStats;
+#endif
+
 static void Print_Selector(const char* regName, uint_t value)
 {
     Print("%s: index=%d, ti=%d, rpl=%d\n",
@@ -119,3 +134,70 @@ void Dump_Interrupt_State(struct Interrupt_State* state)
     Print_Selector("fs", state->fs);
     Print_Selector("gs", state->gs);
 }
+
+#ifdef TRACE_IRQS_OFF
+
+/*
+ * Note that interrupts were just disabled, at given source location.
+ * The caller's address is recorded too, since the location is
+ * in int.h when interrupts are disabled by Begin_Int_Atomic().
+ */
+void Trace_Interrupts_Off(const char *file, int line)
+{
+    s_irqsOffStart = Read_TSC();
+    s_irqsOffFile = file;
+    s_irqsOffLine = line;
+    s_irqsOffEIP = (ulong_t) __builtin_return_address(0);
+}
+
+/*
+ * Note that interrupts are about to be enabled.
+ */
+void Trace_Interrupts_On(void)
+{
+    unsigned long long cycles;
+
+    /*
+     * Interrupts may also be enabled by the low level code, when
+     * returning from an interrupt or starting a thread, in which
+     * case the start of the next interval is missed.
+     */
+    if (s_irqsOffStart == 0)
+	return;
+
+    cycles = Read_TSC() - s_irqsOffStart;
+    s_irqsOffStart = 0;
+
+    ++s_irqsOffStats.numIntervals;
+    if (cycles > s_irqsOffStats.maxCycles) {
+	s_irqsOffStats.maxCycles = cycles;
+	s_irqsOffStats.file = s_irqsOffFile;
+	s_irqsOffStats.line = s_irqsOffLine;
+	s_irqsOffStats.eip = s_irqsOffEIP;
+    }
+}
+
+/*
+ * Get a snapshot of the interrupts-disabled statistics.
+ */
+void Get_Irqs_Off_Stats(struct Irqs_Off_Stats *stats)
+{
+    bool iflag = Begin_Int_Atomic();
+    *stats = s_irqsOffStats;
+    End_Int_Atomic(iflag);
+}
+
+/*
+ * Report the longest interrupts-disabled interval so far.
+ */
+void Print_Irqs_Off_Stats(void)
+{
+    struct Irqs_Off_Stats stats;
+
+    Get_Irqs_Off_Stats(&stats);
+    Print("Longest interrupts-off interval: %lu us, from %s:%d (eip %lx), %lu intervals\n",
+	(ulong_t) Cycles_To_NS(stats.maxCycles) / 1000,
+	stats.file != 0 ? stats.file : "?", stats.line, stats.eip, stats.numIntervals);
+}
+
+#endif /* TRACE_IRQS_OFF */
@@ -106,10 +106,11 @@ void Disable_IRQ(int irq)
 
 /*
  * Called by an IRQ handler to begin the interrupt.
- * Currently a no-op.
  */
 void Begin_IRQ(struct Interrupt_State* state)
 {
+    /* The processor disabled interrupts on entry */
+    Trace_Interrupts_Off(__FILE__, __LINE__);
 }
 
 /*
@@ -130,4 +131,7 @@ void End_IRQ(struct Interrupt_State* state)
 	Out_Byte(0xA0, command);
 	Out_Byte(0x20, 0x62);
     }
+
+    /* Close enough to the iret that will enable interrupts again */
+    Trace_Interrupts_On();
 }
@@ -16,6 +16,9 @@
 #include <geekos/string.h>
 #include <geekos/kthread.h>
 #include <geekos/malloc.h>
+#include <geekos/timer.h>
+#include <geekos/cpu.h>
+#include <geekos/errno.h>
 
 
 /* ----------------------------------------------------------------------
@@ -32,6 +35,56 @@ static struct All_Thread_List s_allThreadList;
  */
 static struct Thread_Queue s_runQueue[MAX_QUEUE_LEVEL];
 
+/*
+ * Current scheduling policy.
+ */
+int g_schedulingPolicy = SCHED_RR;
+
+/*
+ * Runnable threads under SCHED_FAIR, in a leftist heap ordered
+ * by virtual runtime.  The idle thread stays on the run queues,
+ * so it only runs when the heap is empty.
+ */
+static struct Kernel_Thread* s_fairHeap;
+
+/*
+ * Lower bound on the virtual runtime of runnable threads.
+ * New and waking threads start from about here, so they can't
+ * claim CPU time for the period they weren't runnable.
+ */
+static unsigned long long s_minVruntime;
+
+/*
+ * How far (in nanoseconds of virtual runtime) behind s_minVruntime
+ * a waking thread is placed, so that threads which mostly sleep
+ * get to run soon after waking.
+ */
+#define FAIR_SLEEPER_CREDIT	20000000ULL
+
+/*
+ * A waking thread preempts the current thread if its virtual
+ * runtime is at least this much smaller.
+ */
+#define FAIR_WAKEUP_GRANULARITY	4000000ULL
+
+/*
+ * Virtual runtime advances by the CPU time used times 1024/weight,
+ * where weight is the thread's weight for its nice value; each nice
+ * step is about a factor of 1.25.  The table holds 2^32/weight, so
+ * the scaling is a multiply and a shift.
+ */
+#define NICE_INV(w)		((ulong_t) (0x100000000ULL / (w)))
+static const ulong_t s_niceInvWeight[NICE_MAX - NICE_MIN + 1] = {
+    /* -20 */ NICE_INV(88761), NICE_INV(71755), NICE_INV(56483), NICE_INV(46273), NICE_INV(36291),
+    /* -15 */ NICE_INV(29154), NICE_INV(23254), NICE_INV(18705), NICE_INV(14949), NICE_INV(11916),
+    /* -10 */ NICE_INV(9548),  NICE_INV(7620),  NICE_INV(6100),  NICE_INV(4904),  NICE_INV(3906),
+    /*  -5 */ NICE_INV(3121),  NICE_INV(2501),  NICE_INV(1991),  NICE_INV(1586),  NICE_INV(1277),
+    /*   0 */ NICE_INV(1024),  NICE_INV(820),   NICE_INV(655),   NICE_INV(526),   NICE_INV(423),
+    /*   5 */ NICE_INV(335),   NICE_INV(272),   NICE_INV(215),   NICE_INV(172),   NICE_INV(137),
+    /*  10 */ NICE_INV(110),   NICE_INV(87),    NICE_INV(70),    NICE_INV(56),    NICE_INV(45),
+    /*  15 */ NICE_INV(36),    NICE_INV(29),    NICE_INV(23),    NICE_INV(18),    NICE_INV(15),
+};
+
 /*
  * Current thread.
  */
@@ -59,6 +112,11 @@ volatile int g_preemptionDisabled;
 static struct Thread_Queue s_graveyardQueue;
 static struct Thread_Queue s_reaperWaitQueue;
 
+/*
+ * Queue for threads in Sleep(); only their timers wake them.
+ */
+static struct Thread_Queue s_sleepQueue;
+
 /*
  * Counter for keys that access thread-local data, and an array
  * of destructors for freeing that data when the thread dies.  This is
@@ -102,6 +160,9 @@ static void Init_Thread(struct Kernel_Thread* kthread, void* stackPage,
 
     kthread->currentReadyQueue = 0;
     kthread->blocked = false;
+
+    kthread->createTime = Get_Monotonic_Time_NS();
+    kthread->vruntime = s_minVruntime;
 }
 
 /*
@@ -319,6 +380,127 @@ static void Setup_Kernel_Thread(
 }
 
 
+/*
+ * Leftist heap rank of a (possibly empty) subtree.
+ */
+static __inline__ int Heap_Rank(struct Kernel_Thread* kthread)
+{
+    return kthread == 0 ? 0 : kthread->heapRank;
+}
+
+/*
+ * Merge two leftist heaps of threads.  The right spine of a leftist
+ * heap has at most log(n) nodes, which bounds the recursion depth.
+ */
+static struct Kernel_Thread* Fair_Heap_Merge(struct Kernel_Thread* a, struct Kernel_Thread* b)
+{
+    struct Kernel_Thread* tmp;
+
+    if (a == 0)
+	return b;
+    if (b == 0)
+	return a;
+
+    if (b->vruntime < a->vruntime) {
+	tmp = a; a = b; b = tmp;
+    }
+
+    a->heapRight = Fair_Heap_Merge(a->heapRight, b);
+    if (Heap_Rank(a->heapLeft) < Heap_Rank(a->heapRight)) {
+	tmp = a->heapLeft; a->heapLeft = a->heapRight; a->heapRight = tmp;
+    }
+    a->heapRank = Heap_Rank(a->heapRight) + 1;
+
+    return a;
+}
+
+static void Fair_Heap_Insert(struct Kernel_Thread* kthread)
+{
+    kthread->heapLeft = kthread->heapRight = 0;
+    kthread->heapRank = 1;
+    s_fairHeap = Fair_Heap_Merge(s_fairHeap, kthread);
+}
+
+/*
+ * Remove and return the thread with the smallest virtual runtime,
+ * or null if the heap is empty.
+ */
+static struct Kernel_Thread* Fair_Heap_Remove_Min(void)
+{
+    struct Kernel_Thread* min = s_fairHeap;
+
+    if (min != 0)
+	s_fairHeap = Fair_Heap_Merge(min->heapLeft, min->heapRight);
+    return min;
+}
+
+/*
+ * Charge the current thread for the CPU time it has used
+ * since it was last charged.
+ * Interrupts must be disabled.
+ */
+static void Charge_Current_Thread(void)
+{
+    struct Kernel_Thread* current = g_currentThread;
+    unsigned long long now, delta;
+
+    KASSERT(!Interrupts_Enabled());
+
+    if (current == 0)
+	return;  /* scheduler not initialized yet */
+
+    now = Get_Monotonic_Time_NS();
+    delta = now - current->execStart;
+    current->execStart = now;
+    current->runtime += delta;
+
+    /* Keep the scaling within 64 bits */
+    if (delta > 0xffffffffULL)
+	delta = 0xffffffffULL;
+    current->vruntime += (delta * s_niceInvWeight[current->nice - NICE_MIN]) >> 22;
+}
+
+/*
+ * Add a thread to the SCHED_FAIR heap.
+ * Interrupts must be disabled.
+ */
+static void Make_Runnable_Fair(struct Kernel_Thread* kthread)
+{
+    struct Kernel_Thread* current = g_currentThread;
+
+    if (kthread != current) {
+	/* Don't let a waking thread bank the time it was asleep */
+	if (kthread->vruntime + FAIR_SLEEPER_CREDIT < s_minVruntime)
+	    kthread->vruntime = s_minVruntime - FAIR_SLEEPER_CREDIT;
+
+	/* Preempt the current thread if it has had much more CPU */
+	if (current->priority == PRIORITY_IDLE ||
+	    kthread->vruntime + FAIR_WAKEUP_GRANULARITY < current->vruntime)
+	    g_needReschedule = true;
+    }
+
+    Fair_Heap_Insert(kthread);
+}
+
+/*
+ * Are any threads waiting on the run queues?
+ * Interrupts must be disabled.
+ */
+static bool Runnable_Threads_Exist(void)
+{
+    int i;
+
+    KASSERT(!Interrupts_Enabled());
+
+    if (s_fairHeap != 0)
+	return true;
+
+    for (i = 0; i < MAX_QUEUE_LEVEL; ++i)
+	if (!Is_Thread_Queue_Empty(&s_runQueue[i]))
+	    return true;
+    return false;
+}
+
 /*
  * This is the body of the idle thread.  Its job is to preserve
  * the invariant that a runnable thread always exists,
@@ -326,8 +508,25 @@ static void Setup_Kernel_Thread(
  */
 static void Idle(ulong_t arg)
 {
-    while (true)
+    while (true) {
+	/* Put the spare time to use clearing free pages */
+	if (!Refill_Zeroed_Page_Pool()) {
+	    /*
+	     * Nothing to do: rather than spinning through the
+	     * scheduler, halt until an interrupt arrives.  The timer
+	     * stops ticking until the next pending event is due.
+	     */
+	    Disable_Interrupts();
+	    if (!Runnable_Threads_Exist()) {
+		Timer_Enter_Idle();
+		Enable_Interrupts_And_Halt();
+		Disable_Interrupts();
+		Timer_Exit_Idle();
+	    }
+	    Enable_Interrupts();
+	}
 	Yield();
+    }
 }
 
 /*
@@ -528,9 +727,17 @@ void Make_Runnable(struct Kernel_Thread* kthread)
 {
     KASSERT(!Interrupts_Enabled());
 
-    { int currentQ = kthread->currentReadyQueue;
+    kthread->blocked = false;
+    Charge_Current_Thread();
+
+    if (g_schedulingPolicy == SCHED_FAIR && kthread->priority != PRIORITY_IDLE) {
+	Make_Runnable_Fair(kthread);
+	return;
+    }
+
+    /* Only MLF uses the lower priority queues */
+    { int currentQ = g_schedulingPolicy == SCHED_MLF ? kthread->currentReadyQueue : 0;
       KASSERT(currentQ >= 0 && currentQ < MAX_QUEUE_LEVEL);
-      kthread->blocked = false;
       Enqueue_Thread(&s_runQueue[currentQ], kthread);
     }
 }
@@ -561,9 +768,30 @@ struct Kernel_Thread* Get_Current(void)
 struct Kernel_Thread* Get_Next_Runnable(void)
 {
     struct Kernel_Thread* best = 0;
+    int i;
+
+    KASSERT(!Interrupts_Enabled());
+
+    Charge_Current_Thread();
+
+    /* Under SCHED_FAIR, the thread which has had the least (weighted) CPU */
+    best = Fair_Heap_Remove_Min();
+    if (best != 0) {
+	if (best->vruntime > s_minVruntime)
+	    s_minVruntime = best->vruntime;
+    }
 
     /* Find the best thread from the highest-priority run queue */
-    TODO("Find a runnable thread from run queues");
+    for (i = 0; best == 0 && i < MAX_QUEUE_LEVEL; ++i) {
+	best = Find_Best(&s_runQueue[i]);
+	if (best != 0)
+	    Remove_Thread(&s_runQueue[i], best);
+    }
+    KASSERT(best != 0);
+
+    best->execStart = Get_Monotonic_Time_NS();
+    if (best->firstRunTime == 0)
+	best->firstRunTime = best->execStart;
 
 /*
  *    Print("Scheduling %x\n", best);
@@ -571,6 +799,82 @@ struct Kernel_Thread* Get_Next_Runnable(void)
     return best;
 }
 
+/*
+ * Change the scheduling policy and quantum (in ticks).
+ * Runnable threads are moved to the new policy's run queues.
+ * Returns 0 if successful, EINVALID if the policy or quantum
+ * is not valid.
+ */
+int Set_Scheduling_Policy(int policy, int quantum)
+{
+    struct Thread_Queue moving;
+    struct Kernel_Thread* kthread;
+    bool iflag;
+    int i;
+
+    if (policy < 0 || policy >= NUM_SCHED_POLICIES || quantum < 1 || quantum > MAX_QUANTUM)
+	return EINVALID;
+
+    iflag = Begin_Int_Atomic();
+
+    Clear_Thread_Queue(&moving);
+    while ((kthread = Fair_Heap_Remove_Min()) != 0)
+	Enqueue_Thread(&moving, kthread);
+    for (i = 0; i < MAX_QUEUE_LEVEL; ++i) {
+	while (!Is_Thread_Queue_Empty(&s_runQueue[i]))
+	    Enqueue_Thread(&moving, Remove_From_Front_Of_Thread_Queue(&s_runQueue[i]));
+    }
+
+    g_schedulingPolicy = policy;
+    g_Quantum = quantum;
+
+    while (!Is_Thread_Queue_Empty(&moving))
+	Make_Runnable(Remove_From_Front_Of_Thread_Queue(&moving));
+
+    End_Int_Atomic(iflag);
+
+    return 0;
+}
+
+/*
+ * Set the nice value of given thread, which determines its share
+ * of the CPU under SCHED_FAIR.
+ * Returns 0 if successful, EINVALID if the value is out of range.
+ */
+int Set_Nice(struct Kernel_Thread* kthread, int nice)
+{
+    bool iflag;
+
+    if (nice < NICE_MIN || nice > NICE_MAX)
+	return EINVALID;
+
+    iflag = Begin_Int_Atomic();
+    /* Charge the time used so far at the old rate */
+    if (kthread == g_currentThread)
+	Charge_Current_Thread();
+    kthread->nice = nice;
+    End_Int_Atomic(iflag);
+
+    return 0;
+}
+
+/*
+ * Get CPU usage and scheduling times for given thread.
+ */
+void Get_Process_Times(struct Kernel_Thread* kthread, struct Process_Times* times)
+{
+    bool iflag = Begin_Int_Atomic();
+
+    if (kthread == g_currentThread)
+	Charge_Current_Thread();
+    times->cpuTime = (ulong_t) Div_64_32(kthread->runtime, 1000);
+    times->startTime = (ulong_t) Div_64_32(kthread->createTime, 1000);
+    times->firstRunTime = (ulong_t) Div_64_32(kthread->firstRunTime, 1000);
+    times->now = (ulong_t) Div_64_32(Get_Monotonic_Time_NS(), 1000);
+
+    End_Int_Atomic(iflag);
+}
+
 /*
  * Schedule a thread that is waiting to run.
  * Must be called with interrupts off!
@@ -736,6 +1040,89 @@ void Wait(struct Thread_Queue* waitQueue)
     Schedule();
 }
 
+/*
+ * A thread blocked in Wait_Timeout(); lives on its stack.
+ */
+struct Timed_Wait {
+    struct Kernel_Thread* kthread;
+    struct Thread_Queue* waitQueue;
+    bool timedOut;
+};
+
+/*
+ * Timer callback for Wait_Timeout(): if the thread is still
+ * waiting, take it off the wait queue and make it runnable.
+ */
+static void Timed_Wait_Expired(int id, void *context)
+{
+    struct Timed_Wait* timedWait = (struct Timed_Wait*) context;
+    struct Kernel_Thread* kthread = timedWait->kthread;
+
+    KASSERT(!Interrupts_Enabled());
+
+    /*
+     * If the thread was woken up normally, but hasn't run yet
+     * to cancel its timer, leave it alone.
+     */
+    if (!kthread->blocked)
+	return;
+
+    Remove_Thread(timedWait->waitQueue, kthread);
+    timedWait->timedOut = true;
+    Make_Runnable(kthread);
+}
+
+/*
+ * Wait on given wait queue for at most the given number of
+ * microseconds.  The timeout is rounded up to whole ticks.
+ * Must be called with interrupts disabled, and returns with
+ * interrupts disabled, like Wait().
+ * Returns 0 if woken up, ETIMEDOUT if the timeout expired first,
+ * or ENOMEM if no timer could be started.
+ */
+int Wait_Timeout(struct Thread_Queue* waitQueue, int us)
+{
+    struct Timed_Wait timedWait;
+    int id;
+
+    KASSERT(!Interrupts_Enabled());
+    KASSERT(us >= 0);
+
+    timedWait.kthread = g_currentThread;
+    timedWait.waitQueue = waitQueue;
+    timedWait.timedOut = false;
+
+    id = Start_Timer_With_Context(US_TO_TICKS(us), &Timed_Wait_Expired, &timedWait);
+    if (id < 0)
+	return ENOMEM;
+
+    Wait(waitQueue);
+
+    if (timedWait.timedOut)
+	return ETIMEDOUT;
+    Cancel_Timer(id);
+    return 0;
+}
+
+/*
+ * Block the current thread for at least the given number
+ * of microseconds.
+ * Must be called with interrupts enabled.
+ * Returns 0 if successful, or ENOMEM if no timer could be started.
+ */
+int Sleep(int us)
+{
+    int rc;
+
+    KASSERT(Interrupts_Enabled());
+
+    Disable_Interrupts();
+    rc = Wait_Timeout(&s_sleepQueue, us);
+    Enable_Interrupts();
+
+    return rc == ETIMEDOUT ? 0 : rc;
+}
+
 /*
  * Wake up all threads waiting on given wait queue.
  * Must be called with interrupts disabled!
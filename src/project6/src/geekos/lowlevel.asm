@@ -63,11 +63,16 @@ INTERRUPT_STATE_SIZE equ 64
 ; registers (because the interrupt context is used).
 %macro Activate_User_Context 0
 	; If the new thread has a user context which is not the current
-	; one, activate it.
+	; one, activate it.  Kernel threads keep whatever address space
+	; is active, so skip the call for them.
+	mov	eax, [g_currentThread]
+	cmp	dword [eax+24], 0	; userContext field
+	je	%%done
 	push    esp                     ; Interrupt_State pointer
-	push    dword [g_currentThread] ; Kernel_Thread pointer
+	push    eax			; Kernel_Thread pointer
 	call    Switch_To_User_Context
 	add     esp, 8                  ; clear 2 arguments
+%%done:
 %endmacro
 
 ; Number of bytes between the top of the stack and
@@ -123,6 +128,12 @@ IMPORT Make_Runnable
 ; Function to activate a new user context (if needed).
 IMPORT Switch_To_User_Context
 
+; C handler for system calls made with sysenter.
+IMPORT Sysenter_Handler
+
+; Top of the current user thread's kernel stack.
+IMPORT g_kernelStackTop
+
 ; Sizes of interrupt handler entry points for interrupts with
 ; and without error codes.  The code in idt.c uses this
 ; information to infer the layout of the table of interrupt
@@ -143,6 +154,9 @@ EXPORT g_entryPointTableEnd
 ; Thread context switch function.
 EXPORT Switch_To_Thread
 
+; Entry point for the sysenter instruction.
+EXPORT Sysenter_Entry
+
 ; Return current value of eflags register.
 EXPORT Get_Current_EFLAGS
 
@@ -151,6 +165,7 @@ EXPORT Enable_Paging
 EXPORT Set_PDBR
 EXPORT Get_PDBR
 EXPORT Flush_TLB
+EXPORT Flush_TLB_Page
 
 
 ; ----------------------------------------------------------------------
@@ -236,6 +251,16 @@ Flush_TLB:
 	mov	cr3, eax
 	ret
 
+;
+; Flush the TLB entry for a single page - invalidate just the
+; page containing the linear address given as the parameter
+;
+align 8
+Flush_TLB_Page:
+	mov	eax, [esp+4]
+	invlpg	[eax]
+	ret
+
 
 ; Common interrupt handling code.
 ; Save registers, call C handler function,
@@ -246,6 +271,10 @@ Handle_Interrupt:
 	; Save registers (general purpose and segment)
 	Save_Registers
 
+	; User code may have left the direction flag set;
+	; the kernel's string routines assume it is clear.
+	cld
+
 	; Ensure that we're using the kernel data segment
 	mov	ax, KERNEL_DS
 	mov	ds, ax
@@ -264,6 +293,7 @@ Handle_Interrupt:
 	call	ebx
 	add	esp, 4			; clear 1 argument
 
+.handled:
 	; If preemption is disabled, then the current thread
 	; keeps running.
 	cmp	[g_preemptionDisabled], dword 0
@@ -302,6 +332,42 @@ Handle_Interrupt:
 	; Return from the interrupt.
 	iret
 
+; ----------------------------------------------------------------------
+; Sysenter_Entry
+;   Entry point for system calls made with the sysenter instruction.
+;   The processor has loaded cs and ss from the SYSENTER_CS MSR
+;   and disabled interrupts.  Switch to the current thread's kernel
+;   stack, which Set_Kernel_Stack_Pointer() keeps in g_kernelStackTop;
+;   ds still holds the user segment, so use ss.  Nothing about
+;   the user code or stack is saved, so build the frame an int 0x90
+;   would have, leaving Sysenter_Handler to fill in the user cs,
+;   eip, ss and esp.  From there on it is an ordinary system call,
+;   returning through the common interrupt return path.
+; ----------------------------------------------------------------------
+align 16
+Sysenter_Entry:
+	mov	esp, [ss:g_kernelStackTop]
+	push	dword 0			; user ss
+	push	dword 0			; user esp
+	pushfd				; eflags
+	push	dword 0			; user cs
+	push	dword 0			; user eip
+	push	dword 0			; error code
+	push	dword 0x90		; interrupt number (SYSCALL_INT)
+
+	Save_Registers
+	cld
+
+	mov	ax, KERNEL_DS
+	mov	ds, ax
+	mov	es, ax
+
+	push	esp
+	call	Sysenter_Handler
+	add	esp, 4			; clear 1 argument
+
+	jmp	Handle_Interrupt.handled
+
 ; ----------------------------------------------------------------------
 ; Switch_To_Thread()
 ;   Save context of currently executing thread, and activate
@@ -14,12 +14,16 @@
 #include <geekos/screen.h>
 #include <geekos/mem.h>
 #include <geekos/crc32.h>
+#include <geekos/bitset.h>
 #include <geekos/tss.h>
 #include <geekos/int.h>
 #include <geekos/kthread.h>
+#include <geekos/workqueue.h>
 #include <geekos/trap.h>
 #include <geekos/timer.h>
+#include <geekos/vdso.h>
 #include <geekos/keyboard.h>
+#include <geekos/serial.h>
 #include <geekos/dma.h>
 #include <geekos/ide.h>
 #include <geekos/floppy.h>
@@ -68,17 +72,38 @@ void Main(struct Boot_Info* bootInfo)
     Init_Interrupts();
     Init_VM(bootInfo);
     Init_Scheduler();
+    Init_Work_Queues();
     Init_Traps();
+    Init_VDSO();
     Init_Timer();
     Init_Keyboard();
+    Init_Serial();
     Init_DMA();
     Init_Floppy();
     Init_IDE();
     Init_PFAT();
     Init_GOSFS();
 
+#ifdef TIMER_STRESS_TEST
+    Timer_Stress_Test();
+#endif
+
+#ifdef STRING_BENCHMARK
+    String_Benchmark();
+#endif
+#ifdef CRC32_BENCHMARK
+    CRC32_Benchmark();
+#endif
+#ifdef BITSET_BENCHMARK
+    Bit_Set_Benchmark();
+#endif
+
     Mount_Root_Filesystem();
 
+#ifdef TRACE_IRQS_OFF
+    Print_Irqs_Off_Stats();
+#endif
+
     Set_Current_Attr(ATTRIB(BLACK, GREEN|BRIGHT));
     Print("Welcome to GeekOS!\n");
     Set_Current_Attr(ATTRIB(BLACK, GRAY));
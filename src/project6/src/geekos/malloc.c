@@ -1,26 +1,287 @@
 /*
  * GeekOS memory allocation API
  * Copyright (c) 2001, David H. Hovemeyer <daveho@cs.umd.edu>
- * $Revision: 1.12 $
- * 
+ * $Revision: 1.13 $
+ *
  * This is free software.  You are permitted to use,
  * redistribute, and modify it as specified in the file "COPYING".
  */
 
 #include <geekos/screen.h>
 #include <geekos/int.h>
-#include <geekos/bget.h>
+#include <geekos/list.h>
+#include <geekos/mem.h>
 #include <geekos/kassert.h>
 #include <geekos/malloc.h>
 
 /*
- * Initialize the heap starting at given address and occupying
- * specified number of bytes.
+ * The heap has no fixed arena; it takes pages from the physical
+ * page allocator as it needs them and gives them back when they
+ * are no longer used.
+ *
+ * Small objects are grouped by size class.  Each class carves
+ * single pages ("slabs") into equal sized objects, and keeps the
+ * slabs that have free objects on a list, so allocating and
+ * freeing take constant time.  A slab which becomes entirely free
+ * is returned to the page allocator, except that each class keeps
+ * one empty slab so that allocating and freeing a single object
+ * repeatedly doesn't churn pages.
+ *
+ * Anything too big for the largest class gets its own run of
+ * contiguous pages, with a small header recording how many.
  */
-void Init_Heap(ulong_t start, ulong_t size)
+
+/* Header at the start of each slab page; objects follow it. */
+#define SLAB_HEADER_SIZE	32
+
+/* Header at the start of a large allocation's pages. */
+#define LARGE_HEADER_SIZE	16
+
+/* Size classes are multiples of this, which is also the alignment. */
+#define HEAP_QUANTUM		16
+
+/*
+ * Size classes, chosen so that slabs waste little space.
+ * The largest class fits two objects in a page.
+ */
+static const ulong_t s_classSizes[HEAP_NUM_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 672, 1008, 1344, 2032
+};
+#define HEAP_MAX_SMALL		2032
+
+struct Slab;
+DEFINE_LIST(Slab_List, Slab);
+
+struct Size_Class;
+
+struct Slab {
+    struct Size_Class *sizeClass;
+    ulong_t numFree;			 /* Number of free objects */
+    void *freeList;			 /* Free objects, linked through their first word */
+    DEFINE_LINK(Slab_List, Slab);
+};
+
+IMPLEMENT_LIST(Slab_List, Slab);
+
+struct Size_Class {
+    ulong_t objectSize;
+    ulong_t objectsPerSlab;
+    struct Slab_List partialSlabs;	 /* Slabs with at least one free object */
+    int numEmptySlabs;			 /* ...of which this many are wholly free */
+};
+
+struct Large_Header {
+    ulong_t numPages;
+};
+
+static struct Size_Class s_sizeClasses[HEAP_NUM_CLASSES];
+
+/* Size class for each request size, in units of HEAP_QUANTUM */
+static uchar_t s_sizeToClass[HEAP_MAX_SMALL / HEAP_QUANTUM + 1];
+
+static struct Heap_Stats s_heapStats;
+
+/*
+ * Account for pages entering or leaving the heap.
+ */
+static void Add_Heap_Pages(long numPages)
 {
-    /*Print("Creating kernel heap: start=%lx, size=%ld\n", start, size);*/
-    bpool((void*) start, size);
+    s_heapStats.heapPages += numPages;
+    if (s_heapStats.heapPages > s_heapStats.peakHeapPages)
+	s_heapStats.peakHeapPages = s_heapStats.heapPages;
+}
+
+/*
+ * Account for bytes allocated or freed.
+ */
+static void Add_Bytes_In_Use(long numBytes)
+{
+    s_heapStats.bytesInUse += numBytes;
+    if (s_heapStats.bytesInUse > s_heapStats.peakBytesInUse)
+	s_heapStats.peakBytesInUse = s_heapStats.bytesInUse;
+}
+
+/*
+ * Get a fresh page for given size class, and thread all of
+ * its objects onto its free list.
+ * Returns null if no page is available.
+ */
+static struct Slab *Create_Slab(struct Size_Class *sizeClass)
+{
+    struct Slab *slab;
+    char *obj;
+    ulong_t i;
+
+    slab = Alloc_Page();
+    if (slab == 0)
+	return 0;
+    Get_Page((ulong_t) slab)->flags |= (PAGE_HEAP | PAGE_SLAB);
+
+    slab->sizeClass = sizeClass;
+    slab->numFree = sizeClass->objectsPerSlab;
+    slab->freeList = 0;
+    obj = (char*) slab + SLAB_HEADER_SIZE + sizeClass->objectsPerSlab * sizeClass->objectSize;
+    for (i = 0; i < sizeClass->objectsPerSlab; ++i) {
+	obj -= sizeClass->objectSize;
+	*((void**) obj) = slab->freeList;
+	slab->freeList = obj;
+    }
+
+    Add_Heap_Pages(1);
+    s_heapStats.classes[sizeClass - s_sizeClasses].slabPages++;
+    return slab;
+}
+
+/*
+ * Give a wholly free slab back to the page allocator.
+ */
+static void Destroy_Slab(struct Slab *slab)
+{
+    struct Size_Class *sizeClass = slab->sizeClass;
+
+    KASSERT(slab->numFree == sizeClass->objectsPerSlab);
+    Remove_From_Slab_List(&sizeClass->partialSlabs, slab);
+    Get_Page((ulong_t) slab)->flags &= ~(PAGE_HEAP | PAGE_SLAB);
+    Free_Page(slab);
+
+    Add_Heap_Pages(-1);
+    s_heapStats.classes[sizeClass - s_sizeClasses].slabPages--;
+}
+
+/*
+ * Allocate an object from given size class.
+ * Interrupts must be disabled.
+ */
+static void *Alloc_Small(struct Size_Class *sizeClass)
+{
+    struct Heap_Class_Stats *classStats = &s_heapStats.classes[sizeClass - s_sizeClasses];
+    struct Slab *slab;
+    void *obj;
+
+    slab = Get_Front_Of_Slab_List(&sizeClass->partialSlabs);
+    if (slab == 0) {
+	slab = Create_Slab(sizeClass);
+	if (slab == 0)
+	    return 0;
+	Add_To_Front_Of_Slab_List(&sizeClass->partialSlabs, slab);
+	sizeClass->numEmptySlabs++;
+    }
+
+    if (slab->numFree == sizeClass->objectsPerSlab)
+	sizeClass->numEmptySlabs--;
+    obj = slab->freeList;
+    slab->freeList = *((void**) obj);
+    if (--slab->numFree == 0)
+	Remove_From_Slab_List(&sizeClass->partialSlabs, slab);
+
+    if (++classStats->objectsInUse > classStats->peakObjects)
+	classStats->peakObjects = classStats->objectsInUse;
+    Add_Bytes_In_Use(sizeClass->objectSize);
+    return obj;
+}
+
+/*
+ * Return an object to the slab it came from.
+ * Interrupts must be disabled.
+ */
+static void Free_Small(struct Slab *slab, void *obj)
+{
+    struct Size_Class *sizeClass = slab->sizeClass;
+
+    KASSERT(((char*) obj - ((char*) slab + SLAB_HEADER_SIZE)) % sizeClass->objectSize == 0);
+
+    *((void**) obj) = slab->freeList;
+    slab->freeList = obj;
+    if (slab->numFree++ == 0)
+	Add_To_Front_Of_Slab_List(&sizeClass->partialSlabs, slab);
+
+    s_heapStats.classes[sizeClass - s_sizeClasses].objectsInUse--;
+    Add_Bytes_In_Use(-(long) sizeClass->objectSize);
+
+    /* Keep one empty slab per class, release any others */
+    if (slab->numFree == sizeClass->objectsPerSlab) {
+	if (sizeClass->numEmptySlabs > 0)
+	    Destroy_Slab(slab);
+	else
+	    sizeClass->numEmptySlabs++;
+    }
+}
+
+/*
+ * Allocate a run of pages for a large buffer.
+ * Interrupts must be disabled.
+ */
+static void *Alloc_Large(ulong_t size)
+{
+    ulong_t numPages = (size + LARGE_HEADER_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+    struct Large_Header *hdr;
+    ulong_t i;
+
+    hdr = Alloc_Pages(numPages);
+    if (hdr == 0)
+	return 0;
+    for (i = 0; i < numPages; ++i)
+	Get_Page((ulong_t) hdr + i * PAGE_SIZE)->flags |= PAGE_HEAP;
+    hdr->numPages = numPages;
+
+    Add_Heap_Pages(numPages);
+    Add_Bytes_In_Use(numPages * PAGE_SIZE);
+    s_heapStats.largeAllocs++;
+    s_heapStats.largePages += numPages;
+    return (char*) hdr + LARGE_HEADER_SIZE;
+}
+
+/*
+ * Free the pages of a large buffer.
+ * Interrupts must be disabled.
+ */
+static void Free_Large(void *buf)
+{
+    struct Large_Header *hdr = (struct Large_Header*) ((char*) buf - LARGE_HEADER_SIZE);
+    ulong_t numPages = hdr->numPages, i;
+
+    KASSERT(Is_Page_Multiple((ulong_t) hdr));
+    for (i = 0; i < numPages; ++i) {
+	struct Page *page = Get_Page((ulong_t) hdr + i * PAGE_SIZE);
+	KASSERT(page->flags & PAGE_HEAP);
+	page->flags &= ~(PAGE_HEAP);
+    }
+    Free_Pages(hdr, numPages);
+
+    Add_Heap_Pages(-(long) numPages);
+    Add_Bytes_In_Use(-(long) (numPages * PAGE_SIZE));
+    s_heapStats.largeAllocs--;
+    s_heapStats.largePages -= numPages;
+}
+
+/*
+ * Initialize the heap's size classes.
+ * The page allocator must already be initialized.
+ */
+void Init_Heap(void)
+{
+    ulong_t size;
+    int i;
+
+    KASSERT(sizeof(struct Slab) <= SLAB_HEADER_SIZE);
+
+    for (i = 0; i < HEAP_NUM_CLASSES; ++i) {
+	struct Size_Class *sizeClass = &s_sizeClasses[i];
+
+	KASSERT(s_classSizes[i] % HEAP_QUANTUM == 0);
+	sizeClass->objectSize = s_classSizes[i];
+	sizeClass->objectsPerSlab = (PAGE_SIZE - SLAB_HEADER_SIZE) / s_classSizes[i];
+	Clear_Slab_List(&sizeClass->partialSlabs);
+	sizeClass->numEmptySlabs = 0;
+	s_heapStats.classes[i].objectSize = s_classSizes[i];
+    }
+
+    /* Each request size maps to the smallest class that holds it */
+    for (i = 0, size = 0; size <= HEAP_MAX_SMALL; size += HEAP_QUANTUM) {
+	while (s_classSizes[i] < size)
+	    ++i;
+	s_sizeToClass[size / HEAP_QUANTUM] = i;
+    }
 }
 
 /*
@@ -36,7 +297,14 @@ void* Malloc(ulong_t size)
     KASSERT(size > 0);
 
     iflag = Begin_Int_Atomic();
-    result = bget(size);
+    if (size <= HEAP_MAX_SMALL)
+	result = Alloc_Small(&s_sizeClasses[s_sizeToClass[(size + HEAP_QUANTUM - 1) / HEAP_QUANTUM]]);
+    else
+	result = Alloc_Large(size);
+    if (result != 0)
+	s_heapStats.mallocCalls++;
+    else
+	s_heapStats.failedCalls++;
     End_Int_Atomic(iflag);
 
     return result;
@@ -47,9 +315,29 @@ void* Malloc(ulong_t size)
  */
 void Free(void* buf)
 {
+    struct Page *page;
     bool iflag;
 
+    if (buf == 0)
+	return;
+
     iflag = Begin_Int_Atomic();
-    brel(buf);
+    page = Get_Page((ulong_t) buf);
+    KASSERT(page->flags & PAGE_HEAP);
+    if (page->flags & PAGE_SLAB)
+	Free_Small((struct Slab*) Round_Down_To_Page((ulong_t) buf), buf);
+    else
+	Free_Large(buf);
+    s_heapStats.freeCalls++;
+    End_Int_Atomic(iflag);
+}
+
+/*
+ * Get a snapshot of the heap statistics.
+ */
+void Get_Heap_Stats(struct Heap_Stats *stats)
+{
+    bool iflag = Begin_Int_Atomic();
+    *stats = s_heapStats;
     End_Int_Atomic(iflag);
 }
@@ -18,6 +18,10 @@
 #include <geekos/malloc.h>
 #include <geekos/string.h>
 #include <geekos/paging.h>
+#include <geekos/zswap.h>
+#include <geekos/timer.h>
+#include <geekos/cpu.h>
+#include <geekos/kthread.h>
 #include <geekos/mem.h>
 
 /* ----------------------------------------------------------------------
@@ -54,6 +58,22 @@ static struct Page_List s_freeList;
  */
 int unsigned s_numPages;
 
+/*
+ * Free pages whose contents are known to be zero.
+ * The idle thread fills this list from the freelist, and
+ * Alloc_Zeroed_Page() takes from it first.  The pages still
+ * count as free, and Alloc_Page() uses them once the
+ * freelist is exhausted.
+ */
+static struct Page_List s_zeroedList;
+static uint_t s_numZeroedPages;
+static struct Zeroed_Page_Stats s_zeroedStats;
+
+/*
+ * Threads which faulted on a page that is being paged out.
+ */
+static struct Thread_Queue s_pageOutWaitQueue;
+
 /*
  * Add a range of pages to the inventory of physical memory.
  */
@@ -143,8 +163,8 @@ void Init_Mem(struct Boot_Info* bootInfo)
      * ISA_HOLE_START - ISA_HOLE_END: used by hardware (and ROM BIOS?)
      * ISA_HOLE_END - HIGHMEM_START: used by initial kernel thread
      * HIGHMEM_START - end of memory: available
-     *    (the kernel heap is located at HIGHMEM_START; any unused memory
-     *    beyond that is added to the freelist)
+     *    (the kernel heap takes its pages from the freelist as needed;
+     *    pageable pages leave KERNEL_HEAP_RESERVE_PAGES of it to the heap)
      */
 
     Add_Page_Range(0, PAGE_SIZE, PAGE_UNUSED);
@@ -153,14 +173,13 @@ void Init_Mem(struct Boot_Info* bootInfo)
     Add_Page_Range(kernEnd, ISA_HOLE_START, PAGE_AVAIL);
     Add_Page_Range(ISA_HOLE_START, ISA_HOLE_END, PAGE_HW);
     Add_Page_Range(ISA_HOLE_END, HIGHMEM_START, PAGE_ALLOCATED);
-    Add_Page_Range(HIGHMEM_START, HIGHMEM_START + KERNEL_HEAP_SIZE, PAGE_HEAP);
-    Add_Page_Range(HIGHMEM_START + KERNEL_HEAP_SIZE, endOfMem, PAGE_AVAIL);
+    Add_Page_Range(HIGHMEM_START, endOfMem, PAGE_AVAIL);
 
     /* Initialize the kernel heap */
-    Init_Heap(HIGHMEM_START, KERNEL_HEAP_SIZE);
+    Init_Heap();
 
-    Print("%uKB memory detected, %u pages in freelist, %d bytes in kernel heap\n",
-	bootInfo->memSizeKB, g_freePageCount, KERNEL_HEAP_SIZE);
+    Print("%uKB memory detected, %u pages in freelist\n",
+	bootInfo->memSizeKB, g_freePageCount);
 }
 
 /*
@@ -184,14 +203,19 @@ void* Alloc_Page(void)
 
     bool iflag = Begin_Int_Atomic();
 
-    /* See if we have a free page */
-    if (!Is_Page_List_Empty(&s_freeList)) {
-	/* Remove the first page on the freelist. */
-	page = Get_Front_Of_Page_List(&s_freeList);
+    /* See if we have a free page, falling back on the pre-zeroed ones */
+    if (!Is_Page_List_Empty(&s_freeList) || !Is_Page_List_Empty(&s_zeroedList)) {
+	if (!Is_Page_List_Empty(&s_freeList)) {
+	    /* Remove the first page on the freelist. */
+	    page = Remove_From_Front_Of_Page_List(&s_freeList);
+	} else {
+	    page = Remove_From_Front_Of_Page_List(&s_zeroedList);
+	    s_numZeroedPages--;
+	}
 	KASSERT((page->flags & PAGE_ALLOCATED) == 0);
-	Remove_From_Front_Of_Page_List(&s_freeList);
 
 	/* Mark page as having been allocated. */
+	page->flags &= ~(PAGE_ZEROED);
 	page->flags |= PAGE_ALLOCATED;
 	g_freePageCount--;
 	result = (void*) Get_Page_Address(page);
@@ -202,6 +226,91 @@ void* Alloc_Page(void)
     return result;
 }
 
+/*
+ * Allocate a page of physical memory filled with zeroes.
+ * A page zeroed ahead of time by the idle thread is used
+ * if one is available.
+ */
+void* Alloc_Zeroed_Page(void)
+{
+    struct Page* page;
+    void *result;
+
+    bool iflag = Begin_Int_Atomic();
+
+    if (!Is_Page_List_Empty(&s_zeroedList)) {
+	page = Remove_From_Front_Of_Page_List(&s_zeroedList);
+	KASSERT((page->flags & PAGE_ALLOCATED) == 0);
+	page->flags &= ~(PAGE_ZEROED);
+	page->flags |= PAGE_ALLOCATED;
+	s_numZeroedPages--;
+	g_freePageCount--;
+	s_zeroedStats.poolHits++;
+	End_Int_Atomic(iflag);
+	return (void*) Get_Page_Address(page);
+    }
+
+    s_zeroedStats.poolMisses++;
+    End_Int_Atomic(iflag);
+
+    /* Have to clear it ourselves */
+    result = Alloc_Page();
+    if (result != 0)
+	memset(result, '\0', PAGE_SIZE);
+    return result;
+}
+
+/*
+ * Zero one page from the freelist and move it to the pool of
+ * pre-zeroed pages, unless the pool is already full.
+ * Called by the idle thread.
+ * Returns true if a page was zeroed, false if there was nothing to do.
+ */
+bool Refill_Zeroed_Page_Pool(void)
+{
+    struct Page *page;
+    bool iflag;
+
+    iflag = Begin_Int_Atomic();
+    if (s_numZeroedPages >= ZEROED_POOL_TARGET || Is_Page_List_Empty(&s_freeList)) {
+	End_Int_Atomic(iflag);
+	return false;
+    }
+
+    /*
+     * Keep the page off both lists while we clear it, and mark
+     * it allocated so Alloc_Pages() doesn't take it either.
+     */
+    page = Remove_From_Front_Of_Page_List(&s_freeList);
+    page->flags |= PAGE_ALLOCATED;
+    g_freePageCount--;
+    End_Int_Atomic(iflag);
+
+    memset((void*) Get_Page_Address(page), '\0', PAGE_SIZE);
+
+    iflag = Begin_Int_Atomic();
+    page->flags &= ~(PAGE_ALLOCATED);
+    page->flags |= PAGE_ZEROED;
+    Add_To_Back_Of_Page_List(&s_zeroedList, page);
+    s_numZeroedPages++;
+    g_freePageCount++;
+    s_zeroedStats.pagesZeroed++;
+    End_Int_Atomic(iflag);
+
+    return true;
+}
+
+/*
+ * Get a snapshot of the pre-zeroed page pool counters.
+ */
+void Get_Zeroed_Page_Stats(struct Zeroed_Page_Stats *stats)
+{
+    bool iflag = Begin_Int_Atomic();
+    *stats = s_zeroedStats;
+    stats->poolPages = s_numZeroedPages;
+    End_Int_Atomic(iflag);
+}
+
 /*
  * Choose a page to evict.
  * Returns null if no pages are available.
@@ -227,16 +336,197 @@ static struct Page *Find_Page_To_Page_Out()
     return best;
 }
 
-/**
- * Allocate a page of pageable physical memory, to be mapped
- * into a user address space.
- *
- * @param entry pointer to user page table entry which will
- *   refer to the allocated page
- * @param vaddr virtual address where page will be mapped
- *   in user address space
+/*
+ * Is given page resident, pageable, and not busy?
  */
-void* Alloc_Pageable_Page(pte_t *entry, ulong_t vaddr)
+static bool Is_Page_Evictable(struct Page *page)
+{
+    return (page->flags & PAGE_PAGEABLE) &&
+	(page->flags & PAGE_ALLOCATED) &&
+	!(page->flags & PAGE_LOCKED);
+}
+
+/*
+ * Build a cluster of pages to evict, starting with the
+ * least recently used pageable page and continuing with the
+ * pages mapped at the following virtual addresses, as long as
+ * they share its page table and are themselves evictable.
+ * Writing such a cluster to consecutive paging file slots
+ * lets the fault path read it back with a single request.
+ * Returns the number of pages placed in the victims array.
+ */
+static int Find_Cluster_To_Page_Out(struct Page *victims[], int maxPages)
+{
+    struct Page *page;
+    int count;
+
+    page = Find_Page_To_Page_Out();
+    if (page == 0)
+	return 0;
+    victims[0] = page;
+
+    for (count = 1; count < maxPages; ++count) {
+	pte_t *next = victims[0]->entry + count;
+	struct Page *nextPage;
+
+	if (PAGE_TABLE_INDEX(victims[0]->vaddr) + count >= NUM_PAGE_TABLE_ENTRIES ||
+	    !next->present)
+	    break;
+	nextPage = Get_Page(next->pageBaseAddr << PAGE_POWER);
+	if (!Is_Page_Evictable(nextPage) || nextPage->entry != next)
+	    break;
+	victims[count] = nextPage;
+    }
+
+    return count;
+}
+
+/*
+ * Steal a page from another process by evicting a cluster of
+ * victim pages.  Victims go to the compressed pool if they fit;
+ * the rest are written to consecutive slots of the paging file
+ * with a single request.  The first evicted page is returned to
+ * the caller; the rest are put back on the freelist.
+ * Interrupts must be disabled.
+ * Returns the address of the page, or null if no page
+ * could be evicted.
+ */
+static void *Page_Out_Cluster(void)
+{
+    struct Page *victims[PAGING_CLUSTER_MAX];
+    void *paddrs[PAGING_CLUSTER_MAX];
+    ulong_t clusterStart;
+    int handles[PAGING_CLUSTER_MAX];
+    int diskSlots[PAGING_CLUSTER_MAX];
+    void *diskPaddrs[PAGING_CLUSTER_MAX];
+    int numVictims, numDisk, pagefileIndex = -1, i, rc;
+    void *result = 0;
+
+    KASSERT(!Interrupts_Enabled());
+
+    Debug("About to hunt for pages to page out\n");
+    numVictims = Find_Cluster_To_Page_Out(victims, PAGING_CLUSTER_MAX);
+    if (numVictims == 0)
+	return 0;
+
+    for (i = 0; i < numVictims; ++i) {
+	/* Make the page temporarily unpageable (can't let another process steal it) */
+	victims[i]->flags &= ~(PAGE_PAGEABLE);
+
+	/* Lock the page so it cannot be freed while we're writing */
+	victims[i]->flags |= PAGE_LOCKED;
+
+	paddrs[i] = (void*) Get_Page_Address(victims[i]);
+
+	/*
+	 * Unmap the page, so its owner can't change it while it is
+	 * compressed or written out; a fault on it waits for us.
+	 */
+	victims[i]->entry->present = 0;
+	victims[i]->entry->kernelInfo = KINFO_PAGE_PAGING_OUT;
+    }
+    clusterStart = victims[0]->vaddr;
+
+    /* The cluster is virtually contiguous; flush just its pages */
+    Flush_TLB_Range(clusterStart, numVictims);
+
+    /* Let the compressed pool spill cold pages to disk if it is full */
+    Enable_Interrupts();
+    Zswap_Make_Room(numVictims);
+    Disable_Interrupts();
+
+    /* Pages which the pool won't take are bound for the paging file */
+    numDisk = 0;
+    for (i = 0; i < numVictims; ++i) {
+	handles[i] = Zswap_Store(paddrs[i], victims[i]->entry);
+	diskSlots[i] = -1;
+	if (handles[i] < 0) {
+	    diskSlots[i] = numDisk;
+	    diskPaddrs[numDisk++] = paddrs[i];
+	} else if (victims[i]->flags & PAGE_ALLOCATED) {
+	    /* Point the page table at the pool before the pool can spill it */
+	    victims[i]->entry->kernelInfo = KINFO_PAGE_COMPRESSED;
+	    victims[i]->entry->pageBaseAddr = handles[i];
+	} else {
+	    Zswap_Invalidate(handles[i]);
+	}
+    }
+
+    if (numDisk > 0) {
+	/* Find a place on disk for them, shrinking the cluster if space is fragmented */
+	while ((pagefileIndex = Find_Run_On_Paging_File(numDisk)) < 0 && numDisk > 1)
+	    numDisk /= 2;
+	if (pagefileIndex >= 0) {
+	    Debug("Paging out %d page(s) to index %d\n", numDisk, pagefileIndex);
+
+	    /* Write the pages to disk. Interrupts are enabled, since the I/O may block. */
+	    Enable_Interrupts();
+	    rc = Write_Cluster_To_Paging_File(diskPaddrs, numDisk, pagefileIndex);
+	    Disable_Interrupts();
+
+	    if (rc != 0) {
+		for (i = 0; i < numDisk; ++i)
+		    Free_Space_On_Paging_File(pagefileIndex + i);
+		pagefileIndex = -1;
+	    }
+	}
+    }
+
+    for (i = 0; i < numVictims; ++i) {
+	struct Page *page = victims[i];
+	bool stillInUse = (page->flags & PAGE_ALLOCATED) != 0;
+	bool evicted = true;
+
+	if (handles[i] >= 0) {
+	    /* Already handed to the compressed pool */
+	} else if (pagefileIndex >= 0 && diskSlots[i] < numDisk) {
+	    /* While we were writing got notification this page isn't even needed anymore */
+	    if (stillInUse) {
+		/* The page is still in use update its bookeping info */
+		/* Update page table to reflect the page being on disk */
+		page->entry->kernelInfo = KINFO_PAGE_ON_DISK;
+		page->entry->pageBaseAddr = pagefileIndex + diskSlots[i]; /* Remember where it is located! */
+	    } else {
+		/* The page got freed, don't need bookeeping or it on disk */
+		Free_Space_On_Paging_File(pagefileIndex + diskSlots[i]);
+	    }
+	} else {
+	    /* Nowhere to put it; unless its owner freed it, it stays */
+	    evicted = !stillInUse;
+	    if (stillInUse) {
+		page->entry->present = 1;
+		page->entry->kernelInfo = 0;
+	    }
+	}
+
+	/* Unlock the page */
+	page->flags &= ~(PAGE_LOCKED);
+
+	if (!evicted) {
+	    page->flags |= PAGE_PAGEABLE;
+	} else if (result == 0) {
+	    /* Its still allocated though to us now */
+	    page->flags |= PAGE_ALLOCATED;
+	    result = paddrs[i];
+	} else {
+	    /* Put the rest of the cluster back on the freelist */
+	    page->flags &= ~(PAGE_ALLOCATED);
+	    Add_To_Back_Of_Page_List(&s_freeList, page);
+	    g_freePageCount++;
+	}
+    }
+
+    /* Let threads which faulted on the cluster try again */
+    Wake_Up(&s_pageOutWaitQueue);
+
+    return result;
+}
+
+/*
+ * Allocate a pageable page, evicting other pages if necessary,
+ * and optionally clear it.
+ */
+static void* Alloc_Pageable(pte_t *entry, ulong_t vaddr, bool zeroed)
 {
     bool iflag;
     void* paddr = 0;
@@ -247,63 +537,19 @@ void* Alloc_Pageable_Page(pte_t *entry, ulong_t vaddr)
     KASSERT(!Interrupts_Enabled());
     KASSERT(Is_Page_Multiple(vaddr));
 
-    paddr = Alloc_Page();
-    if (paddr != 0) {
-	page = Get_Page((ulong_t) paddr);
-	KASSERT((page->flags & PAGE_PAGEABLE) == 0);
-    } else {
-	int pagefileIndex;
-
-        /* Select a page to steal from another process */
-	Debug("About to hunt for a page to page out\n");
-	page = Find_Page_To_Page_Out();
-	KASSERT(page->flags & PAGE_PAGEABLE);
-	paddr = (void*) Get_Page_Address(page);
-	Debug("Selected page at addr %p (age = %d)\n", paddr, page->clock);
-
-	/* Find a place on disk for it */
-	pagefileIndex = Find_Space_On_Paging_File();
-	if (pagefileIndex < 0)
-	    /* No space available in paging file. */
+    /* Leave the last free pages to the kernel heap */
+    if (g_freePageCount > KERNEL_HEAP_RESERVE_PAGES)
+	paddr = zeroed ? Alloc_Zeroed_Page() : Alloc_Page();
+    if (paddr == 0) {
+	/* Select pages to steal from other processes */
+	paddr = Page_Out_Cluster();
+	if (paddr == 0)
 	    goto done;
-	Debug("Free disk page at index %d\n", pagefileIndex);
-
-	/* Make the page temporarily unpageable (can't let another process steal it) */
-	page->flags &= ~(PAGE_PAGEABLE);
-
-	/* Lock the page so it cannot be freed while we're writing */
-        page->flags |= PAGE_LOCKED;
-
-	/* Write the page to disk. Interrupts are enabled, since the I/O may block. */
-	Debug("Writing physical frame %p to paging file at %d\n", paddr, pagefileIndex);
-	Enable_Interrupts();
-	Write_To_Paging_File(paddr, page->vaddr, pagefileIndex);
-	Disable_Interrupts();
-
-        /* While we were writing got notification this page isn't even needed anymore */
-        if (page->flags & PAGE_ALLOCATED)
-        {
-           /* The page is still in use update its bookeping info */
-           /* Update page table to reflect the page being on disk */
-           page->entry->present = 0;
-           page->entry->kernelInfo = KINFO_PAGE_ON_DISK;
-           page->entry->pageBaseAddr = pagefileIndex; /* Remember where it is located! */
-        }
-        else
-        {
-           /* The page got freed, don't need bookeeping or it on disk */
-           Free_Space_On_Paging_File(pagefileIndex);
-
-           /* Its still allocated though to us now */
-           page->flags |= PAGE_ALLOCATED;
-        }
-
-        /* Unlock the page */
-        page->flags &= ~(PAGE_LOCKED);
-
-	/* XXX - flush TLB should only flush the one page */
-	Flush_TLB();
+	if (zeroed)
+	    memset(paddr, '\0', PAGE_SIZE);
     }
+    page = Get_Page((ulong_t) paddr);
+    KASSERT((page->flags & PAGE_PAGEABLE) == 0);
 
     /* Fill in accounting information for page */
     page->flags |= PAGE_PAGEABLE;
@@ -317,6 +563,34 @@ done:
     return paddr;
 }
 
+/**
+ * Allocate a page of pageable physical memory, to be mapped
+ * into a user address space.
+ *
+ * @param entry pointer to user page table entry which will
+ *   refer to the allocated page
+ * @param vaddr virtual address where page will be mapped
+ *   in user address space
+ */
+void* Alloc_Pageable_Page(pte_t *entry, ulong_t vaddr)
+{
+    return Alloc_Pageable(entry, vaddr, false);
+}
+
+/**
+ * Allocate a page of pageable physical memory filled with
+ * zeroes, preferring one cleared ahead of time by the idle thread.
+ *
+ * @param entry pointer to user page table entry which will
+ *   refer to the allocated page
+ * @param vaddr virtual address where page will be mapped
+ *   in user address space
+ */
+void* Alloc_Pageable_Zeroed_Page(pte_t *entry, ulong_t vaddr)
+{
+    return Alloc_Pageable(entry, vaddr, true);
+}
+
 /*
  * Free a page of physical memory.
  */
@@ -350,3 +624,143 @@ void Free_Page(void* pageAddr)
 
     End_Int_Atomic(iflag);
 }
+
+/*
+ * Allocate numPages physically contiguous pages, for kernel
+ * buffers larger than a page.  Free pages are scattered over
+ * the free and pre-zeroed lists, so this searches the page
+ * array for a long enough run of them.
+ * Returns the address of the first page, or null if there
+ * is no such run.
+ */
+void* Alloc_Pages(int numPages)
+{
+    ulong_t start, i, run = 0;
+    void *result = 0;
+    bool iflag;
+
+    KASSERT(numPages > 0);
+    if (numPages == 1)
+	return Alloc_Page();
+
+    iflag = Begin_Int_Atomic();
+
+    for (i = 1; i < s_numPages; ++i) {
+	if ((g_pageList[i].flags & ~(PAGE_ZEROED)) != PAGE_AVAIL) {
+	    run = 0;
+	    continue;
+	}
+	if (++run < (ulong_t) numPages)
+	    continue;
+
+	/* Found a run: take its pages off whichever list they are on */
+	start = i + 1 - numPages;
+	for (i = start; i < start + numPages; ++i) {
+	    struct Page *page = &g_pageList[i];
+	    if (page->flags & PAGE_ZEROED) {
+		Remove_From_Page_List(&s_zeroedList, page);
+		s_numZeroedPages--;
+	    } else {
+		Remove_From_Page_List(&s_freeList, page);
+	    }
+	    page->flags = PAGE_ALLOCATED;
+	    g_freePageCount--;
+	}
+	result = (void*) Get_Page_Address(&g_pageList[start]);
+	break;
+    }
+
+    End_Int_Atomic(iflag);
+
+    return result;
+}
+
+/*
+ * Free pages allocated with Alloc_Pages().
+ */
+void Free_Pages(void* pageAddr, int numPages)
+{
+    int i;
+
+    for (i = 0; i < numPages; ++i)
+	Free_Page((char*) pageAddr + i * PAGE_SIZE);
+}
+
+/*
+ * Wait for the eviction that unmapped a page to finish.
+ * The faulting thread then retries its access.
+ * Interrupts must be disabled.
+ */
+void Wait_For_Page_Out(void)
+{
+    KASSERT(!Interrupts_Enabled());
+    Wait(&s_pageOutWaitQueue);
+}
+
+#ifdef STRING_BENCHMARK
+
+/*
+ * Time the common library's block memory routines on buffers from
+ * 8 bytes to 64K, moving the same total number of bytes at each size
+ * so short buffers show the per-call overhead.  The move is an
+ * overlapping one to a higher address, so it exercises the
+ * backwards copy.
+ */
+#define BENCH_MAX_SIZE		(64 * 1024)
+#define BENCH_BYTES_PER_SIZE	(4 * 1024 * 1024)
+
+enum { BENCH_MEMSET, BENCH_MEMCPY, BENCH_MEMMOVE, BENCH_MEMCMP, BENCH_NUM_OPS };
+
+static ulong_t Time_String_Op(int op, uchar_t *src, uchar_t *dst, ulong_t size)
+{
+    ulong_t i, iters = BENCH_BYTES_PER_SIZE / size, ns;
+    unsigned long long start;
+    static volatile int sink;
+
+    start = Get_Monotonic_Time_NS();
+    for (i = 0; i < iters; ++i) {
+	switch (op) {
+	case BENCH_MEMSET: memset(dst, (int) i, size); break;
+	case BENCH_MEMCPY: memcpy(dst, src, size); break;
+	case BENCH_MEMMOVE: memmove(src + 1, src, size); break;
+	case BENCH_MEMCMP: sink += memcmp(src, dst, size); break;
+	}
+    }
+    ns = (ulong_t) (Get_Monotonic_Time_NS() - start);
+
+    /* Bytes per microsecond is MB/s */
+    return ns == 0 ? 0 :
+	(ulong_t) Div_64_32((unsigned long long) iters * size * 1000, ns);
+}
+
+void String_Benchmark(void)
+{
+    uchar_t *src, *dst;
+    ulong_t size;
+    int op;
+
+    src = Malloc(BENCH_MAX_SIZE + 4);
+    dst = Malloc(BENCH_MAX_SIZE + 4);
+    if (src == 0 || dst == 0) {
+	Print("string: benchmark could not allocate buffers\n");
+	goto done;
+    }
+    memset(src, 0, BENCH_MAX_SIZE + 4);
+    memset(dst, 0, BENCH_MAX_SIZE + 4);
+
+    Print("string: MB/s      memset  memcpy memmove  memcmp\n");
+    for (size = 8; size <= BENCH_MAX_SIZE; size *= 2) {
+	Print("string: %6lu  ", size);
+	for (op = 0; op < BENCH_NUM_OPS; ++op)
+	    Print(" %7lu", Time_String_Op(op, src, dst, size));
+	Print("\n");
+    }
+
+done:
+    if (src != 0)
+	Free(src);
+    if (dst != 0)
+	Free(dst);
+}
+
+#endif /* STRING_BENCHMARK */
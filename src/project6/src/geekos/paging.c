@@ -21,12 +21,21 @@
 #include <geekos/user.h>
 #include <geekos/vfs.h>
 #include <geekos/crc32.h>
+#include <geekos/bitset.h>
+#include <geekos/blockdev.h>
+#include <geekos/synch.h>
+#include <geekos/errno.h>
+#include <geekos/cpu.h>
+#include <geekos/timer.h>
+#include <geekos/zswap.h>
 #include <geekos/paging.h>
 
 /* ----------------------------------------------------------------------
  * Public data
  * ---------------------------------------------------------------------- */
 
+int g_checksumPagingFile = 1;
+
 /* ----------------------------------------------------------------------
  * Private functions/data
  * ---------------------------------------------------------------------- */
@@ -39,6 +48,153 @@
 int debugFaults = 0;
 #define Debug(args...) if (debugFaults) Print(args)
 
+/*
+ * The paging device, and a bitmap recording which page sized
+ * chunks of it are in use.
+ */
+static struct Paging_Device *s_pagingDevice;
+static void *s_pagingFileBitmap;
+static int s_numPagingFilePages;
+
+/*
+ * CRC of the page last written to each chunk of the paging file,
+ * or null if paging file checksums are disabled.
+ */
+static ulong_t *s_pagingFileChecksums;
+
+/*
+ * Bounce buffer used to gather (and scatter) a cluster of
+ * physically discontiguous pages, so that the whole cluster
+ * can be moved to or from the paging file by one block request.
+ */
+static char *s_clusterBuf;
+static struct Mutex s_clusterBufLock;
+
+/*
+ * Paging file activity counters.
+ */
+static struct Paging_Stats s_pagingStats;
+
+/*
+ * Transfer numPages pages between memory and the paging file,
+ * starting at given chunk of the paging file.
+ */
+static int Paging_File_IO(enum Request_Type type, void *buf, int numPages, int pagefileIndex)
+{
+    struct Block_Device *dev = s_pagingDevice->dev;
+    int blockNum = s_pagingDevice->startSector + pagefileIndex * SECTORS_PER_PAGE;
+    int rc;
+
+    KASSERT(pagefileIndex >= 0 && pagefileIndex + numPages <= s_numPagingFilePages);
+
+    if (type == BLOCK_READ)
+	rc = Block_Read_Multiple(dev, blockNum, numPages * SECTORS_PER_PAGE, buf);
+    else
+	rc = Block_Write_Multiple(dev, blockNum, numPages * SECTORS_PER_PAGE, buf);
+
+    if (rc != 0)
+	Print("Paging file I/O error %d at index %d (%d pages)\n", rc, pagefileIndex, numPages);
+
+    return rc;
+}
+
+/*
+ * Find the page table entry for given user virtual address,
+ * or null if there is no page table covering the address.
+ */
+static pte_t *Find_Page_Table_Entry(pde_t *pageDir, ulong_t vaddr)
+{
+    pde_t *pde = &pageDir[PAGE_DIRECTORY_INDEX(vaddr)];
+    pte_t *pageTable;
+
+    if (!pde->present)
+	return 0;
+    pageTable = (pte_t*) (pde->pageTableBaseAddr << PAGE_POWER);
+    return &pageTable[PAGE_TABLE_INDEX(vaddr)];
+}
+
+/*
+ * Bring the page whose paging file contents are referred to by
+ * given page table entry back into memory.
+ *
+ * Pages are swapped out in clusters of virtually adjacent pages
+ * occupying consecutive paging file slots, so we read ahead:
+ * following entries in the same page table whose contents are
+ * in the next slots of the paging file are read by the same
+ * block request, as long as free pages are available for them.
+ *
+ * Interrupts must be disabled.
+ * Returns 0 if successful, error code otherwise.
+ */
+static int Page_In(pte_t *entry, ulong_t vaddr)
+{
+    extern uint_t g_freePageCount;
+    void *paddrs[PAGING_CLUSTER_MAX];
+    int pagefileIndex = entry->pageBaseAddr;
+    int count, i, rc;
+
+    KASSERT(!Interrupts_Enabled());
+    KASSERT(entry->kernelInfo == KINFO_PAGE_ON_DISK);
+
+    /* Extend the request over consecutive slots of this page table */
+    count = 1;
+    while (count < PAGING_CLUSTER_MAX &&
+	   PAGE_TABLE_INDEX(vaddr) + count < NUM_PAGE_TABLE_ENTRIES) {
+	pte_t *next = entry + count;
+	if (next->present || next->kernelInfo != KINFO_PAGE_ON_DISK ||
+	    next->pageBaseAddr != pagefileIndex + count)
+	    break;
+	++count;
+    }
+
+    /*
+     * The faulting page may steal a page from somebody else;
+     * readahead only uses free pages above the kernel heap's
+     * reserve, so it never causes an eviction.
+     */
+    for (i = 0; i < count; ++i) {
+	struct Page *page;
+
+	if (i > 0 && g_freePageCount <= KERNEL_HEAP_RESERVE_PAGES)
+	    break;
+	paddrs[i] = Alloc_Pageable_Page(entry + i, vaddr + i * PAGE_SIZE);
+	if (paddrs[i] == 0) {
+	    if (i == 0)
+		return ENOMEM;
+	    break;
+	}
+
+	/* Keep the page from being stolen or freed while the read is in progress */
+	page = Get_Page((ulong_t) paddrs[i]);
+	page->flags &= ~(PAGE_PAGEABLE);
+	page->flags |= PAGE_LOCKED;
+    }
+    count = i;
+    Debug("Paging in %d page(s) at %lx from index %d\n", count, vaddr, pagefileIndex);
+
+    Enable_Interrupts();
+    rc = Read_Cluster_From_Paging_File(paddrs, count, pagefileIndex);
+    Disable_Interrupts();
+
+    for (i = 0; i < count; ++i) {
+	struct Page *page = Get_Page((ulong_t) paddrs[i]);
+
+	page->flags &= ~(PAGE_LOCKED);
+	if (rc == 0) {
+	    Free_Space_On_Paging_File(pagefileIndex + i);
+	    entry[i].pageBaseAddr = PAGE_ALLIGNED_ADDR(paddrs[i]);
+	    entry[i].present = 1;
+	    page->flags |= PAGE_PAGEABLE;
+	} else {
+	    /* Leave the entries referring to the paging file */
+	    entry[i].kernelInfo = KINFO_PAGE_ON_DISK;
+	    Free_Page(paddrs[i]);
+	}
+    }
+
+    return rc;
+}
+
 
 void checkPaging()
 {
@@ -48,6 +204,43 @@ void checkPaging()
 }
 
 
+/*
+ * Bring a page held in the compressed pool back into memory.
+ * Interrupts must be disabled.
+ * Returns 0 if successful, error code otherwise.
+ */
+static int Page_In_Compressed(pte_t *entry, ulong_t vaddr)
+{
+    int handle = entry->pageBaseAddr;
+    void *paddr;
+
+    KASSERT(!Interrupts_Enabled());
+    KASSERT(entry->kernelInfo == KINFO_PAGE_COMPRESSED);
+
+    paddr = Alloc_Pageable_Page(entry, vaddr);
+    if (paddr == 0) {
+	entry->kernelInfo = KINFO_PAGE_COMPRESSED;
+	return ENOMEM;
+    }
+
+    /*
+     * Allocating the page may have evicted other pages, and
+     * possibly spilled this one to the paging file.
+     */
+    if (!Zswap_Holds(handle, entry)) {
+	Free_Page(paddr);
+	entry->kernelInfo = KINFO_PAGE_ON_DISK;
+	return Page_In(entry, vaddr);
+    }
+
+    Debug("Paging in %lx from compressed pool entry %d\n", vaddr, handle);
+    Zswap_Load(handle, paddr);
+    entry->pageBaseAddr = PAGE_ALLIGNED_ADDR(paddr);
+    entry->present = 1;
+
+    return 0;
+}
+
 /*
  * Print diagnostic information for a page fault.
  */
@@ -90,6 +283,42 @@ static void Print_Fault_Info(uint_t address, faultcode_t faultCode)
     /* Get the fault code */
     faultCode = *((faultcode_t *) &(state->errorCode));
 
+    /* Is the page in the compressed pool or the paging file? */
+    if (!faultCode.protectionViolation && g_currentThread->userContext != 0) {
+	pte_t *entry = Find_Page_Table_Entry(g_currentThread->userContext->pageDir, address);
+	if (entry != 0 && !entry->present && entry->kernelInfo == KINFO_PAGE_PAGING_OUT) {
+	    Wait_For_Page_Out();
+	    return;
+	} else if (entry != 0 && !entry->present && entry->kernelInfo != 0) {
+	    /* Not every CPU has a TSC, so use the timer's clock */
+	    unsigned long long start = Get_Monotonic_Time_NS();
+	    ulong_t usecs;
+	    int rc;
+
+	    if (entry->kernelInfo == KINFO_PAGE_COMPRESSED) {
+		rc = Page_In_Compressed(entry, Round_Down_To_Page(address));
+		usecs = (ulong_t) Div_64_32(Get_Monotonic_Time_NS() - start, 1000);
+		s_pagingStats.zswapFaults++;
+		s_pagingStats.zswapFaultUsecs += usecs;
+	    } else {
+		rc = Page_In(entry, Round_Down_To_Page(address));
+		usecs = (ulong_t) Div_64_32(Get_Monotonic_Time_NS() - start, 1000);
+		s_pagingStats.diskFaults++;
+		s_pagingStats.diskFaultUsecs += usecs;
+	    }
+	    if (rc == 0)
+		return;
+	    Print("Could not page in address %lx\n", address);
+	} else if ((entry == 0 || (!entry->present && entry->kernelInfo == 0)) &&
+		   address >= USER_SEGMENT_BASE + g_currentThread->userContext->heapStart &&
+		   address < USER_SEGMENT_BASE + g_currentThread->userContext->heapEnd) {
+	    /* First touch of a heap page */
+	    if (Map_User_Heap_Page(g_currentThread->userContext, address) == 0)
+		return;
+	    Print("Could not allocate heap page at %lx\n", address);
+	}
+    }
+
     /* rest of your handling code here */
     Print ("Unexpected Page Fault received\n");
     Print_Fault_Info(address, faultCode);
@@ -106,6 +335,8 @@ static void Print_Fault_Info(uint_t address, faultcode_t faultCode)
  * ---------------------------------------------------------------------- */
 
 
+pde_t *g_kernelPageDir;
+
 /*
  * Initialize virtual memory by building page tables
  * for the kernel and physical memory.
@@ -114,7 +345,8 @@ void Init_VM(struct Boot_Info *bootInfo)
 {
     /*
      * Hints:
-     * - Build kernel page directory and page tables
+     * - Build kernel page directory and page tables,
+     *   and store the page directory in g_kernelPageDir
      * - Call Enable_Paging() with the kernel page directory
      * - Install an interrupt handler for interrupt 14,
      *   page fault
@@ -124,6 +356,26 @@ void Init_VM(struct Boot_Info *bootInfo)
     TODO("Build initial kernel page directory and page tables");
 }
 
+/**
+ * Invalidate the TLB entries for a range of pages.
+ * Large ranges fall back to flushing the entire TLB.
+ * @param vaddr address of the first page
+ * @param numPages number of pages in the range
+ */
+void Flush_TLB_Range(ulong_t vaddr, ulong_t numPages)
+{
+    ulong_t i;
+
+    if (numPages > TLB_FLUSH_RANGE_THRESHOLD) {
+	Flush_TLB();
+	return;
+    }
+
+    vaddr = Round_Down_To_Page(vaddr);
+    for (i = 0; i < numPages; ++i)
+	Flush_TLB_Page(vaddr + i * PAGE_SIZE);
+}
+
 /**
  * Initialize paging file data structures.
  * All filesystems should be mounted before this function
@@ -131,7 +383,28 @@ void Init_VM(struct Boot_Info *bootInfo)
  */
 void Init_Paging(void)
 {
-    TODO("Initialize paging file data structures");
+    Init_Zswap();
+
+    s_pagingDevice = Get_Paging_Device();
+    if (s_pagingDevice == 0) {
+	Print("No paging file; paging disabled\n");
+	return;
+    }
+
+    s_numPagingFilePages = s_pagingDevice->numSectors / SECTORS_PER_PAGE;
+    s_pagingFileBitmap = Create_Bit_Set(s_numPagingFilePages);
+    s_clusterBuf = Malloc(PAGING_CLUSTER_MAX * PAGE_SIZE);
+    if (s_pagingFileBitmap == 0 || s_clusterBuf == 0)
+	Panic("Could not allocate paging file data structures\n");
+    if (g_checksumPagingFile) {
+	s_pagingFileChecksums = Malloc(s_numPagingFilePages * sizeof(ulong_t));
+	if (s_pagingFileChecksums == 0)
+	    Panic("Could not allocate paging file checksums\n");
+    }
+    Mutex_Init(&s_clusterBufLock);
+
+    Print("Paging file %s: %d pages%s\n", s_pagingDevice->fileName, s_numPagingFilePages,
+	s_pagingFileChecksums != 0 ? ", checksummed" : "");
 }
 
 /**
@@ -142,8 +415,35 @@ void Init_Paging(void)
  */
 int Find_Space_On_Paging_File(void)
 {
+    return Find_Run_On_Paging_File(1);
+}
+
+/**
+ * Find numPages consecutive free page sized chunks of disk space
+ * on the paging file, and mark them as used.
+ * Interrupts must be disabled.
+ * @param numPages number of chunks needed
+ * @return index of the first chunk, or -1 if the paging file
+ *   has no run of free space that long
+ */
+int Find_Run_On_Paging_File(int numPages)
+{
+    int pagefileIndex, i;
+
     KASSERT(!Interrupts_Enabled());
-    TODO("Find free page in paging file");
+    KASSERT(numPages > 0 && numPages <= PAGING_CLUSTER_MAX);
+
+    if (s_pagingFileBitmap == 0)
+	return -1;
+
+    pagefileIndex = Find_First_N_Free(s_pagingFileBitmap, numPages, s_numPagingFilePages);
+    if (pagefileIndex < 0)
+	return -1;
+
+    for (i = 0; i < numPages; ++i)
+	Set_Bit(s_pagingFileBitmap, pagefileIndex + i);
+
+    return pagefileIndex;
 }
 
 /**
@@ -154,7 +454,9 @@ int Find_Space_On_Paging_File(void)
 void Free_Space_On_Paging_File(int pagefileIndex)
 {
     KASSERT(!Interrupts_Enabled());
-    TODO("Free page in paging file");
+    KASSERT(pagefileIndex >= 0 && pagefileIndex < s_numPagingFilePages);
+    KASSERT(Is_Bit_Set(s_pagingFileBitmap, pagefileIndex));
+    Clear_Bit(s_pagingFileBitmap, pagefileIndex);
 }
 
 /**
@@ -167,9 +469,7 @@ void Free_Space_On_Paging_File(int pagefileIndex)
  */
 void Write_To_Paging_File(void *paddr, ulong_t vaddr, int pagefileIndex)
 {
-    struct Page *page = Get_Page((ulong_t) paddr);
-    KASSERT(!(page->flags & PAGE_PAGEABLE)); /* Page must be locked! */
-    TODO("Write page data to paging file");
+    Write_Cluster_To_Paging_File(&paddr, 1, pagefileIndex);
 }
 
 /**
@@ -183,8 +483,160 @@ void Write_To_Paging_File(void *paddr, ulong_t vaddr, int pagefileIndex)
  */
 void Read_From_Paging_File(void *paddr, ulong_t vaddr, int pagefileIndex)
 {
-    struct Page *page = Get_Page((ulong_t) paddr);
-    KASSERT(!(page->flags & PAGE_PAGEABLE)); /* Page must be locked! */
-    TODO("Read page data from paging file");
+    Read_Cluster_From_Paging_File(&paddr, 1, pagefileIndex);
+}
+
+/**
+ * Write a cluster of pages to consecutive chunks of space
+ * in the paging file, using a single block request.
+ * Interrupts must be enabled, since the I/O may block.
+ * @param paddrs physical addresses of the (locked) pages
+ * @param numPages number of pages in the cluster
+ * @param pagefileIndex index of the first chunk of space
+ * @return 0 if successful, error code otherwise
+ */
+int Write_Cluster_To_Paging_File(void *paddrs[], int numPages, int pagefileIndex)
+{
+    ulong_t checksums[PAGING_CLUSTER_MAX];
+    int i, rc;
+
+    KASSERT(Interrupts_Enabled());
+    KASSERT(numPages > 0 && numPages <= PAGING_CLUSTER_MAX);
+    for (i = 0; i < numPages; ++i) {
+	struct Page *page = Get_Page((ulong_t) paddrs[i]);
+	KASSERT(!(page->flags & PAGE_PAGEABLE)); /* Page must be locked! */
+    }
+
+    /* The pages are locked, so their contents can't change under us */
+    if (s_pagingFileChecksums != 0) {
+	for (i = 0; i < numPages; ++i)
+	    checksums[i] = crc32(0, paddrs[i], PAGE_SIZE);
+    }
+
+    if (numPages == 1) {
+	/* A single page is already contiguous; no need to copy it */
+	rc = Paging_File_IO(BLOCK_WRITE, paddrs[0], 1, pagefileIndex);
+    } else {
+	Mutex_Lock(&s_clusterBufLock);
+	for (i = 0; i < numPages; ++i)
+	    memcpy(s_clusterBuf + i * PAGE_SIZE, paddrs[i], PAGE_SIZE);
+	rc = Paging_File_IO(BLOCK_WRITE, s_clusterBuf, numPages, pagefileIndex);
+	Mutex_Unlock(&s_clusterBufLock);
+    }
+
+    /* Only count pages that actually made it to the paging file */
+    if (rc == 0) {
+	Disable_Interrupts();
+	if (s_pagingFileChecksums != 0) {
+	    for (i = 0; i < numPages; ++i)
+		s_pagingFileChecksums[pagefileIndex + i] = checksums[i];
+	}
+	s_pagingStats.pagesOut += numPages;
+	s_pagingStats.writeOps++;
+	Enable_Interrupts();
+    }
+
+    return rc;
 }
 
+/**
+ * Read consecutive chunks of space in the paging file into
+ * a cluster of pages, using a single block request.
+ * Interrupts must be enabled, since the I/O may block.
+ * @param paddrs physical addresses of the (locked) pages
+ * @param numPages number of pages in the cluster
+ * @param pagefileIndex index of the first chunk of space
+ * @return 0 if successful, error code otherwise
+ */
+int Read_Cluster_From_Paging_File(void *paddrs[], int numPages, int pagefileIndex)
+{
+    int i, rc;
+
+    KASSERT(Interrupts_Enabled());
+    KASSERT(numPages > 0 && numPages <= PAGING_CLUSTER_MAX);
+    for (i = 0; i < numPages; ++i) {
+	struct Page *page = Get_Page((ulong_t) paddrs[i]);
+	KASSERT(!(page->flags & PAGE_PAGEABLE)); /* Page must be locked! */
+    }
+
+    if (numPages == 1) {
+	rc = Paging_File_IO(BLOCK_READ, paddrs[0], 1, pagefileIndex);
+    } else {
+	Mutex_Lock(&s_clusterBufLock);
+	rc = Paging_File_IO(BLOCK_READ, s_clusterBuf, numPages, pagefileIndex);
+	if (rc == 0) {
+	    for (i = 0; i < numPages; ++i)
+		memcpy(paddrs[i], s_clusterBuf + i * PAGE_SIZE, PAGE_SIZE);
+	}
+	Mutex_Unlock(&s_clusterBufLock);
+    }
+
+    if (rc == 0 && s_pagingFileChecksums != 0) {
+	for (i = 0; i < numPages; ++i) {
+	    if (crc32(0, paddrs[i], PAGE_SIZE) != s_pagingFileChecksums[pagefileIndex + i]) {
+		Print("Paging file checksum mismatch at index %d\n", pagefileIndex + i);
+		rc = ECHECKSUM;
+		Disable_Interrupts();
+		s_pagingStats.checksumErrors++;
+		Enable_Interrupts();
+	    }
+	}
+    }
+
+    if (rc == 0) {
+	Disable_Interrupts();
+	s_pagingStats.pagesIn += numPages;
+	s_pagingStats.readaheadPages += numPages - 1;
+	s_pagingStats.readOps++;
+	Enable_Interrupts();
+    }
+
+    return rc;
+}
+
+/**
+ * Get a snapshot of the paging file activity counters.
+ * @param stats where to store the counters
+ */
+void Get_Paging_Stats(struct Paging_Stats *stats)
+{
+    bool iflag = Begin_Int_Atomic();
+    *stats = s_pagingStats;
+    End_Int_Atomic(iflag);
+}
+
+/**
+ * Print paging activity for both swap tiers: the compressed
+ * pool and the paging file; and how well the pool of pages
+ * zeroed ahead of time is keeping up.
+ */
+void Print_Paging_Stats(void)
+{
+    struct Paging_Stats stats;
+    struct Zswap_Stats zstats;
+    struct Zeroed_Page_Stats zeroed;
+
+    Get_Paging_Stats(&stats);
+    Get_Zswap_Stats(&zstats);
+    Get_Zeroed_Page_Stats(&zeroed);
+
+    Print("zswap: %lu pages stored (%lu zero, %lu rejected), %lu spilled, %lu loaded\n",
+	zstats.storedPages, zstats.zeroPages, zstats.rejectedPages,
+	zstats.spilledPages, zstats.loadedPages);
+    if (zstats.storedPages > 0)
+	Print("zswap: compressed to %lu%% of original size, pool holds %lu pages in %lu bytes\n",
+	    (zstats.compressedBytes / zstats.storedPages) * 100 / PAGE_SIZE,
+	    zstats.poolEntries, zstats.poolBytes);
+    Print("paging file: %lu pages out in %lu writes, %lu pages in in %lu reads (%lu read ahead)\n",
+	stats.pagesOut, stats.writeOps, stats.pagesIn, stats.readOps, stats.readaheadPages);
+    if (stats.checksumErrors > 0)
+	Print("paging file: %lu pages failed their checksum\n", stats.checksumErrors);
+    if (stats.zswapFaults > 0)
+	Print("fault latency: compressed pool %lu us avg over %lu faults\n",
+	    stats.zswapFaultUsecs / stats.zswapFaults, stats.zswapFaults);
+    if (stats.diskFaults > 0)
+	Print("fault latency: paging file %lu us avg over %lu faults\n",
+	    stats.diskFaultUsecs / stats.diskFaults, stats.diskFaults);
+    Print("zeroed pages: %lu cleared while idle, %lu on hand, %lu allocations hit, %lu missed\n",
+	zeroed.pagesZeroed, zeroed.poolPages, zeroed.poolHits, zeroed.poolMisses);
+}
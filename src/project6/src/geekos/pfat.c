@@ -103,28 +103,17 @@ static int PFAT_FStat(struct File *file, struct VFS_File_Stat *stat)
 }
 
 /*
- * Read function for PFAT files.
+ * Make sure the file data cache holds the given byte range
+ * of a file, reading any blocks it is missing.
+ * Returns 0 if successful, error code (< 0) if not.
  */
-static int PFAT_Read(struct File *file, void *buf, ulong_t numBytes)
+static int PFAT_Fill_Cache(struct File *file, ulong_t start, ulong_t end)
 {
     struct PFAT_File *pfatFile = (struct PFAT_File*) file->fsData;
     struct PFAT_Instance *instance = (struct PFAT_Instance*) file->mountPoint->fsData;
-    ulong_t start = file->filePos;
-    ulong_t end = file->filePos + numBytes;
     ulong_t startBlock, endBlock, curBlock;
     ulong_t i;
 
-    /* Special case: can't handle reads longer than INT_MAX */
-    if (numBytes > INT_MAX)
-	return EINVALID;
-
-    /* Make sure request represents a valid range within the file */
-    if (start >= file->endPos || end > file->endPos || end < start) {
-	Debug("Invalid read position: filePos=%lu, numBytes=%lu, endPos=%lu\n",
-	    file->filePos, numBytes, file->endPos);
-	return EINVALID;
-    }
-
     /*
      * Now the complicated part; ensure that all blocks containing the
      * data we need are in the file data cache.
@@ -174,6 +163,33 @@ static int PFAT_Read(struct File *file, void *buf, ulong_t numBytes)
 	curBlock = nextBlock;
     }
 
+    return 0;
+}
+
+/*
+ * Read function for PFAT files.
+ */
+static int PFAT_Read(struct File *file, void *buf, ulong_t numBytes)
+{
+    struct PFAT_File *pfatFile = (struct PFAT_File*) file->fsData;
+    ulong_t start = file->filePos;
+    ulong_t end = file->filePos + numBytes;
+    int rc;
+
+    /* Special case: can't handle reads longer than INT_MAX */
+    if (numBytes > INT_MAX)
+	return EINVALID;
+
+    /* Make sure request represents a valid range within the file */
+    if (start >= file->endPos || end > file->endPos || end < start) {
+	Debug("Invalid read position: filePos=%lu, numBytes=%lu, endPos=%lu\n",
+	    file->filePos, numBytes, file->endPos);
+	return EINVALID;
+    }
+
+    if ((rc = PFAT_Fill_Cache(file, start, end)) != 0)
+	return rc;
+
     /*
      * All cached data we need is up to date,
      * so just copy it into the caller's buffer.
@@ -185,6 +201,54 @@ static int PFAT_Read(struct File *file, void *buf, ulong_t numBytes)
     return numBytes;
 }
 
+/*
+ * Map_Data function for PFAT files.
+ * The whole file is cached in kernel memory, so once the blocks
+ * are read the data can be handed out in place.
+ */
+static int PFAT_Map_Data(struct File *file, ulong_t numBytes, void **pData)
+{
+    struct PFAT_File *pfatFile = (struct PFAT_File*) file->fsData;
+    ulong_t start = file->filePos;
+    int rc;
+
+    if (start >= file->endPos)
+	return 0;
+    if (numBytes > file->endPos - start)
+	numBytes = file->endPos - start;
+    if (numBytes > INT_MAX)
+	numBytes = INT_MAX;
+
+    if ((rc = PFAT_Fill_Cache(file, start, start + numBytes)) != 0)
+	return rc;
+
+    *pData = pfatFile->fileDataCache + start;
+    return numBytes;
+}
+
+/*
+ * Read_At function for PFAT files.
+ * Reads stop short at end of file.
+ */
+static int PFAT_Read_At(struct File *file, ulong_t pos, void *buf, ulong_t numBytes)
+{
+    struct PFAT_File *pfatFile = (struct PFAT_File*) file->fsData;
+    int rc;
+
+    if (pos >= file->endPos)
+	return 0;
+    if (numBytes > file->endPos - pos)
+	numBytes = file->endPos - pos;
+    if (numBytes > INT_MAX)
+	numBytes = INT_MAX;
+
+    if ((rc = PFAT_Fill_Cache(file, pos, pos + numBytes)) != 0)
+	return rc;
+
+    memcpy(buf, pfatFile->fileDataCache + pos, numBytes);
+    return numBytes;
+}
+
 /*
  * Write function for PFAT files.
  */
@@ -253,6 +317,9 @@ static struct File_Ops s_pfatFileOps = {
     &PFAT_Close,
     0, /* Read_Entry */
     &PFAT_Clone,
+    &PFAT_Map_Data,
+    &PFAT_Read_At,
+    0, /* Write_At */
 };
 
 static int PFAT_FStat_Dir(struct File *dir, struct VFS_File_Stat *stat)
@@ -9,18 +9,124 @@
 
 #include <geekos/kassert.h>
 #include <geekos/errno.h>
+#include <geekos/mem.h>
+#include <geekos/synch.h>
 #include <geekos/vfs.h>
 #include <geekos/malloc.h>
 #include <geekos/string.h>
 #include <geekos/pipefs.h>
 
+/*
+ * A pipe's data is kept in a ring of pages, which are allocated
+ * as the writer first reaches them and freed with the pipe.
+ * Readers sleep on one condition and writers on another, and
+ * each side only wakes the other: a writer when it adds data, a
+ * reader when it makes room.
+ *
+ * A write arriving while a reader is asleep on an empty pipe,
+ * with a large enough buffer, is copied straight into the
+ * reader's buffer instead of going through the ring.
+ */
+
 /* The amount of storage to allocate for a pipe. */
-#define PIPE_BUF_SIZE 4096
+#define PIPE_NUM_PAGES 16
+#define PIPE_BUF_SIZE (PIPE_NUM_PAGES * PAGE_SIZE)
+
+/* Reads of at least this size may be filled directly by a writer. */
+#define PIPE_DIRECT_MIN PAGE_SIZE
+
+struct Pipe {
+    struct Mutex lock;
+    struct Condition readCond;		 /* Readers wait here for data */
+    struct Condition writeCond;		 /* Writers wait here for room */
+
+    /*
+     * Bytes read and written so far; their difference is the
+     * number of bytes in the ring.
+     */
+    ulong_t readCount, writeCount;
+    char *pages[PIPE_NUM_PAGES];
+
+    /* Open File objects for each end */
+    int numReaders, numWriters;
+
+    /* Buffer of a reader waiting for a direct transfer */
+    char *directBuf;
+    ulong_t directLen, directDone;
+};
 
 /* ----------------------------------------------------------------------
  * Private data and functions
  * ---------------------------------------------------------------------- */
 
+static __inline__ ulong_t Pipe_Count(struct Pipe *pipe)
+{
+    return pipe->writeCount - pipe->readCount;
+}
+
+/*
+ * Copy data into the ring, allocating pages as needed.
+ * There must be room for it.
+ * Returns number of bytes copied, or ENOMEM.
+ */
+static int Copy_To_Ring(struct Pipe *pipe, const char *src, ulong_t numBytes)
+{
+    ulong_t done = 0;
+
+    KASSERT(Pipe_Count(pipe) + numBytes <= PIPE_BUF_SIZE);
+
+    while (done < numBytes) {
+	ulong_t pos = pipe->writeCount % PIPE_BUF_SIZE;
+	ulong_t offset = pos % PAGE_SIZE, n = PAGE_SIZE - offset;
+	char **page = &pipe->pages[pos / PAGE_SIZE];
+
+	if (*page == 0 && (*page = Alloc_Page()) == 0)
+	    return done > 0 ? (int) done : ENOMEM;
+	if (n > numBytes - done)
+	    n = numBytes - done;
+	memcpy(*page + offset, src + done, n);
+	pipe->writeCount += n;
+	done += n;
+    }
+    return (int) done;
+}
+
+/*
+ * Copy data out of the ring.
+ * There must be that much data in it.
+ */
+static void Copy_From_Ring(struct Pipe *pipe, char *dest, ulong_t numBytes)
+{
+    ulong_t done = 0;
+
+    KASSERT(Pipe_Count(pipe) >= numBytes);
+
+    while (done < numBytes) {
+	ulong_t pos = pipe->readCount % PIPE_BUF_SIZE;
+	ulong_t offset = pos % PAGE_SIZE, n = PAGE_SIZE - offset;
+
+	if (n > numBytes - done)
+	    n = numBytes - done;
+	memcpy(dest + done, pipe->pages[pos / PAGE_SIZE] + offset, n);
+	pipe->readCount += n;
+	done += n;
+    }
+}
+
+/*
+ * Free a pipe once both of its ends are closed.
+ */
+static void Destroy_Pipe(struct Pipe *pipe)
+{
+    int i;
+
+    for (i = 0; i < PIPE_NUM_PAGES; ++i) {
+	if (pipe->pages[i] != 0)
+	    Free_Page(pipe->pages[i]);
+    }
+    Free(pipe);
+}
+
 /*
  * Read data from a pipe.
  * Returns number of bytes read, or 0 if end-of-file
@@ -28,7 +134,48 @@
  */
 static int Pipe_Read(struct File *file, void *buf, ulong_t numBytes)
 {
-    TODO("Read from pipe");
+    struct Pipe *pipe = (struct Pipe*) file->fsData;
+    bool direct = false;
+    ulong_t n;
+
+    if (numBytes == 0)
+	return 0;
+
+    Mutex_Lock(&pipe->lock);
+
+    while (Pipe_Count(pipe) == 0 && pipe->numWriters > 0) {
+	/* Offer our buffer to the next writer */
+	if (numBytes >= PIPE_DIRECT_MIN && pipe->directBuf == 0) {
+	    pipe->directBuf = buf;
+	    pipe->directLen = numBytes;
+	    pipe->directDone = 0;
+	    direct = true;
+	}
+
+	Cond_Wait(&pipe->readCond, &pipe->lock);
+
+	if (direct) {
+	    n = pipe->directDone;
+	    pipe->directBuf = 0;
+	    pipe->directDone = 0;
+	    direct = false;
+	    if (n > 0) {
+		Mutex_Unlock(&pipe->lock);
+		return (int) n;
+	    }
+	}
+    }
+
+    n = Pipe_Count(pipe);
+    if (n > numBytes)
+	n = numBytes;
+    if (n > 0) {
+	Copy_From_Ring(pipe, buf, n);
+	Cond_Signal(&pipe->writeCond);
+    }
+
+    Mutex_Unlock(&pipe->lock);
+    return (int) n;
 }
 
 /*
@@ -37,7 +184,56 @@ static int Pipe_Read(struct File *file, void *buf, ulong_t numBytes)
  */
 static int Pipe_Write(struct File *file, void *buf, ulong_t numBytes)
 {
-    TODO("Write to pipe");
+    struct Pipe *pipe = (struct Pipe*) file->fsData;
+    const char *src = (const char*) buf;
+    ulong_t done = 0;
+    int rc = 0;
+
+    Mutex_Lock(&pipe->lock);
+
+    while (done < numBytes) {
+	ulong_t n = numBytes - done, room;
+
+	if (pipe->numReaders == 0) {
+	    rc = EPIPE;
+	    break;
+	}
+
+	/* Hand a large write straight to a waiting reader */
+	if (pipe->directBuf != 0 && pipe->directDone == 0 && Pipe_Count(pipe) == 0 &&
+	    n >= PIPE_DIRECT_MIN) {
+	    if (n > pipe->directLen)
+		n = pipe->directLen;
+	    memcpy(pipe->directBuf, src + done, n);
+	    pipe->directDone = n;
+	    done += n;
+	    /* Other readers may be waiting too; make sure it's woken */
+	    Cond_Broadcast(&pipe->readCond);
+	    continue;
+	}
+
+	room = PIPE_BUF_SIZE - Pipe_Count(pipe);
+	if (room == 0) {
+	    Cond_Wait(&pipe->writeCond, &pipe->lock);
+	    continue;
+	}
+
+	if (n > room)
+	    n = room;
+	rc = Copy_To_Ring(pipe, src + done, n);
+	if (rc > 0) {
+	    done += rc;
+	    Cond_Signal(&pipe->readCond);
+	}
+	if (rc < 0 || (ulong_t) rc < n) {
+	    if (rc >= 0)
+		rc = ENOMEM;
+	    break;
+	}
+    }
+
+    Mutex_Unlock(&pipe->lock);
+    return done > 0 ? (int) done : rc;
 }
 
 /*
@@ -45,7 +241,27 @@ static int Pipe_Write(struct File *file, void *buf, ulong_t numBytes)
  */
 static int Pipe_Close(struct File *file)
 {
-    TODO("Close a pipe");
+    struct Pipe *pipe = (struct Pipe*) file->fsData;
+    bool destroy;
+
+    Mutex_Lock(&pipe->lock);
+    if (file->ops->Read != 0) {
+	KASSERT(pipe->numReaders > 0);
+	/* Writers get EPIPE once there are no readers */
+	if (--pipe->numReaders == 0)
+	    Cond_Broadcast(&pipe->writeCond);
+    } else {
+	KASSERT(pipe->numWriters > 0);
+	/* Readers see end of file once there are no writers */
+	if (--pipe->numWriters == 0)
+	    Cond_Broadcast(&pipe->readCond);
+    }
+    destroy = (pipe->numReaders == 0 && pipe->numWriters == 0);
+    Mutex_Unlock(&pipe->lock);
+
+    if (destroy)
+	Destroy_Pipe(pipe);
+    return 0;
 }
 
 /*
@@ -53,7 +269,22 @@ static int Pipe_Close(struct File *file)
  */
 static int Pipe_Clone(struct File *file, struct File **pClone)
 {
-    TODO("Clone a pipe");
+    struct Pipe *pipe = (struct Pipe*) file->fsData;
+    struct File *clone;
+
+    clone = Allocate_File(file->ops, 0, 0, pipe, file->mode, 0);
+    if (clone == 0)
+	return ENOMEM;
+
+    Mutex_Lock(&pipe->lock);
+    if (file->ops->Read != 0)
+	pipe->numReaders++;
+    else
+	pipe->numWriters++;
+    Mutex_Unlock(&pipe->lock);
+
+    *pClone = clone;
+    return 0;
 }
 
 static struct File_Ops s_readPipeFileOps = {
@@ -68,7 +299,7 @@ static struct File_Ops s_readPipeFileOps = {
 
 static struct File_Ops s_writePipeFileOps = {
     0,			/* FStat() */
-    0,			/* Write() */
+    0,			/* Read() */
     &Pipe_Write,
     0,			/* Seek() */
     &Pipe_Close,
@@ -83,23 +314,26 @@ static struct File_Ops s_writePipeFileOps = {
 int Create_Pipe(struct File **pRead, struct File **pWrite)
 {
     int rc = 0;
+    struct Pipe *pipe;
     struct File *read = 0, *write = 0;
 
+    /* Allocate the pipe; both ends share it */
+    pipe = (struct Pipe*) Malloc(sizeof(*pipe));
+    if (pipe == 0)
+	return ENOMEM;
+    memset(pipe, '\0', sizeof(*pipe));
+    Mutex_Init(&pipe->lock);
+    Cond_Init(&pipe->readCond);
+    Cond_Init(&pipe->writeCond);
+    pipe->numReaders = pipe->numWriters = 1;
+
     /* Allocate File objects */
-    if ((read = Allocate_File(&s_readPipeFileOps, 0, 0, 0, O_READ, 0)) == 0 ||
-	(write = Allocate_File(&s_writePipeFileOps, 0, 0, 0, O_WRITE, 0)) == 0) {
+    if ((read = Allocate_File(&s_readPipeFileOps, 0, 0, pipe, O_READ, 0)) == 0 ||
+	(write = Allocate_File(&s_writePipeFileOps, 0, 0, pipe, O_WRITE, 0)) == 0) {
 	rc = ENOMEM;
 	goto done;
     }
 
-    /*
-     * TODO: you should allocate a data structure for managing the
-     * pipe, and store it in the fsData field of the read and
-     * write pipes.  It will need a reference count field
-     * in order to destroy it when the last File connected
-     * to the pipe is closed.
-     */
-
     *pRead = read;
     *pWrite = write;
     KASSERT(rc == 0);
@@ -110,6 +344,7 @@ done:
 	    Free(read);
 	if (write != 0)
 	    Free(write);
+	Free(pipe);
     }
     return rc;
 }
@@ -14,6 +14,7 @@
 #include <geekos/int.h>
 #include <geekos/fmtout.h>
 #include <geekos/screen.h>
+#include <geekos/serial.h>
 
 /*
  * Information sources for VT100 and ANSI escape sequences:
@@ -347,6 +348,39 @@ again:
     }
 }
 
+/*
+ * Find how much of a buffer about to be written can be skipped
+ * because it would scroll off the screen before the end of the
+ * buffer.  That is so for everything before the last NUMROWS
+ * newlines: starting at the beginning of a line, those lines
+ * (and any that wrap) fill the whole screen by themselves.
+ * Only plain text is skipped, since an escape sequence could
+ * change the attribute or move the cursor.
+ * Returns number of bytes which can be skipped.
+ */
+static ulong_t Find_Scrolled_Off(const char* buf, ulong_t length)
+{
+    ulong_t i = length, skip;
+    int numNewlines = 0;
+
+    if (s_cons.state != S_NORMAL)
+	return 0;
+
+    while (i > 0) {
+	if (buf[--i] == '\n' && ++numNewlines > NUMROWS)
+	    break;
+    }
+    if (numNewlines <= NUMROWS)
+	return 0;
+
+    skip = i + 1;
+    while (i > 0) {
+	if (buf[--i] == ESC)
+	    return 0;
+    }
+    return skip;
+}
+
 /*
  * Update the location of the hardware cursor.
  */
@@ -495,11 +529,28 @@ void Put_String(const char* s)
 
 /*
  * Write a buffer of characters at current cursor position
- * using current attribute.
+ * using current attribute.  Lines which would scroll off
+ * before the end of the buffer aren't drawn, and the cursor
+ * is only updated at the end.
  */
 void Put_Buf(const char* buf, ulong_t length)
 {
     bool iflag = Begin_Int_Atomic();
+    ulong_t skip = Find_Scrolled_Off(buf, length);
+
+    if (skip > 0) {
+#ifndef NDEBUG
+	ulong_t i;
+	for (i = 0; i < skip; ++i)
+	    Out_Byte(0xE9, buf[i]);
+#endif
+	/* Draw the rest on a clear screen; it scrolls as needed */
+	Clear_Screen();
+	s_cons.row = s_cons.col = 0;
+	buf += skip;
+	length -= skip;
+    }
+
     while (length > 0) {
 	Put_Char_Imp(*buf++);
 	--length;
@@ -508,9 +559,32 @@ void Put_Buf(const char* buf, ulong_t length)
     End_Int_Atomic(iflag);
 }
 
-/* Support for Print(). */
-static void Print_Emit(struct Output_Sink *o, int ch) { Put_Char_Imp(ch); }
-static void Print_Finish(struct Output_Sink *o) { Update_Cursor(); }
+/*
+ * Support for Print(); output is mirrored to the serial port,
+ * a buffer at a time.  Print() runs with interrupts disabled,
+ * so a single buffer is enough.
+ */
+#define PRINT_SERIAL_BUF_SIZE 128
+static char s_printSerialBuf[PRINT_SERIAL_BUF_SIZE];
+static ulong_t s_printSerialLen;
+
+static void Print_Emit(struct Output_Sink *o, int ch)
+{
+    Put_Char_Imp(ch);
+    s_printSerialBuf[s_printSerialLen++] = (char) ch;
+    if (s_printSerialLen == PRINT_SERIAL_BUF_SIZE) {
+	Serial_Write(s_printSerialBuf, s_printSerialLen);
+	s_printSerialLen = 0;
+    }
+}
+static void Print_Finish(struct Output_Sink *o)
+{
+    Update_Cursor();
+    if (s_printSerialLen > 0) {
+	Serial_Write(s_printSerialBuf, s_printSerialLen);
+	s_printSerialLen = 0;
+    }
+}
 static struct Output_Sink s_outputSink = { &Print_Emit, &Print_Finish };
 
 /*
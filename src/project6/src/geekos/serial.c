@@ -0,0 +1,222 @@
+/*
+ * 16550 UART (serial port) driver
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <geekos/kthread.h>
+#include <geekos/kassert.h>
+#include <geekos/screen.h>
+#include <geekos/int.h>
+#include <geekos/irq.h>
+#include <geekos/io.h>
+#include <geekos/serial.h>
+
+/*
+ * Output to COM1 is transmit-only and interrupt driven: writers
+ * copy bytes into a ring buffer and return, and the interrupt
+ * handler refills the UART's FIFO each time it drains.  So a
+ * program printing its results isn't held up waiting for the
+ * line, unless it gets more than a ring's worth ahead of it.
+ * When that happens a thread waits for space; with interrupts
+ * disabled (or in an interrupt handler) we push bytes out by
+ * polling instead.
+ */
+
+/* ----------------------------------------------------------------------
+ * Private data and functions
+ * ---------------------------------------------------------------------- */
+
+#define TX_RING_SIZE 4096
+#define TX_RING_MASK (TX_RING_SIZE - 1)
+
+static char s_txRing[TX_RING_SIZE];
+static ulong_t s_txHead, s_txTail;	 /* Bytes are added at tail, sent from head */
+
+/* Threads waiting for room in the ring */
+static struct Thread_Queue s_txWaitQueue;
+
+/* Current contents of the interrupt enable register */
+static uchar_t s_ier;
+
+bool g_serialPresent;
+
+static __inline__ void Serial_Out(int reg, uchar_t value)
+{
+    Out_Byte(SERIAL_BASE_PORT + reg, value);
+}
+
+static __inline__ uchar_t Serial_In(int reg)
+{
+    return In_Byte(SERIAL_BASE_PORT + reg);
+}
+
+static __inline__ ulong_t Tx_Ring_Count(void)
+{
+    return s_txTail - s_txHead;
+}
+
+/*
+ * Move bytes from the ring to the UART, if its transmitter is
+ * empty, and have it interrupt us while there is more to send.
+ * Interrupts must be disabled.
+ */
+static void Fill_Tx_FIFO(void)
+{
+    uchar_t ier;
+    int n;
+
+    KASSERT(!Interrupts_Enabled());
+
+    if ((Serial_In(SERIAL_LSR) & LSR_THR_EMPTY) != 0 && Tx_Ring_Count() > 0) {
+	for (n = 0; n < SERIAL_FIFO_SIZE && Tx_Ring_Count() > 0; ++n)
+	    Serial_Out(SERIAL_THR, s_txRing[s_txHead++ & TX_RING_MASK]);
+	Wake_Up(&s_txWaitQueue);
+    }
+
+    ier = Tx_Ring_Count() > 0 ? (s_ier | IER_THR_EMPTY) : (s_ier & ~IER_THR_EMPTY);
+    if (ier != s_ier) {
+	s_ier = ier;
+	Serial_Out(SERIAL_IER, ier);
+    }
+}
+
+/*
+ * Wait until some bytes have moved from the ring to the UART.
+ * Interrupts must be disabled; iflag says whether they were
+ * enabled on entry to the caller, so that sleeping is allowed.
+ */
+static void Wait_For_Tx_Progress(bool iflag)
+{
+    KASSERT(!Interrupts_Enabled());
+
+    if (iflag && g_currentThread != 0) {
+	/* Make sure the transmitter is running, so we'll be woken */
+	Fill_Tx_FIFO();
+	Wait(&s_txWaitQueue);
+    } else {
+	while ((Serial_In(SERIAL_LSR) & LSR_THR_EMPTY) == 0)
+	    ;
+	Fill_Tx_FIFO();
+    }
+}
+
+/*
+ * Add a byte to the transmit ring, waiting for room if necessary.
+ */
+static void Enqueue_Tx_Byte(char c, bool iflag)
+{
+    while (Tx_Ring_Count() == TX_RING_SIZE)
+	Wait_For_Tx_Progress(iflag);
+    s_txRing[s_txTail++ & TX_RING_MASK] = c;
+}
+
+/*
+ * Handler for serial port interrupts.
+ */
+static void Serial_Interrupt_Handler(struct Interrupt_State* state)
+{
+    uchar_t iir;
+
+    Begin_IRQ(state);
+
+    while (((iir = Serial_In(SERIAL_IIR)) & IIR_NO_INT) == 0) {
+	switch (iir & IIR_ID_MASK) {
+	case IIR_THR_EMPTY:
+	    Fill_Tx_FIFO();
+	    break;
+	case IIR_RX_DATA: case IIR_RX_TIMEOUT:
+	    /* Input isn't used; discard it */
+	    while (Serial_In(SERIAL_LSR) & LSR_DATA_READY)
+		Serial_In(SERIAL_RBR);
+	    break;
+	case IIR_LSR:
+	    Serial_In(SERIAL_LSR);
+	    break;
+	default:
+	    Serial_In(SERIAL_MSR);
+	    break;
+	}
+    }
+
+    End_IRQ(state);
+}
+
+/* ----------------------------------------------------------------------
+ * Public functions
+ * ---------------------------------------------------------------------- */
+
+/*
+ * Initialize COM1 for output at 115200 baud, 8N1, if there is one.
+ * Interrupts must have been initialized.
+ */
+void Init_Serial(void)
+{
+    /* Check that a UART is there by looping a byte back through it */
+    Serial_Out(SERIAL_IER, 0);
+    Serial_Out(SERIAL_MCR, MCR_LOOPBACK | MCR_RTS | MCR_DTR);
+    Serial_Out(SERIAL_THR, 0xAE);
+    if (Serial_In(SERIAL_RBR) != 0xAE) {
+	Print("No serial port found\n");
+	return;
+    }
+
+    Print("Initializing serial port...\n");
+
+    Serial_Out(SERIAL_LCR, LCR_DLAB);
+    Serial_Out(SERIAL_DLL, SERIAL_DIVISOR & 0xff);
+    Serial_Out(SERIAL_DLM, SERIAL_DIVISOR >> 8);
+    Serial_Out(SERIAL_LCR, LCR_8N1);
+    Serial_Out(SERIAL_FCR, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX | FCR_TRIGGER_14);
+    Serial_Out(SERIAL_MCR, MCR_OUT2 | MCR_RTS | MCR_DTR);
+
+    s_txHead = s_txTail = 0;
+    s_ier = 0;
+
+    Install_IRQ(SERIAL_IRQ, Serial_Interrupt_Handler);
+    Enable_IRQ(SERIAL_IRQ);
+
+    g_serialPresent = true;
+}
+
+/*
+ * Queue a buffer of characters for output to the serial port,
+ * turning newlines into CR/LF pairs.  Returns once they are all
+ * queued; may wait for room if called from a thread with
+ * interrupts enabled.
+ */
+void Serial_Write(const char *buf, ulong_t length)
+{
+    bool iflag;
+
+    if (!g_serialPresent)
+	return;
+
+    iflag = Begin_Int_Atomic();
+    while (length-- > 0) {
+	char c = *buf++;
+	if (c == '\n')
+	    Enqueue_Tx_Byte('\r', iflag);
+	Enqueue_Tx_Byte(c, iflag);
+    }
+    Fill_Tx_FIFO();
+    End_Int_Atomic(iflag);
+}
+
+/*
+ * Wait until everything queued has been handed to the UART.
+ */
+void Serial_Flush(void)
+{
+    bool iflag;
+
+    if (!g_serialPresent)
+	return;
+
+    iflag = Begin_Int_Atomic();
+    while (Tx_Ring_Count() > 0)
+	Wait_For_Tx_Progress(iflag);
+    End_Int_Atomic(iflag);
+}
@@ -181,6 +181,36 @@ void Cond_Wait(struct Condition* cond, struct Mutex* mutex)
     g_preemptionDisabled = false;
 }
 
+/*
+ * Wait on given condition (protected by given mutex) for at
+ * most the given number of microseconds.  The mutex is held
+ * again on return, whether or not the wait timed out.
+ * Returns 0 if signaled, ETIMEDOUT if the timeout expired,
+ * or ENOMEM if no timer could be started.
+ */
+int Cond_Timed_Wait(struct Condition* cond, struct Mutex* mutex, int us)
+{
+    int rc;
+
+    KASSERT(Interrupts_Enabled());
+    KASSERT(IS_HELD(mutex));
+
+    /* Same as Cond_Wait(), but with a timeout on the wait */
+    g_preemptionDisabled = true;
+    Mutex_Unlock_Imp(mutex);
+
+    Disable_Interrupts();
+    g_preemptionDisabled = false;
+    rc = Wait_Timeout(&cond->waitQueue, us);
+    g_preemptionDisabled = true;
+    Enable_Interrupts();
+
+    Mutex_Lock_Imp(mutex);
+    g_preemptionDisabled = false;
+
+    return rc;
+}
+
 /*
  * Wake up one thread waiting on the given condition.
  * The mutex guarding the condition should be held!
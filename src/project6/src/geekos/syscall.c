@@ -8,6 +8,7 @@
  * redistribute, and modify it as specified in the file "COPYING".
  */
 
+#include <limits.h>
 #include <geekos/syscall.h>
 #include <geekos/errno.h>
 #include <geekos/kthread.h>
@@ -20,6 +21,7 @@
 #include <geekos/user.h>
 #include <geekos/timer.h>
 #include <geekos/vfs.h>
+#include <geekos/paging.h>
 
 /*
  * Null system call.
@@ -149,19 +151,337 @@ static int Sys_Wait(struct Interrupt_State* state)
  */
 static int Sys_GetPID(struct Interrupt_State* state)
 {
-    TODO("GetPID system call");
+    return g_currentThread->pid;
+}
+
+/*
+ * Find out whether the kernel data pages (see vdso.h) are mapped
+ * in the current process, so libc can read the clock and pid there.
+ * Params:
+ *   state - processor registers from user mode
+ * Returns: 1 if they are mapped, 0 if not
+ */
+static int Sys_HasVDSO(struct Interrupt_State* state)
+{
+    return g_currentThread->userContext->vdsoData != 0;
 }
 
 /*
  * Set the scheduling policy.
  * Params:
- *   state->ebx - policy,
+ *   state->ebx - policy (SCHED_RR, SCHED_MLF, or SCHED_FAIR),
  *   state->ecx - number of ticks in quantum
- * Returns: 0 if successful, -1 otherwise
+ * Returns: 0 if successful, error code (< 0) otherwise
  */
 static int Sys_SetSchedulingPolicy(struct Interrupt_State* state)
 {
-    TODO("SetSchedulingPolicy system call");
+    return Set_Scheduling_Policy((int) state->ebx, (int) state->ecx);
+}
+
+/*
+ * Set the nice value of the current process.
+ * Params:
+ *   state->ebx - nice value, NICE_MIN to NICE_MAX
+ * Returns: 0 if successful, error code (< 0) otherwise
+ */
+static int Sys_SetNice(struct Interrupt_State* state)
+{
+    return Set_Nice(g_currentThread, (int) state->ebx);
+}
+
+/*
+ * Get CPU usage and scheduling times for the current process.
+ * Params:
+ *   state->ebx - pointer to user struct Process_Times
+ * Returns: 0 if successful, error code (< 0) otherwise
+ */
+static int Sys_GetProcessTimes(struct Interrupt_State* state)
+{
+    struct Process_Times times;
+
+    Get_Process_Times(g_currentThread, &times);
+    if (!Copy_To_User(state->ebx, &times, sizeof(times)))
+	return EINVALID;
+    return 0;
+}
+
+/*
+ * Get kernel heap usage statistics.
+ * Params:
+ *   state->ebx - pointer to user struct Heap_Stats
+ * Returns: 0 if successful, error code (< 0) otherwise
+ */
+static int Sys_GetHeapStats(struct Interrupt_State* state)
+{
+    struct Heap_Stats stats;
+
+    Get_Heap_Stats(&stats);
+    if (!Copy_To_User(state->ebx, &stats, sizeof(stats)))
+	return EINVALID;
+    return 0;
+}
+
+/*
+ * Print statistics for the compressed pool and the paging file
+ * on the console.
+ * Params: none
+ * Returns: 0
+ */
+static int Sys_PrintPagingStats(struct Interrupt_State* state)
+{
+    Print_Paging_Stats();
+    return 0;
+}
+
+/*
+ * Move the end of the current process's heap.
+ * Params:
+ *   state->ebx - user address of the new end of the heap,
+ *     or 0 to leave it where it is
+ * Returns: the end of the heap, or error code (< 0)
+ */
+static int Sys_Brk(struct Interrupt_State* state)
+{
+    struct User_Context *userContext = g_currentThread->userContext;
+
+    if (state->ebx != 0) {
+	int rc = Set_User_Heap_End(userContext, state->ebx);
+	if (rc != 0)
+	    return rc;
+    }
+    return (int) userContext->heapEnd;
+}
+
+/*
+ * Look up an open file of the current process by its descriptor.
+ * Params:
+ *   fd - the file descriptor
+ *   pFile - where to store the File object
+ * Returns: 0 if successful, or EINVALID if fd is not open
+ */
+static int Get_Open_File(int fd, struct File **pFile)
+{
+    struct User_Context *userContext = g_currentThread->userContext;
+
+    if (fd < 0 || fd >= USER_MAX_FILES || userContext->fileList[fd] == 0)
+	return EINVALID;
+    *pFile = userContext->fileList[fd];
+    return 0;
+}
+
+/*
+ * Move data between two open files without copying it
+ * through user space.
+ * Params:
+ *   state->ebx - file descriptor to read from
+ *   state->ecx - file descriptor to write to
+ *   state->edx - maximum number of bytes to move
+ * Returns: number of bytes moved, 0 if end of file,
+ *   or error code (< 0) on error
+ */
+static int Sys_Splice(struct Interrupt_State *state)
+{
+    struct File *in, *out;
+    int rc;
+
+    if ((rc = Get_Open_File((int) state->ebx, &in)) != 0 ||
+	(rc = Get_Open_File((int) state->ecx, &out)) != 0)
+	return rc;
+    return Splice(in, out, state->edx);
+}
+
+/*
+ * Read from given position of an open file, without using or
+ * changing its current position.
+ * Params:
+ *   state->ebx - file descriptor to read from
+ *   state->ecx - position in file to read from
+ *   state->edx - user address of buffer to read into
+ *   state->esi - number of bytes to read
+ *
+ * Returns: number of bytes read, 0 if end of file,
+ *   or error code (< 0) on error
+ */
+static int Sys_ReadAt(struct Interrupt_State *state)
+{
+    struct File *file;
+    ulong_t len = state->esi;
+    void *buf;
+    int rc;
+
+    if ((rc = Get_Open_File((int) state->ebx, &file)) != 0)
+	return rc;
+    if (len == 0)
+	return 0;
+    if (len > INT_MAX)
+	return EINVALID;
+    if ((buf = Malloc(len)) == 0)
+	return ENOMEM;
+
+    rc = Read_At(file, state->ecx, buf, len);
+    if (rc > 0 && !Copy_To_User(state->edx, buf, rc))
+	rc = EINVALID;
+
+    Free(buf);
+    return rc;
+}
+
+/*
+ * Write at given position of an open file, without using or
+ * changing its current position.
+ * Params:
+ *   state->ebx - file descriptor to write to
+ *   state->ecx - position in file to write at
+ *   state->edx - user address of buffer containing data to write
+ *   state->esi - number of bytes to write
+ *
+ * Returns: number of bytes written, or error code (< 0) on error
+ */
+static int Sys_WriteAt(struct Interrupt_State *state)
+{
+    struct File *file;
+    ulong_t len = state->esi;
+    void *buf;
+    int rc;
+
+    if ((rc = Get_Open_File((int) state->ebx, &file)) != 0)
+	return rc;
+    if (len == 0)
+	return 0;
+    if (len > INT_MAX)
+	return EINVALID;
+    if ((buf = Malloc(len)) == 0)
+	return ENOMEM;
+
+    if (Copy_From_User(buf, state->edx, len))
+	rc = Write_At(file, state->ecx, buf, len);
+    else
+	rc = EINVALID;
+
+    Free(buf);
+    return rc;
+}
+
+/*
+ * Copy in a user's I/O vector, and set up a matching vector of
+ * kernel buffers, carved one after another from a single block.
+ * Params:
+ *   userVec - user address of array of struct IO_Vector
+ *   count - number of buffers, at most IO_VECTOR_MAX
+ *   vec - where to store the user's vector
+ *   kvec - where to store the vector of kernel buffers
+ *   pBuf - where to store the block, or null if there is none
+ * Returns: total length of the buffers, or error code (< 0)
+ */
+static int Copy_In_IO_Vector(ulong_t userVec, int count,
+    struct IO_Vector *vec, struct IO_Vector *kvec, char **pBuf)
+{
+    ulong_t total = 0;
+    char *buf;
+    int i;
+
+    *pBuf = 0;
+    if (count < 0 || count > IO_VECTOR_MAX)
+	return EINVALID;
+    if (!Copy_From_User(vec, userVec, count * sizeof(struct IO_Vector)))
+	return EINVALID;
+
+    /* The total is returned as an int, so it must fit in one */
+    for (i = 0; i < count; ++i) {
+	if (vec[i].len > (ulong_t) INT_MAX - total)
+	    return EINVALID;
+	total += vec[i].len;
+    }
+    if (total == 0)
+	return 0;
+
+    if ((buf = Malloc(total)) == 0)
+	return ENOMEM;
+    *pBuf = buf;
+    for (i = 0; i < count; ++i) {
+	kvec[i].buf = buf;
+	kvec[i].len = vec[i].len;
+	buf += vec[i].len;
+    }
+    return (int) total;
+}
+
+/*
+ * Read from an open file into several buffers in turn.
+ * Params:
+ *   state->ebx - file descriptor to read from
+ *   state->ecx - user address of array of struct IO_Vector
+ *   state->edx - number of buffers, at most IO_VECTOR_MAX
+ *
+ * Returns: total number of bytes read, 0 if end of file,
+ *   or error code (< 0) on error
+ */
+static int Sys_ReadVector(struct Interrupt_State *state)
+{
+    struct IO_Vector vec[IO_VECTOR_MAX], kvec[IO_VECTOR_MAX];
+    struct File *file;
+    int count = (int) state->edx;
+    char *buf = 0;
+    int rc, done, i;
+
+    if ((rc = Get_Open_File((int) state->ebx, &file)) != 0)
+	return rc;
+    if ((rc = Copy_In_IO_Vector(state->ecx, count, vec, kvec, &buf)) <= 0)
+	goto done;
+
+    rc = Read_Vector(file, kvec, count);
+
+    /* Copy out what was read, filling the user's buffers in turn */
+    for (i = 0, done = 0; rc > 0 && done < rc; ++i) {
+	ulong_t len = kvec[i].len;
+
+	if (len > (ulong_t) (rc - done))
+	    len = rc - done;
+	if (!Copy_To_User((ulong_t) vec[i].buf, kvec[i].buf, len)) {
+	    rc = EINVALID;
+	    break;
+	}
+	done += len;
+    }
+
+done:
+    if (buf != 0) Free(buf);
+    return rc;
+}
+
+/*
+ * Write several buffers in turn to an open file.
+ * Params:
+ *   state->ebx - file descriptor to write to
+ *   state->ecx - user address of array of struct IO_Vector
+ *   state->edx - number of buffers, at most IO_VECTOR_MAX
+ *
+ * Returns: total number of bytes written, or error code (< 0) on error
+ */
+static int Sys_WriteVector(struct Interrupt_State *state)
+{
+    struct IO_Vector vec[IO_VECTOR_MAX], kvec[IO_VECTOR_MAX];
+    struct File *file;
+    int count = (int) state->edx;
+    char *buf = 0;
+    int rc, i;
+
+    if ((rc = Get_Open_File((int) state->ebx, &file)) != 0)
+	return rc;
+    if ((rc = Copy_In_IO_Vector(state->ecx, count, vec, kvec, &buf)) <= 0)
+	goto done;
+
+    for (i = 0; i < count; ++i) {
+	if (!Copy_From_User(kvec[i].buf, (ulong_t) vec[i].buf, vec[i].len)) {
+	    rc = EINVALID;
+	    goto done;
+	}
+    }
+    rc = Write_Vector(file, kvec, count);
+
+done:
+    if (buf != 0) Free(buf);
+    return rc;
 }
 
 /*
@@ -173,7 +493,38 @@ static int Sys_SetSchedulingPolicy(struct Interrupt_State* state)
  */
 static int Sys_GetTimeOfDay(struct Interrupt_State* state)
 {
-    TODO("GetTimeOfDay system call");
+    return g_numTicks;
+}
+
+/*
+ * Get the time elapsed since boot, in nanoseconds.
+ * Params:
+ *   state->ebx - pointer to user unsigned long long where the time
+ *     should be stored
+ * Returns: 0 if successful, error code (< 0) otherwise
+ */
+static int Sys_GetMonotonicTime(struct Interrupt_State* state)
+{
+    unsigned long long now = Get_Monotonic_Time_NS();
+
+    if (!Copy_To_User(state->ebx, &now, sizeof(now)))
+	return EINVALID;
+    return 0;
+}
+
+/*
+ * Sleep for at least the given time.
+ * Params:
+ *   state->ebx - number of microseconds to sleep
+ * Returns: 0 if successful, error code (< 0) otherwise
+ */
+static int Sys_Sleep(struct Interrupt_State* state)
+{
+    int us = (int) state->ebx;
+
+    if (us < 0)
+	return EINVALID;
+    return Sleep(us);
 }
 
 /*
@@ -443,6 +794,106 @@ static int Sys_CreatePipe(struct Interrupt_State *state)
     TODO("CreatePipe system call");
 }
 
+/*
+ * Number of queued operations copied in at a time.
+ */
+#define IO_RING_BATCH 8
+
+/*
+ * Can given system call be queued on an IO_Ring?
+ */
+static bool Is_IO_Ring_Op(int op)
+{
+    switch (op) {
+    case SYS_OPEN: case SYS_OPENDIRECTORY: case SYS_CLOSE:
+    case SYS_DELETE: case SYS_READ: case SYS_READENTRY:
+    case SYS_WRITE: case SYS_STAT: case SYS_FSTAT:
+    case SYS_SEEK: case SYS_CREATEDIR: case SYS_SYNC:
+	return true;
+    default:
+	return false;
+    }
+}
+
+/*
+ * Run the file operations queued on a process's IO_Ring,
+ * posting their results on its completion ring.  Stops when the
+ * submission ring is empty or the completion ring is full.
+ * Each operation is dispatched through the system call table as
+ * if it had been made directly, so this saves the trap, not the
+ * work of the operation.
+ * Params:
+ *   state->ebx - user address of struct IO_Ring
+ * Returns: number of operations run, or error code (< 0)
+ */
+static int Sys_IORingEnter(struct Interrupt_State *state)
+{
+    ulong_t ringAddr = state->ebx;
+    struct IO_Ring_Indices indices;
+    struct IO_Ring_SQE sqes[IO_RING_BATCH];
+    struct IO_Ring_CQE cqe;
+    struct Interrupt_State opState;
+    int count = 0;
+
+    if (!Copy_From_User(&indices, ringAddr, sizeof(indices)))
+	return EINVALID;
+    if (indices.sqTail - indices.sqHead > IO_RING_ENTRIES ||
+	indices.cqTail - indices.cqHead > IO_RING_ENTRIES)
+	return EINVALID;
+
+    while (indices.sqHead != indices.sqTail &&
+	   indices.cqTail - indices.cqHead < IO_RING_ENTRIES) {
+	ulong_t sqSlot = indices.sqHead & (IO_RING_ENTRIES - 1);
+	ulong_t n = indices.sqTail - indices.sqHead, i;
+
+	/* Copy in as many as fit, up to where the ring wraps */
+	if (n > IO_RING_ENTRIES - (indices.cqTail - indices.cqHead))
+	    n = IO_RING_ENTRIES - (indices.cqTail - indices.cqHead);
+	if (n > IO_RING_ENTRIES - sqSlot)
+	    n = IO_RING_ENTRIES - sqSlot;
+	if (n > IO_RING_BATCH)
+	    n = IO_RING_BATCH;
+	if (!Copy_From_User(sqes,
+		ringAddr + offsetof(struct IO_Ring, sq) + sqSlot * sizeof(struct IO_Ring_SQE),
+		n * sizeof(struct IO_Ring_SQE)))
+	    return EINVALID;
+
+	for (i = 0; i < n; ++i) {
+	    struct IO_Ring_SQE *sqe = &sqes[i];
+	    ulong_t cqSlot = indices.cqTail & (IO_RING_ENTRIES - 1);
+
+	    if (Is_IO_Ring_Op(sqe->op)) {
+		opState = *state;
+		opState.eax = sqe->op;
+		opState.ebx = sqe->args[0];
+		opState.ecx = sqe->args[1];
+		opState.edx = sqe->args[2];
+		opState.esi = sqe->args[3];
+		opState.edi = sqe->args[4];
+		cqe.result = g_syscallTable[sqe->op](&opState);
+	    } else
+		cqe.result = EUNSUPPORTED;
+	    cqe.userData = sqe->userData;
+
+	    if (!Copy_To_User(ringAddr + offsetof(struct IO_Ring, cq) + cqSlot * sizeof(cqe),
+		    &cqe, sizeof(cqe)))
+		return EINVALID;
+	    ++indices.sqHead;
+	    ++indices.cqTail;
+	    ++count;
+	}
+
+	/* Publish progress, touching only the indices the kernel owns */
+	if (!Copy_To_User(ringAddr + offsetof(struct IO_Ring_Indices, sqHead),
+		&indices.sqHead, sizeof(ulong_t)) ||
+	    !Copy_To_User(ringAddr + offsetof(struct IO_Ring_Indices, cqTail),
+		&indices.cqTail, sizeof(ulong_t)))
+	    return EINVALID;
+    }
+
+    return count;
+}
+
 
 /*
  * Global table of system call handler functions.
@@ -482,6 +933,28 @@ const Syscall g_syscallTable[] = {
     Sys_Format,
     /* Pipe system calls. */
     Sys_CreatePipe,
+    /* Clock system calls. */
+    Sys_GetMonotonicTime,
+    Sys_Sleep,
+    Sys_SetNice,
+    Sys_GetProcessTimes,
+    /* Batched file I/O system calls. */
+    Sys_IORingEnter,
+    /* Kernel heap statistics system call. */
+    Sys_GetHeapStats,
+    /* Process heap system call. */
+    Sys_Brk,
+    /* In-kernel copy system call. */
+    Sys_Splice,
+    /* Positional and vectored I/O system calls. */
+    Sys_ReadAt,
+    Sys_WriteAt,
+    Sys_ReadVector,
+    Sys_WriteVector,
+    /* Swap statistics system call. */
+    Sys_PrintPagingStats,
+    /* Kernel data pages system call. */
+    Sys_HasVDSO,
 };
 
 /*
@@ -13,14 +13,37 @@
 #include <geekos/int.h>
 #include <geekos/irq.h>
 #include <geekos/kthread.h>
+#include <geekos/malloc.h>
 #include <geekos/timer.h>
+#include <geekos/cpu.h>
+#include <geekos/workqueue.h>
+#include <geekos/vdso.h>
 
-#define MAX_TIMER_EVENTS	100
+/*
+ * Pending timer events are kept in a hashed timing wheel.
+ * Slot i holds the events expiring on ticks congruent to i
+ * modulo TIMER_WHEEL_SIZE; each tick only looks at one slot.
+ * Events are also hashed by id so they can be found quickly
+ * for cancellation.
+ */
+#define TIMER_WHEEL_SIZE	256	 /* must be a power of 2 */
+#define TIMER_ID_HASH_SIZE	256	 /* must be a power of 2 */
+
+IMPLEMENT_LIST(Timer_Event_List, timerEvent);
+IMPLEMENT_LIST(Timer_Id_List, timerEvent);
 
 static int timerDebug = 0;
-static int timeEventCount;
 static int nextEventID;
-timerEvent pendingTimerEvents[MAX_TIMER_EVENTS];
+static struct Timer_Event_List s_timerWheel[TIMER_WHEEL_SIZE];
+static struct Timer_Id_List s_timerIdHash[TIMER_ID_HASH_SIZE];
+
+/*
+ * Expired events whose callbacks have not run yet.  The interrupt
+ * handler only moves events here; the callbacks are run later
+ * by the work thread.
+ */
+static struct Timer_Event_List s_expiredEvents;
+static struct Work_Item s_timerWork;
 
 /*
  * Global tick counter
@@ -34,25 +57,59 @@ static int s_spinCountPerTick;
 
 /*
  * Number of ticks to wait before calibrating the delay loop.
+ * The time stamp counter is calibrated over the same ticks,
+ * so make them span at least a tenth of a second.
  */
-#define CALIBRATE_NUM_TICKS	3
+#define CALIBRATE_NUM_TICKS	(TIMER_HZ / 10 > 3 ? TIMER_HZ / 10 : 3)
 
 /*
- * The default quantum; maximum number of ticks a thread can use before
- * we suspend it and choose another.
+ * The default quantum, in milliseconds; a thread which runs this
+ * long is suspended so another can be chosen.
  */
-#define DEFAULT_MAX_TICKS 4
+#define DEFAULT_QUANTUM_MS	40
 
 /*
- * Settable quantum.
+ * Settable quantum, in ticks.
  */
-int g_Quantum = DEFAULT_MAX_TICKS;
+int g_Quantum = MS_TO_TICKS(DEFAULT_QUANTUM_MS);
 
 /*
- * Ticks per second.
- * FIXME: should set this to something more reasonable, like 100.
+ * PIT channel 0 ports, and the frequency of its input clock.
  */
-#define TICKS_PER_SEC 18
+#define PIT_COMMAND_PORT	0x43
+#define PIT_CHANNEL0_PORT	0x40
+#define PIT_FREQUENCY		1193182
+#define PIT_MAX_COUNT		65535
+
+#if (PIT_FREQUENCY + TIMER_HZ / 2) / TIMER_HZ > 65536 || TIMER_HZ > PIT_FREQUENCY / 2
+#  error "TIMER_HZ is out of the range the PIT can generate"
+#endif
+
+/*
+ * Counter reload value giving one tick.
+ * The PIT treats a programmed value of 0 as 65536.
+ */
+static ulong_t s_pitReload = (PIT_FREQUENCY + TIMER_HZ / 2) / TIMER_HZ;
+
+/*
+ * Time stamp counter calibration.  Cycle counts are converted to
+ * nanoseconds as (cycles * s_tscMult) >> s_tscShift, which avoids
+ * 64 bit division.
+ */
+static bool s_haveTSC;
+static ulong_t s_tscKHz;
+static ulong_t s_tscMult, s_tscShift;
+static unsigned long long s_tscBoot, s_tscCalibrateEnd;
+
+/*
+ * While the idle thread halts, the PIT may be switched to one-shot
+ * mode, programmed to expire at the next pending timer event.
+ * This is the number of ticks the one-shot count covers, or 0
+ * if the timer is ticking periodically.
+ */
+static int s_ticklessTicks;
+
+static struct Timer_Idle_Stats s_idleStats;
 
 /*#define DEBUG_TIMER */
 #ifdef DEBUG_TIMER
@@ -65,27 +122,232 @@ int g_Quantum = DEFAULT_MAX_TICKS;
  * Private functions
  * ---------------------------------------------------------------------- */
 
+/*
+ * Work out the TSC frequency and the cycles to nanoseconds scale
+ * factor from the cycles counted over the calibration ticks.
+ */
+static void Calibrate_TSC(void)
+{
+    unsigned long long cycles = s_tscCalibrateEnd - s_tscBoot;
+
+    s_tscKHz = (ulong_t) Div_64_32(cycles * TIMER_HZ, CALIBRATE_NUM_TICKS * 1000);
+    KASSERT(s_tscKHz > 0);
+
+    /*
+     * ns = cycles * 1000000 / kHz.  Use the largest shift for which
+     * the scaled multiplier (1000000 << shift) / kHz fits in 32 bits.
+     */
+    for (s_tscShift = 32; s_tscShift > 1; --s_tscShift) {
+	if ((ulong_t) ((1000000ULL << s_tscShift) >> 32) < s_tscKHz)
+	    break;
+    }
+    s_tscMult = (ulong_t) Div_64_32(1000000ULL << s_tscShift, s_tscKHz);
+}
+
+/*
+ * Program PIT channel 0 to interrupt once per tick.
+ */
+static void Set_PIT_Periodic(void)
+{
+    /* channel 0, low then high byte, mode 3 (square wave) */
+    Out_Byte(PIT_COMMAND_PORT, 0x36);
+    Out_Byte(PIT_CHANNEL0_PORT, s_pitReload & 0xff);
+    Out_Byte(PIT_CHANNEL0_PORT, (s_pitReload >> 8) & 0xff);
+}
+
+/*
+ * Program PIT channel 0 to interrupt once, after count input clocks.
+ */
+static void Set_PIT_One_Shot(ulong_t count)
+{
+    KASSERT(count > 0 && count <= PIT_MAX_COUNT);
+
+    /* channel 0, low then high byte, mode 0 (interrupt on terminal count) */
+    Out_Byte(PIT_COMMAND_PORT, 0x30);
+    Out_Byte(PIT_CHANNEL0_PORT, count & 0xff);
+    Out_Byte(PIT_CHANNEL0_PORT, (count >> 8) & 0xff);
+}
+
+/*
+ * Read the current value of the PIT channel 0 counter.
+ */
+static ulong_t Read_PIT_Count(void)
+{
+    ulong_t lo, hi;
+
+    /* Latch the count, then read it */
+    Out_Byte(PIT_COMMAND_PORT, 0x00);
+    lo = In_Byte(PIT_CHANNEL0_PORT);
+    hi = In_Byte(PIT_CHANNEL0_PORT);
+    return (hi << 8) | lo;
+}
+
+/*
+ * Find a pending timer event by id.
+ */
+static timerEvent *Find_Timer_Event(int id)
+{
+    timerEvent *event = Get_Front_Of_Timer_Id_List(&s_timerIdHash[id & (TIMER_ID_HASH_SIZE - 1)]);
+
+    while (event != 0 && event->id != id)
+	event = Get_Next_In_Timer_Id_List(event);
+    return event;
+}
+
+/*
+ * Remove a timer event from the wheel (or from the list of
+ * expired events it was moved to) and from the id hash.
+ */
+static void Unlink_Timer_Event(timerEvent *event)
+{
+    Remove_From_Timer_Event_List(event->list, event);
+    Remove_From_Timer_Id_List(&s_timerIdHash[event->id & (TIMER_ID_HASH_SIZE - 1)], event);
+}
+
+/*
+ * Work function which runs the callbacks of expired timer events.
+ * The callbacks run with interrupts disabled, but interrupts
+ * are allowed in between them.
+ */
+static void Run_Expired_Timers(ulong_t arg)
+{
+    Disable_Interrupts();
+    while (!Is_Timer_Event_List_Empty(&s_expiredEvents)) {
+	timerEvent *event = Get_Front_Of_Timer_Event_List(&s_expiredEvents);
+
+	Unlink_Timer_Event(event);
+	if (timerDebug) Print("timer: event %d expired (%d ticks)\n", 
+	    event->id, event->origTicks);
+	if (event->contextCallBack != 0)
+	    event->contextCallBack(event->id, event->context);
+	else
+	    event->callBack(event->id);
+	Free(event);
+
+	Enable_Interrupts();
+	Disable_Interrupts();
+    }
+    Enable_Interrupts();
+}
+
+/*
+ * Expire the timer events due on the current tick, handing
+ * them to the work thread.  They remain cancellable until their
+ * callbacks run.
+ */
+static void Process_Timer_Events(void)
+{
+    struct Timer_Event_List *slot = &s_timerWheel[g_numTicks & (TIMER_WHEEL_SIZE - 1)];
+    timerEvent *event, *next;
+    bool expired = false;
+
+    for (event = Get_Front_Of_Timer_Event_List(slot); event != 0; event = next) {
+	next = Get_Next_In_Timer_Event_List(event);
+	if (event->expires == g_numTicks) {
+	    Remove_From_Timer_Event_List(slot, event);
+	    Add_To_Back_Of_Timer_Event_List(&s_expiredEvents, event);
+	    event->list = &s_expiredEvents;
+	    expired = true;
+	}
+    }
+
+    if (expired)
+	Queue_Work(&s_timerWork, WORK_PRIORITY_HIGH);
+}
+
+/*
+ * Number of ticks until the next timer event fires, looking
+ * no further than maxTicks ahead.  Returns maxTicks if no
+ * event fires within that time.
+ */
+static int Ticks_Until_Next_Event(int maxTicks)
+{
+    int ticks;
+
+    for (ticks = 1; ticks < maxTicks; ++ticks) {
+	ulong_t when = g_numTicks + ticks;
+	timerEvent *event = Get_Front_Of_Timer_Event_List(&s_timerWheel[when & (TIMER_WHEEL_SIZE - 1)]);
+
+	while (event != 0) {
+	    if (event->expires == when)
+		return ticks;
+	    event = Get_Next_In_Timer_Event_List(event);
+	}
+    }
+
+    return maxTicks;
+}
+
+/*
+ * Allocate a timer event due after the given number of ticks
+ * and add it to the wheel.
+ */
+static timerEvent *Add_Timer_Event(int ticks)
+{
+    timerEvent *event;
+
+    KASSERT(!Interrupts_Enabled());
+    KASSERT(ticks >= 0);
+
+    event = (timerEvent*) Malloc(sizeof(*event));
+    if (event == 0)
+	return 0;
+
+    /* Ids are non-negative; skip any still in use after wrapping around */
+    do {
+	event->id = nextEventID;
+	nextEventID = (nextEventID + 1) & INT_MAX;
+    } while (Find_Timer_Event(event->id) != 0);
+
+    event->callBack = 0;
+    event->contextCallBack = 0;
+    event->context = 0;
+    event->origTicks = ticks;
+    /* The event fires on the tick after its count reaches zero */
+    event->expires = g_numTicks + ticks + 1;
+    event->list = &s_timerWheel[event->expires & (TIMER_WHEEL_SIZE - 1)];
+    Add_To_Back_Of_Timer_Event_List(event->list, event);
+    Add_To_Back_Of_Timer_Id_List(&s_timerIdHash[event->id & (TIMER_ID_HASH_SIZE - 1)], event);
+
+    return event;
+}
+
+/*
+ * Go back to periodic ticks after a tickless idle period,
+ * accounting for the ticks that elapsed without interrupts.
+ */
+static void End_Tickless(int elapsedTicks)
+{
+    s_ticklessTicks = 0;
+    Set_PIT_Periodic();
+
+    s_idleStats.ticksSkipped += elapsedTicks;
+    while (elapsedTicks-- > 0) {
+	++g_numTicks;
+	Process_Timer_Events();
+    }
+    g_vdsoTimeData->ticks = g_numTicks;
+}
+
 static void Timer_Interrupt_Handler(struct Interrupt_State* state)
 {
-    int i;
     struct Kernel_Thread* current = g_currentThread;
 
     Begin_IRQ(state);
 
+    /*
+     * If this is the end of a one-shot countdown, catch up on
+     * the ticks we slept through; this interrupt is the last one.
+     */
+    if (s_ticklessTicks > 0)
+	End_Tickless(s_ticklessTicks - 1);
+
     /* Update global and per-thread number of ticks */
     ++g_numTicks;
     ++current->numTicks;
+    g_vdsoTimeData->ticks = g_numTicks;
 
-    /* update timer events */
-    for (i=0; i < timeEventCount; i++) {
-	if (pendingTimerEvents[i].ticks == 0) {
-	    if (timerDebug) Print("timer: event %d expired (%d ticks)\n", 
-	        pendingTimerEvents[i].id, pendingTimerEvents[i].origTicks);
-	    (pendingTimerEvents[i].callBack)(pendingTimerEvents[i].id);
-	} else {
-	    pendingTimerEvents[i].ticks--;
-	}
-    }
+    Process_Timer_Events();
 
     /*
      * If thread has been running for an entire quantum,
@@ -95,10 +357,11 @@ static void Timer_Interrupt_Handler(struct Interrupt_State* state)
     if (current->numTicks >= g_Quantum) {
 	g_needReschedule = true;
 	/*
-	 * The current process is moved to a lower priority queue,
-	 * since it consumed a full quantum.
+	 * Under MLF, the current process is moved to a lower priority
+	 * queue, since it consumed a full quantum.
 	 */
-        if (current->currentReadyQueue < (MAX_QUEUE_LEVEL - 1)) {
+        if (g_schedulingPolicy == SCHED_MLF &&
+	    current->currentReadyQueue < (MAX_QUEUE_LEVEL - 1)) {
             /*Print("process %d moved to ready queue %d\n", current->pid, current->currentReadyQueue); */
             current->currentReadyQueue++;
         }
@@ -116,6 +379,15 @@ static void Timer_Interrupt_Handler(struct Interrupt_State* state)
 static void Timer_Calibrate(struct Interrupt_State* state)
 {
     Begin_IRQ(state);
+
+    /* Count TSC cycles from the first tick to the last */
+    if (s_haveTSC) {
+	if (g_numTicks == 0)
+	    s_tscBoot = Read_TSC();
+	else if (g_numTicks == CALIBRATE_NUM_TICKS && s_tscCalibrateEnd == 0)
+	    s_tscCalibrateEnd = Read_TSC();
+    }
+
     if (g_numTicks < CALIBRATE_NUM_TICKS)
 	++g_numTicks;
     else {
@@ -196,97 +468,322 @@ static void Calibrate_Delay(void)
 
 void Init_Timer(void)
 {
-    /*
-     * TODO: reprogram the timer to set the frequency.
-     * In bochs, it defaults to 18Hz, which is actually pretty
-     * reasonable.
-     */
-
     Print("Initializing timer...\n");
 
-    /* configure for default clock */
-    Out_Byte(0x43, 0x36);
-    Out_Byte(0x40, 0x00);
-    Out_Byte(0x40, 0x00);
+    /* Tick at TIMER_HZ */
+    Set_PIT_Periodic();
 
-    /* Calibrate for delay loop */
+    /* Calibrate the delay loop, and the TSC if there is one */
+    s_haveTSC = Has_TSC();
     Calibrate_Delay();
     Print("Delay loop: %d iterations per tick\n", s_spinCountPerTick);
+    if (s_haveTSC) {
+	Calibrate_TSC();
+	Print("Timer: %d Hz, TSC %lu kHz\n", TIMER_HZ, s_tscKHz);
+    } else
+	Print("Timer: %d Hz, no TSC\n", TIMER_HZ);
+
+    /* Let user processes read the clock without a system call */
+    g_vdsoTimeData->ticks = g_numTicks;
+    g_vdsoTimeData->nsPerTick = NS_PER_TICK;
+    g_vdsoTimeData->haveTSC = s_haveTSC;
+    g_vdsoTimeData->tscMult = s_tscMult;
+    g_vdsoTimeData->tscShift = s_tscShift;
+    g_vdsoTimeData->tscBoot = s_tscBoot;
+
+    Init_Work_Item(&s_timerWork, &Run_Expired_Timers, 0);
 
     /* Install an interrupt handler for the timer IRQ */
     Install_IRQ(TIMER_IRQ, &Timer_Interrupt_Handler);
     Enable_IRQ(TIMER_IRQ);
 }
 
-int Start_Timer(int ticks, timerCallback cb)
+/*
+ * Called by the idle thread, with interrupts disabled, just before
+ * it halts the processor.  If no timer event is due for a while,
+ * stop the periodic tick and let the PIT interrupt only when the
+ * next event is due.
+ */
+void Timer_Enter_Idle(void)
 {
-    int ret;
+    int ticks;
+    int maxTicks = PIT_MAX_COUNT / s_pitReload;
 
     KASSERT(!Interrupts_Enabled());
+    KASSERT(s_ticklessTicks == 0);
+
+    s_idleStats.idleHalts++;
+
+    ticks = Ticks_Until_Next_Event(maxTicks);
+
+    /* Skipping a single tick is not worth reprogramming the PIT */
+    if (ticks < 2)
+	return;
+
+    s_ticklessTicks = ticks;
+    Set_PIT_One_Shot(ticks * s_pitReload);
+    s_idleStats.ticklessSleeps++;
+}
+
+/*
+ * Called by the idle thread, with interrupts disabled, once
+ * the processor wakes up from a halt.  If something other than
+ * the one-shot timer woke us, resume periodic ticks now.
+ */
+void Timer_Exit_Idle(void)
+{
+    ulong_t programmed, remaining;
+
+    KASSERT(!Interrupts_Enabled());
+
+    if (s_ticklessTicks == 0)
+	return;
+
+    programmed = s_ticklessTicks * s_pitReload;
+    remaining = Read_PIT_Count();
+    if (remaining > programmed)
+	/*
+	 * The count already ran out and wrapped; the timer interrupt
+	 * is pending and will account for the final tick.
+	 */
+	End_Tickless(s_ticklessTicks - 1);
+    else
+	End_Tickless((programmed - remaining) / s_pitReload);
+}
+
+/*
+ * Get a snapshot of the idle and tickless counters.
+ */
+void Get_Timer_Idle_Stats(struct Timer_Idle_Stats *stats)
+{
+    bool iflag = Begin_Int_Atomic();
+    *stats = s_idleStats;
+    End_Int_Atomic(iflag);
+}
 
-    if (timeEventCount == MAX_TIMER_EVENTS) {
+/*
+ * Arrange for given callback to be called, with the timer's id,
+ * after the given number of ticks have elapsed.  The callback is
+ * called once, by the work thread, with interrupts disabled; the
+ * timer is gone once it has fired.
+ * Interrupts must be disabled.
+ * Returns the timer id, or -1 if memory could not be allocated.
+ */
+int Start_Timer(int ticks, timerCallback cb)
+{
+    timerEvent *event = Add_Timer_Event(ticks);
+
+    if (event == 0)
 	return -1;
-    } else {
-	ret = nextEventID++;
-	pendingTimerEvents[timeEventCount].id = ret;
-	pendingTimerEvents[timeEventCount].callBack = cb;
-	pendingTimerEvents[timeEventCount].ticks = ticks;
-	pendingTimerEvents[timeEventCount].origTicks = ticks;
-	timeEventCount++;
-
-	return ret;
-    }
+    event->callBack = cb;
+    return event->id;
 }
 
+/*
+ * Like Start_Timer(), but the callback is also passed the
+ * given context pointer.
+ */
+int Start_Timer_With_Context(int ticks, timerContextCallback cb, void *context)
+{
+    timerEvent *event = Add_Timer_Event(ticks);
+
+    if (event == 0)
+	return -1;
+    event->contextCallBack = cb;
+    event->context = context;
+    return event->id;
+}
+
+/*
+ * Return the number of ticks remaining before the timer with
+ * given id fires, or -1 if there is no such timer.
+ * Interrupts must be disabled.
+ */
 int Get_Remaing_Timer_Ticks(int id)
 {
-    int i;
+    timerEvent *event;
 
     KASSERT(!Interrupts_Enabled());
-    for (i=0; i < timeEventCount; i++) {
-	if (pendingTimerEvents[i].id == id) {
-	    return pendingTimerEvents[i].ticks;
-	}
-    }
 
-    return -1;
+    event = Find_Timer_Event(id);
+    if (event == 0)
+	return -1;
+    if (event->list == &s_expiredEvents)
+	return 0;  /* expired, callback not run yet */
+    return event->expires - g_numTicks - 1;
 }
 
+/*
+ * Cancel the timer with given id.
+ * Interrupts must be disabled.
+ * Returns 0 if successful, -1 if there is no such timer
+ * (for example, because it has already fired).
+ */
 int Cancel_Timer(int id)
 {
-    int i;
+    timerEvent *event;
+
     KASSERT(!Interrupts_Enabled());
-    for (i=0; i < timeEventCount; i++) {
-	if (pendingTimerEvents[i].id == id) {
-	    pendingTimerEvents[i] = pendingTimerEvents[timeEventCount-1];
-	    timeEventCount--;
-	    return 0;
+
+    event = Find_Timer_Event(id);
+    if (event == 0) {
+	if (timerDebug) Print("timer: unable to find timer id %d to cancel it\n", id);
+	return -1;
+    }
+
+    Unlink_Timer_Event(event);
+    Free(event);
+    return 0;
+}
+
+#ifdef TIMER_STRESS_TEST
+
+/*
+ * Stress test for the timer wheel: arm thousands of timers with
+ * scattered expiry times (several laps of the wheel), cancel a
+ * third of them, and check that each of the rest fires exactly
+ * once, no earlier than the tick it was due.  Callbacks run in
+ * the work thread, so they may run a little late; the worst
+ * case is reported.
+ */
+#define STRESS_NUM_TIMERS	4000
+#define STRESS_MAX_TICKS	(2 * TIMER_WHEEL_SIZE)
+
+enum { STRESS_ARMED, STRESS_CANCELLED, STRESS_FIRED };
+
+static int s_stressFirstId;
+static ulong_t s_stressDue[STRESS_NUM_TIMERS];
+static uchar_t s_stressState[STRESS_NUM_TIMERS];
+static int s_stressPending, s_stressErrors;
+static ulong_t s_stressMaxLate;
+static struct Thread_Queue s_stressWaitQueue;
+
+static void Stress_Timer_Callback(int id)
+{
+    int i = id - s_stressFirstId;
+
+    if (i < 0 || i >= STRESS_NUM_TIMERS || s_stressState[i] != STRESS_ARMED ||
+	g_numTicks < s_stressDue[i]) {
+	++s_stressErrors;
+	return;
+    }
+    if (g_numTicks - s_stressDue[i] > s_stressMaxLate)
+	s_stressMaxLate = g_numTicks - s_stressDue[i];
+    s_stressState[i] = STRESS_FIRED;
+    if (--s_stressPending == 0)
+	Wake_Up(&s_stressWaitQueue);
+}
+
+void Timer_Stress_Test(void)
+{
+    ulong_t seed = 12345, start;
+    int i, id, numCancelled = 0;
+
+    Print("timer: stress test, %d timers...\n", STRESS_NUM_TIMERS);
+
+    Disable_Interrupts();
+    s_stressPending = s_stressErrors = 0;
+    s_stressMaxLate = 0;
+
+    for (i = 0; i < STRESS_NUM_TIMERS; ++i) {
+	int ticks;
+
+	seed = seed * 1103515245 + 12345;
+	ticks = (seed >> 16) % STRESS_MAX_TICKS;
+
+	id = Start_Timer(ticks, &Stress_Timer_Callback);
+	if (i == 0)
+	    s_stressFirstId = id;
+	if (id < 0 || id != s_stressFirstId + i) {
+	    Print("timer: stress test could not arm timer %d (id %d)\n", i, id);
+	    ++s_stressErrors;
+	    break;
+	}
+	s_stressDue[i] = g_numTicks + ticks + 1;
+	s_stressState[i] = STRESS_ARMED;
+	++s_stressPending;
+    }
+
+    for (i = 0; i < s_stressPending; i += 3) {
+	if (Cancel_Timer(s_stressFirstId + i) != 0 ||
+	    Get_Remaing_Timer_Ticks(s_stressFirstId + i) != -1) {
+	    ++s_stressErrors;
+	    continue;
 	}
+	s_stressState[i] = STRESS_CANCELLED;
+	++numCancelled;
     }
+    s_stressPending -= numCancelled;
+
+    start = g_numTicks;
+    while (s_stressPending > 0)
+	Wait(&s_stressWaitQueue);
+    Enable_Interrupts();
 
-    Print("timer: unable to find timer id %d to cancel it\n", id);
-    return -1;
+    Print("timer: stress test %s: %d fired, %d cancelled, %d errors in %lu ticks\n",
+	s_stressErrors == 0 ? "passed" : "FAILED",
+	STRESS_NUM_TIMERS - numCancelled, numCancelled, s_stressErrors, g_numTicks - start);
+    Print("timer: callbacks ran at most %lu ticks late\n", s_stressMaxLate);
 }
 
-#define US_PER_TICK (TICKS_PER_SEC * 1000000)
+#endif /* TIMER_STRESS_TEST */
+
+/*
+ * Get the time since boot, in nanoseconds.  This is read from
+ * the TSC, or counted in whole ticks if there isn't one.
+ */
+unsigned long long Get_Monotonic_Time_NS(void)
+{
+    if (!s_haveTSC)
+	return (unsigned long long) g_numTicks * NS_PER_TICK;
+    return Cycles_To_NS(Read_TSC() - s_tscBoot);
+}
+
+/*
+ * Convert a count of TSC cycles to nanoseconds.
+ */
+unsigned long long Cycles_To_NS(unsigned long long cycles)
+{
+    /*
+     * The product cycles * s_tscMult needs up to 96 bits;
+     * multiply the two halves of cycles separately.
+     */
+    unsigned long long lo = (unsigned long long) (ulong_t) cycles * s_tscMult;
+    unsigned long long hi = (unsigned long long) (ulong_t) (cycles >> 32) * s_tscMult;
+
+    return (lo >> s_tscShift) + (hi << (32 - s_tscShift));
+}
+
+/*
+ * Get the TSC frequency in kHz, or 0 if there is no TSC.
+ */
+ulong_t Get_TSC_KHz(void)
+{
+    return s_tscKHz;
+}
 
 /*
  * Spin for at least given number of microseconds.
- * FIXME: I'm sure this implementation leaves a lot to
- * be desired.
+ * Uses the TSC if there is one, otherwise the calibrated delay loop.
  */
 void Micro_Delay(int us)
 {
-    int num = us * s_spinCountPerTick;
-    int denom = US_PER_TICK;
+    int numSpins;
 
-    int numSpins = num / denom;
-    int rem = num % denom;
+    KASSERT(us >= 0);
+
+    if (s_haveTSC) {
+	unsigned long long end = Read_TSC() +
+	    Div_64_32((unsigned long long) us * s_tscKHz + 999, 1000);
+
+	while (Read_TSC() < end)
+	    ;
+	return;
+    }
 
-    if (rem > 0)
-	++numSpins;
+    numSpins = (int) Div_64_32((unsigned long long) us * s_spinCountPerTick + US_PER_TICK - 1, US_PER_TICK);
 
-    Debug("Micro_Delay(): num=%d, denom=%d, spin count = %d\n", num, denom, numSpins);
+    Debug("Micro_Delay(): us=%d, spin count = %d\n", us, numSpins);
 
     Spin(numSpins);
 }
@@ -11,8 +11,15 @@
 #include <geekos/kthread.h>
 #include <geekos/defs.h>
 #include <geekos/syscall.h>
+#include <geekos/cpu.h>
+#include <geekos/user.h>
 #include <geekos/trap.h>
 
+/*
+ * Entry point for the sysenter instruction, in lowlevel.asm.
+ */
+extern void Sysenter_Entry(void);
+
 /*
  * TODO: need to add handlers for other exceptions (such as bounds
  * check, debug, etc.)
@@ -60,6 +67,58 @@ static void Syscall_Handler(struct Interrupt_State* state)
     state->eax = g_syscallTable[syscallNum](state);
 }
 
+/*
+ * Set up the sysenter instruction, if the processor has it.
+ * Sysenter loads ss from the GDT entry after the code segment,
+ * which is where KERNEL_DS is.  The stack pointer MSR is unused:
+ * Sysenter_Entry loads esp from g_kernelStackTop before touching
+ * the stack.
+ */
+static void Init_Sysenter(void)
+{
+    if (!Has_Sysenter())
+	return;
+
+    Write_MSR(MSR_SYSENTER_CS, KERNEL_CS);
+    Write_MSR(MSR_SYSENTER_ESP, 0);
+    Write_MSR(MSR_SYSENTER_EIP, (ulong_t) &Sysenter_Entry);
+
+    Print("Fast system calls (sysenter) enabled\n");
+}
+
+/*
+ * System call made with the sysenter instruction.
+ * The low level code has built the same frame an int 0x90 from
+ * user mode would, except for the user code and stack locations.
+ * The return address is on the user stack at ebp.
+ * Called with interrupts disabled.
+ */
+void Sysenter_Handler(struct Interrupt_State* state)
+{
+    struct User_Interrupt_State* userState = (struct User_Interrupt_State*) state;
+    struct User_Context* userContext = g_currentThread->userContext;
+    ulong_t returnAddr;
+
+    KASSERT(userContext != 0);
+
+    /* The processor cleared IF on entry; user mode always has it set */
+    state->eflags |= EFLAGS_IF;
+    state->cs = userContext->csSelector;
+    userState->ssUser = userContext->dsSelector;
+    userState->espUser = state->ebp + sizeof(ulong_t);
+
+    if (!Copy_From_User(&returnAddr, state->ebp, sizeof(returnAddr))) {
+	Print("Bad sysenter stack in process %d\n", g_currentThread->pid);
+	Exit(-1);
+
+	/* We will never get here */
+	KASSERT(false);
+    }
+    state->eip = returnAddr;
+
+    Syscall_Handler(state);
+}
+
 /*
  * Initialize handlers for processor traps.
  */
@@ -68,4 +127,5 @@ void Init_Traps(void)
     Install_Interrupt_Handler(12, &GPF_Handler);  /* stack exception */
     Install_Interrupt_Handler(13, &GPF_Handler);  /* general protection fault */
     Install_Interrupt_Handler(SYSCALL_INT, &Syscall_Handler);
+    Init_Sysenter();
 }
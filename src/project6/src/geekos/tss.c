@@ -26,6 +26,13 @@ static struct TSS s_theTSS;
 static struct Segment_Descriptor *s_tssDesc;
 static ushort_t s_tssSelector;
 
+/*
+ * The same kernel stack pointer as esp0 in the TSS.  Sysenter_Entry
+ * loads esp from here, so the SYSENTER_ESP MSR is written only once
+ * rather than on every switch to another process.
+ */
+ulong_t g_kernelStackTop;
+
 static void __inline__ Load_Task_Register(void)
 {
     /* Critical: TSS must be marked as not busy */
@@ -52,6 +59,7 @@ void Init_TSS(void)
     Init_TSS_Descriptor(s_tssDesc, &s_theTSS);
 
     s_tssSelector = Selector(0, true, Get_Descriptor_Index(s_tssDesc));
+    s_theTSS.ss0 = KERNEL_DS;
 
     Load_Task_Register();
 }
@@ -64,14 +72,10 @@ void Init_TSS(void)
  */
 void Set_Kernel_Stack_Pointer(ulong_t esp0)
 {
-    s_theTSS.ss0 = KERNEL_DS;
-    s_theTSS.esp0 = esp0;
-
     /*
-     * NOTE: I read on alt.os.development that it is necessary to
-     * reload the task register after modifying a TSS.
-     * I haven't verified this in the IA32 documentation,
-     * but there is certainly no harm in being paranoid.
+     * The processor reads esp0 from the TSS in memory on each
+     * switch to ring 0, so the task register need not be reloaded.
      */
-    Load_Task_Register();
+    s_theTSS.esp0 = esp0;
+    g_kernelStackTop = esp0;
 }
@@ -17,12 +17,23 @@
 #include <geekos/vfs.h>
 #include <geekos/tss.h>
 #include <geekos/user.h>
+#include <geekos/vdso.h>
 
 /*
  * This module contains common functions for implementation of user
  * mode processes.
  */
 
+/*
+ * The user context whose address space (LDT and page directory)
+ * is loaded, and the kernel stack pointer in the TSS.  Both are
+ * only changed when a different user thread is about to run.
+ * Kernel threads borrow whatever address space is loaded, since
+ * the kernel is mapped in all of them, and never need esp0.
+ */
+static struct User_Context* s_activeUserContext;
+static ulong_t s_activeKernelStack;
+
 /*
  * Associate the given user context with a kernel thread.
  * This makes the thread a user process.
@@ -32,6 +43,13 @@ void Attach_User_Context(struct Kernel_Thread* kthread, struct User_Context* con
     KASSERT(context != 0);
     kthread->userContext = context;
 
+    /*
+     * Map the kernel data pages.  If there is no memory for them,
+     * libc makes system calls instead (see Sys_HasVDSO()).
+     */
+    if (context->vdsoData == 0 && context->pageDir != 0)
+	Map_VDSO(context);
+
     Disable_Interrupts();
 
     /*
@@ -41,6 +59,8 @@ void Attach_User_Context(struct Kernel_Thread* kthread, struct User_Context* con
     KASSERT(context->refCount == 0);
 
     ++context->refCount;
+    if (context->vdsoData != 0)
+	context->vdsoData->pid = kthread->pid;
     Enable_Interrupts();
 }
 
@@ -61,6 +81,16 @@ void Detach_User_Context(struct Kernel_Thread* kthread)
 	Disable_Interrupts();
         --old->refCount;
 	refCount = old->refCount;
+
+	/*
+	 * The calling thread may be borrowing the address space:
+	 * don't keep it loaded after it is destroyed.
+	 */
+	if (refCount == 0 && old == s_activeUserContext) {
+	    if (g_kernelPageDir != 0)
+		Set_PDBR(g_kernelPageDir);
+	    s_activeUserContext = 0;
+	}
 	Enable_Interrupts();
 
 	/*Print("User context refcount == %d\n", refCount);*/
@@ -107,7 +137,10 @@ int Spawn(const char *program, const char *command,
 
 /*
  * If the given thread has a User_Context,
- * switch to its memory space.
+ * switch to its memory space, unless it is already active.
+ * Called with interrupts disabled on every return from an
+ * interrupt and every thread switch, so it must be cheap when
+ * there is nothing to do.
  *
  * Params:
  *   kthread - the thread that is about to execute
@@ -116,11 +149,25 @@ int Spawn(const char *program, const char *command,
  */
 void Switch_To_User_Context(struct Kernel_Thread* kthread, struct Interrupt_State* state)
 {
+    struct User_Context* userContext = kthread->userContext;
+    ulong_t kernelStack;
+
+    if (userContext == 0)
+	return;  /* kernel thread: borrow the active address space */
+
+    if (userContext != s_activeUserContext) {
+	Switch_To_Address_Space(userContext);
+	s_activeUserContext = userContext;
+    }
+
     /*
-     * Hint: Before executing in user mode, you will need to call
-     * the Set_Kernel_Stack_Pointer() and Switch_To_Address_Space()
-     * functions.
+     * Compare stack addresses rather than threads: a new thread may
+     * reuse a dead thread's Kernel_Thread object with another stack.
      */
-    TODO("Switch to a new user address space, if necessary");
+    kernelStack = ((ulong_t) kthread->stackPage) + PAGE_SIZE;
+    if (kernelStack != s_activeKernelStack) {
+	Set_Kernel_Stack_Pointer(kernelStack);
+	s_activeKernelStack = kernelStack;
+    }
 }
 
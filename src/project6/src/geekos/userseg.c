@@ -167,10 +167,6 @@ bool Copy_To_User(ulong_t destInUser, void* srcInKernel, ulong_t bufSize)
  */
 void Switch_To_Address_Space(struct User_Context *userContext)
 {
-    /*
-     * Hint: you will need to use the lldt assembly language instruction
-     * to load the process's LDT by specifying its LDT selector.
-     */
-    TODO("Switch to user address space using segmentation/LDT");
+    Load_LDTR(userContext->ldtSelector);
 }
 
@@ -7,6 +7,7 @@
  * redistribute, and modify it as specified in the file "COPYING".
  */
 
+#include <geekos/errno.h>
 #include <geekos/int.h>
 #include <geekos/mem.h>
 #include <geekos/paging.h>
@@ -17,12 +18,75 @@
 #include <geekos/range.h>
 #include <geekos/vfs.h>
 #include <geekos/user.h>
+#include <geekos/vdso.h>
+#include <geekos/zswap.h>
+
+/* The heap may not extend past this user address. */
+#define USER_HEAP_LIMIT		(VDSO_USER_ADDR - USER_STACK_RESERVE)
 
 /* ----------------------------------------------------------------------
  * Private functions
  * ---------------------------------------------------------------------- */
 
 // TODO: Add private functions
+
+/*
+ * Find the page table entry for given linear address in a user
+ * address space, optionally creating the page table.
+ * Returns null if there is no page table (or none could be
+ * allocated).
+ */
+static pte_t *Get_User_Page_Table_Entry(pde_t *pageDir, ulong_t vaddr, bool create)
+{
+    pde_t *pde = &pageDir[PAGE_DIRECTORY_INDEX(vaddr)];
+    pte_t *pageTable;
+
+    if (!pde->present) {
+	if (!create)
+	    return 0;
+	pageTable = (pte_t*) Alloc_Zeroed_Page();
+	if (pageTable == 0)
+	    return 0;
+
+	/* Access is restricted by the page table entries */
+	pde->present = 1;
+	pde->flags = VM_WRITE | VM_USER;
+	pde->pageTableBaseAddr = PAGE_ALLIGNED_ADDR(pageTable);
+    }
+
+    pageTable = (pte_t*) (pde->pageTableBaseAddr << PAGE_POWER);
+    return &pageTable[PAGE_TABLE_INDEX(vaddr)];
+}
+
+/*
+ * Release the page mapped at given linear address, wherever
+ * its contents are: in memory, in the compressed pool, or in
+ * the paging file.
+ * Interrupts must be disabled.
+ */
+static void Release_User_Page(pde_t *pageDir, ulong_t vaddr)
+{
+    pte_t *entry = Get_User_Page_Table_Entry(pageDir, vaddr, false);
+
+    KASSERT(!Interrupts_Enabled());
+
+    if (entry == 0)
+	return;
+    if (entry->present) {
+	Free_Page((void*) (entry->pageBaseAddr << PAGE_POWER));
+	Flush_TLB_Page(vaddr);
+    } else if (entry->kernelInfo == KINFO_PAGE_PAGING_OUT) {
+	/* A page being written out is freed when the write completes */
+	Free_Page((void*) (entry->pageBaseAddr << PAGE_POWER));
+    } else if (entry->kernelInfo == KINFO_PAGE_ON_DISK) {
+	Free_Space_On_Paging_File(entry->pageBaseAddr);
+    } else if (entry->kernelInfo == KINFO_PAGE_COMPRESSED) {
+	if (Zswap_Holds(entry->pageBaseAddr, entry))
+	    Zswap_Invalidate(entry->pageBaseAddr);
+    }
+    memset(entry, '\0', sizeof(*entry));
+}
+
 /* ----------------------------------------------------------------------
  * Public functions
  * ---------------------------------------------------------------------- */
@@ -37,7 +101,8 @@ void Destroy_User_Context(struct User_Context* context)
      * Hints:
      * - Free all pages, page tables, and page directory for
      *   the process (interrupts must be disabled while you do this,
-     *   otherwise those pages could be stolen by other processes)
+     *   otherwise those pages could be stolen by other processes),
+     *   except pages marked KINFO_PAGE_SHARED
      * - Free semaphores, files, and other resources used
      *   by the process
      */
@@ -73,8 +138,13 @@ int Load_User_Program(char *exeFileData, ulong_t exeFileLength,
      *   and stack
      * - Allocate pages for above, map them into user address
      *   space (allocating page directory and page tables as needed)
+     * - Keep the stack below VDSO_USER_ADDR, where
+     *   Attach_User_Context() maps the kernel data pages
      * - Fill in initial stack pointer, argument block address,
      *   and code entry point fields in User_Context
+     * - Set heapStart and heapEnd to the page boundary following
+     *   the data segment, so the process can grow its heap
+     *   (see Set_User_Heap_End())
      */
     TODO("Load user program into address space");
 }
@@ -121,17 +191,78 @@ bool Copy_To_User(ulong_t destInUser, void* srcInKernel, ulong_t numBytes)
     TODO("Copy kernel data to user buffer");
 }
 
+/*
+ * Move the end of the heap of given user context.
+ * Growing the heap only records the new end: pages are allocated
+ * and zeroed as they are first touched.  Shrinking it releases the
+ * pages wholly above the new end.
+ * Params:
+ * userContext - the user context
+ * newEnd - user address of the new end of the heap
+ *
+ * Returns:
+ *   0 if successful, or an error code (< 0) if unsuccessful
+ */
+int Set_User_Heap_End(struct User_Context *userContext, ulong_t newEnd)
+{
+    ulong_t addr, oldEnd;
+    bool iflag;
+
+    if (userContext->heapStart == 0 || newEnd < userContext->heapStart)
+	return EINVALID;
+    if (newEnd > USER_HEAP_LIMIT)
+	return ENOMEM;
+
+    iflag = Begin_Int_Atomic();
+    oldEnd = userContext->heapEnd;
+    for (addr = Round_Up_To_Page(newEnd); addr < Round_Up_To_Page(oldEnd); addr += PAGE_SIZE)
+	Release_User_Page(userContext->pageDir, USER_SEGMENT_BASE + addr);
+    userContext->heapEnd = newEnd;
+    End_Int_Atomic(iflag);
+
+    return 0;
+}
+
+/*
+ * Map a zeroed page at given linear address in the heap of given
+ * user context, on the first touch of that page.
+ * Interrupts must be disabled.
+ * Returns 0 if successful, error code (< 0) otherwise.
+ */
+int Map_User_Heap_Page(struct User_Context *userContext, ulong_t vaddr)
+{
+    pte_t *entry;
+    void *paddr;
+
+    KASSERT(!Interrupts_Enabled());
+    KASSERT(vaddr >= USER_SEGMENT_BASE + userContext->heapStart &&
+	vaddr < USER_SEGMENT_BASE + userContext->heapEnd);
+
+    vaddr = Round_Down_To_Page(vaddr);
+    entry = Get_User_Page_Table_Entry(userContext->pageDir, vaddr, true);
+    if (entry == 0)
+	return ENOMEM;
+    KASSERT(!entry->present && entry->kernelInfo == 0);
+
+    paddr = Alloc_Pageable_Zeroed_Page(entry, vaddr);
+    if (paddr == 0)
+	return ENOMEM;
+
+    entry->flags = VM_WRITE | VM_USER;
+    entry->pageBaseAddr = PAGE_ALLIGNED_ADDR(paddr);
+    entry->present = 1;
+
+    return 0;
+}
+
 /*
  * Switch to user address space.
  */
 void Switch_To_Address_Space(struct User_Context *userContext)
 {
-    /*
-     * - If you are still using an LDT to define your user code and data
-     *   segments, switch to the process's LDT
-     * - 
-     */
-    TODO("Switch_To_Address_Space() using paging");
+    /* User code and data segments are still defined by the LDT */
+    Load_LDTR(userContext->ldtSelector);
+    Set_PDBR(userContext->pageDir);
 }
 
 
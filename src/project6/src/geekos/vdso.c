@@ -0,0 +1,101 @@
+/*
+ * Kernel data pages mapped read-only into user processes
+ * $Revision: 1.1 $
+ * 
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <geekos/errno.h>
+#include <geekos/kassert.h>
+#include <geekos/string.h>
+#include <geekos/mem.h>
+#include <geekos/paging.h>
+#include <geekos/user.h>
+#include <geekos/vdso.h>
+
+/*
+ * The time data page, shared by all processes.
+ * The timer code keeps it up to date.
+ */
+struct VDSO_Time_Data *g_vdsoTimeData;
+
+/* ----------------------------------------------------------------------
+ * Private functions
+ * ---------------------------------------------------------------------- */
+
+/*
+ * Map given page read-only at given linear address in a user
+ * address space, creating the page table if there isn't one.
+ * Returns 0 if successful, ENOMEM if no page table could be allocated.
+ */
+static int Map_Read_Only_Page(pde_t *pageDir, ulong_t vaddr, void *page, int kernelInfo)
+{
+    pde_t *pde = &pageDir[PAGE_DIRECTORY_INDEX(vaddr)];
+    pte_t *pageTable, *pte;
+
+    if (!pde->present) {
+	pageTable = (pte_t*) Alloc_Zeroed_Page();
+	if (pageTable == 0)
+	    return ENOMEM;
+
+	/* Access is restricted by the page table entries */
+	pde->present = 1;
+	pde->flags = VM_WRITE | VM_USER;
+	pde->pageTableBaseAddr = PAGE_ALLIGNED_ADDR(pageTable);
+    }
+
+    pageTable = (pte_t*) (pde->pageTableBaseAddr << PAGE_POWER);
+    pte = &pageTable[PAGE_TABLE_INDEX(vaddr)];
+    KASSERT(!pte->present);
+    pte->present = 1;
+    pte->flags = VM_USER;
+    pte->kernelInfo = kernelInfo;
+    pte->pageBaseAddr = PAGE_ALLIGNED_ADDR(page);
+
+    return 0;
+}
+
+/* ----------------------------------------------------------------------
+ * Public functions
+ * ---------------------------------------------------------------------- */
+
+/*
+ * Allocate the shared time data page.
+ * Must be called before the timer is initialized.
+ */
+void Init_VDSO(void)
+{
+    g_vdsoTimeData = (struct VDSO_Time_Data*) Alloc_Zeroed_Page();
+    KASSERT(g_vdsoTimeData != 0);
+}
+
+/*
+ * Map the kernel data pages into given user address space,
+ * allocating the process data page.  The pid is filled in
+ * when the context is attached to a thread.
+ * Returns 0 if successful, ENOMEM if out of memory, in which
+ * case the context has no process data page.
+ */
+int Map_VDSO(struct User_Context *userContext)
+{
+    ulong_t vaddr = USER_SEGMENT_BASE + VDSO_USER_ADDR;
+    int rc;
+
+    KASSERT(userContext->pageDir != 0);
+    KASSERT(userContext->vdsoData == 0);
+
+    userContext->vdsoData = (struct VDSO_Process_Data*) Alloc_Zeroed_Page();
+    if (userContext->vdsoData == 0)
+	return ENOMEM;
+
+    /* The time data page is never freed with the process */
+    rc = Map_Read_Only_Page(userContext->pageDir, vaddr, g_vdsoTimeData, KINFO_PAGE_SHARED);
+    if (rc == 0)
+	rc = Map_Read_Only_Page(userContext->pageDir, vaddr + PAGE_SIZE, userContext->vdsoData, 0);
+    if (rc != 0) {
+	Free_Page(userContext->vdsoData);
+	userContext->vdsoData = 0;
+    }
+    return rc;
+}
@@ -8,11 +8,13 @@
  * redistribute, and modify it as specified in the file "COPYING".
  */
 
+#include <limits.h>
 #include <geekos/errno.h>
 #include <geekos/list.h>
 #include <geekos/string.h>
 #include <geekos/screen.h>
 #include <geekos/malloc.h>
+#include <geekos/mem.h>
 #include <geekos/synch.h>
 #include <geekos/vfs.h>
 
@@ -553,6 +555,205 @@ int Seek(struct File *file, ulong_t len)
 	return file->ops->Seek(file, len);
 }
 
+/*
+ * Read bytes from given position in a file, leaving the
+ * current position where it is.
+ * Params:
+ *   file - the File object
+ *   pos - position in the file to read from
+ *   buf - kernel buffer where data read from file should be stored
+ *   len - number of bytes to read
+ * Returns: number of bytes read, 0 if pos is at or past end-of-file,
+ *   or error code (< 0) if read fails
+ */
+int Read_At(struct File *file, ulong_t pos, void *buf, ulong_t len)
+{
+    ulong_t oldPos;
+    int rc;
+
+    if (file->ops->Read_At != 0)
+	return file->ops->Read_At(file, pos, buf, len);
+
+    /* Fall back on moving the position there and back */
+    if (file->ops->Seek == 0 || file->ops->Read == 0)
+	return EUNSUPPORTED;
+    oldPos = file->filePos;
+    if ((rc = Seek(file, pos)) < 0)
+	return rc;
+    rc = Read(file, buf, len);
+    file->filePos = oldPos;
+    return rc;
+}
+
+/*
+ * Write bytes at given position in a file, leaving the
+ * current position where it is.
+ * Params:
+ *   file - the File object
+ *   pos - position in the file to write at
+ *   buf - kernel buffer containing data to be written
+ *   len - number of bytes to write
+ * Returns: number of bytes written, or error code (< 0) if write fails
+ */
+int Write_At(struct File *file, ulong_t pos, void *buf, ulong_t len)
+{
+    ulong_t oldPos;
+    int rc;
+
+    if (file->ops->Write_At != 0)
+	return file->ops->Write_At(file, pos, buf, len);
+
+    if (file->ops->Seek == 0 || file->ops->Write == 0)
+	return EUNSUPPORTED;
+    oldPos = file->filePos;
+    if ((rc = Seek(file, pos)) < 0)
+	return rc;
+    rc = Write(file, buf, len);
+    file->filePos = oldPos;
+    return rc;
+}
+
+/*
+ * Read from the current position of a file into several buffers,
+ * filling each in turn.
+ * Params:
+ *   file - the File object
+ *   vec - kernel buffers to read into
+ *   count - number of buffers
+ * Returns: total number of bytes read, 0 if end-of-file is reached,
+ *   or error code (< 0) if nothing could be read
+ */
+int Read_Vector(struct File *file, const struct IO_Vector *vec, int count)
+{
+    int total = 0, rc = 0, i;
+
+    for (i = 0; i < count; ++i) {
+	if (vec[i].len > (ulong_t) (INT_MAX - total))
+	    return EINVALID;
+	rc = Read(file, vec[i].buf, vec[i].len);
+	if (rc < 0)
+	    break;
+	total += rc;
+	/* A short read means there is no more for now */
+	if ((ulong_t) rc < vec[i].len)
+	    break;
+    }
+    return total > 0 ? total : rc;
+}
+
+/*
+ * Write several buffers in turn to the current position of a file.
+ * Params:
+ *   file - the File object
+ *   vec - kernel buffers to write
+ *   count - number of buffers
+ * Returns: total number of bytes written,
+ *   or error code (< 0) if nothing could be written
+ */
+int Write_Vector(struct File *file, const struct IO_Vector *vec, int count)
+{
+    int total = 0, rc = 0, i;
+
+    for (i = 0; i < count; ++i) {
+	if (vec[i].len > (ulong_t) (INT_MAX - total))
+	    return EINVALID;
+	rc = Write(file, vec[i].buf, vec[i].len);
+	if (rc < 0)
+	    break;
+	total += rc;
+	if ((ulong_t) rc < vec[i].len)
+	    break;
+    }
+    return total > 0 ? total : rc;
+}
+
+/*
+ * Write all of a kernel buffer to a file.
+ * Returns number of bytes written, which is less than len
+ * only if the file stopped taking them, or error code (< 0)
+ * if nothing could be written.
+ */
+static int Write_All(struct File *file, char *buf, ulong_t len)
+{
+    ulong_t done = 0;
+
+    while (done < len) {
+	int rc = Write(file, buf + done, len - done);
+	if (rc <= 0)
+	    return done > 0 ? (int) done : rc;
+	done += rc;
+    }
+    return done;
+}
+
+/*
+ * Move data from one file to another inside the kernel.
+ * If the input file can map its data (as PFAT can, from its
+ * file data cache), it is written straight from there;
+ * otherwise it is copied through a page-sized buffer, and like
+ * Read() we return early if the input has no more data yet.
+ * Params:
+ *   in - file to read from, starting at its current position
+ *   out - file to write to
+ *   len - maximum number of bytes to move
+ * Returns: number of bytes moved, 0 if in is at end of file,
+ *   or error code (< 0) if nothing could be moved
+ */
+int Splice(struct File *in, struct File *out, ulong_t len)
+{
+    ulong_t done = 0;
+    char *buf = 0;
+    int rc = 0;
+
+    if (len > INT_MAX)
+	len = INT_MAX;
+
+    if (in->ops->Map_Data != 0) {
+	while (done < len) {
+	    void *data;
+	    int n;
+
+	    rc = in->ops->Map_Data(in, len - done, &data);
+	    if (rc <= 0)
+		break;
+	    n = rc;
+	    rc = Write_All(out, data, n);
+	    if (rc > 0) {
+		/* Map_Data leaves moving the position to us */
+		in->filePos += rc;
+		done += rc;
+	    }
+	    if (rc < n)
+		break;
+	}
+    } else {
+	if ((buf = Alloc_Page()) == 0)
+	    return ENOMEM;
+
+	while (done < len) {
+	    ulong_t want = len - done < PAGE_SIZE ? len - done : PAGE_SIZE;
+	    int n;
+
+	    rc = Read(in, buf, want);
+	    if (rc <= 0)
+		break;
+	    n = rc;
+	    rc = Write_All(out, buf, n);
+	    if (rc > 0)
+		done += rc;
+	    /*
+	     * Stop at a short read, as Read() would: a pipe or the
+	     * console has nothing more for us yet.
+	     */
+	    if (rc < n || (ulong_t) n < want)
+		break;
+	}
+	Free_Page(buf);
+    }
+
+    return done > 0 ? (int) done : rc;
+}
+
 /*
  * Completely read named file into a buffer.
  * Params:
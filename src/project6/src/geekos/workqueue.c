@@ -0,0 +1,164 @@
+/*
+ * Deferred work
+ * $Revision: 1.1 $
+ * 
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <geekos/kassert.h>
+#include <geekos/int.h>
+#include <geekos/kthread.h>
+#include <geekos/workqueue.h>
+
+/*
+ * Interrupt handlers should do as little as possible with
+ * interrupts disabled.  Anything that can wait is posted as a
+ * work item, and run shortly afterwards by a kernel thread with
+ * interrupts enabled.
+ *
+ * There is a single work thread, so a work function must not
+ * wait for anything that needs another work item to run first,
+ * such as block I/O completion.
+ */
+
+/* ----------------------------------------------------------------------
+ * Private data
+ * ---------------------------------------------------------------------- */
+
+IMPLEMENT_LIST(Work_List, Work_Item);
+
+static struct Work_List s_workQueue[NUM_WORK_PRIORITIES];
+static int s_numQueued;
+
+/*
+ * Queue where the work thread waits for work to arrive.
+ */
+static struct Thread_Queue s_workWaitQueue;
+
+static struct Work_Stats s_workStats;
+
+/* ----------------------------------------------------------------------
+ * Private functions
+ * ---------------------------------------------------------------------- */
+
+/*
+ * Remove the next work item to run from the queues, or return 0
+ * if they are all empty.  Interrupts must be disabled.
+ */
+static struct Work_Item *Dequeue_Work(void)
+{
+    int i;
+
+    KASSERT(!Interrupts_Enabled());
+
+    for (i = 0; i < NUM_WORK_PRIORITIES; ++i) {
+	if (!Is_Work_List_Empty(&s_workQueue[i])) {
+	    struct Work_Item *item = Remove_From_Front_Of_Work_List(&s_workQueue[i]);
+	    item->queued = false;
+	    --s_numQueued;
+	    return item;
+	}
+    }
+    return 0;
+}
+
+/*
+ * The work thread: run queued work items, highest priority first.
+ */
+static void Work_Thread(ulong_t arg)
+{
+    Disable_Interrupts();
+    for (;;) {
+	struct Work_Item *item = Dequeue_Work();
+
+	if (item == 0) {
+	    Wait(&s_workWaitQueue);
+	    continue;
+	}
+
+	++s_workStats.itemsRun;
+
+	/* The item may be queued again, or freed, as soon as it runs */
+	Enable_Interrupts();
+	item->func(item->arg);
+	Disable_Interrupts();
+    }
+}
+
+/* ----------------------------------------------------------------------
+ * Public functions
+ * ---------------------------------------------------------------------- */
+
+/*
+ * Start the work thread.
+ * Work may be queued before this is called; it will run
+ * once the thread starts.
+ */
+void Init_Work_Queues(void)
+{
+    Start_Kernel_Thread(&Work_Thread, 0, PRIORITY_HIGH, true);
+}
+
+/*
+ * Initialize a work item which will call func(arg) when run.
+ */
+void Init_Work_Item(struct Work_Item *item, Work_Func func, ulong_t arg)
+{
+    item->func = func;
+    item->arg = arg;
+    item->queued = false;
+}
+
+/*
+ * Queue given work item to be run by the work thread.
+ * May be called from interrupt handlers.  Interrupts must be disabled.
+ * Returns true if the item was queued, false if it was already
+ * waiting to run.
+ */
+bool Queue_Work(struct Work_Item *item, int priority)
+{
+    KASSERT(!Interrupts_Enabled());
+    KASSERT(priority >= 0 && priority < NUM_WORK_PRIORITIES);
+
+    if (item->queued)
+	return false;
+
+    item->queued = true;
+    item->priority = priority;
+    Add_To_Back_Of_Work_List(&s_workQueue[priority], item);
+    if (++s_numQueued > s_workStats.maxQueued)
+	s_workStats.maxQueued = s_numQueued;
+    ++s_workStats.itemsQueued;
+
+    Wake_Up(&s_workWaitQueue);
+    return true;
+}
+
+/*
+ * Remove given work item from its queue, if it has not run yet.
+ * Interrupts must be disabled.
+ * Returns true if the item was removed, false if it was not queued.
+ */
+bool Cancel_Work(struct Work_Item *item)
+{
+    KASSERT(!Interrupts_Enabled());
+
+    if (!item->queued)
+	return false;
+
+    Remove_From_Work_List(&s_workQueue[item->priority], item);
+    item->queued = false;
+    --s_numQueued;
+    return true;
+}
+
+/*
+ * Get a snapshot of the deferred work counters.
+ */
+void Get_Work_Stats(struct Work_Stats *stats)
+{
+    bool iflag = Begin_Int_Atomic();
+    *stats = s_workStats;
+    End_Int_Atomic(iflag);
+}
@@ -0,0 +1,440 @@
+/*
+ * Compressed in-memory swap cache
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+/*
+ * Pages evicted from user address spaces are first compressed
+ * into a pool in the kernel heap.  Faulting on such a page only
+ * costs a decompression, not a disk read.  When the pool fills,
+ * its least recently stored pages are spilled to the paging file.
+ *
+ * The page table entry of a page held in the pool is marked
+ * KINFO_PAGE_COMPRESSED, and its pageBaseAddr field holds the
+ * handle (index) of the pool entry.
+ */
+
+#include <geekos/ktypes.h>
+#include <geekos/kassert.h>
+#include <geekos/screen.h>
+#include <geekos/int.h>
+#include <geekos/mem.h>
+#include <geekos/malloc.h>
+#include <geekos/string.h>
+#include <geekos/synch.h>
+#include <geekos/list.h>
+#include <geekos/paging.h>
+#include <geekos/zswap.h>
+
+/* ----------------------------------------------------------------------
+ * Private data and functions
+ * ---------------------------------------------------------------------- */
+
+/*
+ * Compressor parameters.
+ * The format is LZSS: a flag byte precedes each group of eight
+ * items.  A clear flag bit means a literal byte follows; a set
+ * bit means a two byte back reference with a 12 bit offset
+ * and a 4 bit length follows.
+ */
+#define LZ_MIN_MATCH	3
+#define LZ_MAX_MATCH	(LZ_MIN_MATCH + 15)
+#define LZ_MAX_OFFSET	4095
+#define LZ_HASH_BITS	12
+#define LZ_HASH(p)	((((p)[0] << 8) ^ ((p)[1] << 4) ^ (p)[2]) & ((1 << LZ_HASH_BITS) - 1))
+
+/*
+ * States of a pool entry.
+ */
+enum Zswap_Entry_State {
+    ZSWAP_FREE,			 /* on the free list */
+    ZSWAP_STORED,		 /* on the LRU list */
+    ZSWAP_SPILLING,		 /* being written to the paging file */
+    ZSWAP_DEAD			 /* faulted in or freed while being spilled */
+};
+
+struct Zswap_Entry;
+DEFINE_LIST(Zswap_Entry_List, Zswap_Entry);
+
+struct Zswap_Entry {
+    enum Zswap_Entry_State state;
+    int length;			 /* Compressed length; 0 for a page of zeroes */
+    uchar_t *data;		 /* Compressed data */
+    pte_t *entry;		 /* Page table entry referring to the page */
+    DEFINE_LINK(Zswap_Entry_List, Zswap_Entry);
+};
+
+IMPLEMENT_LIST(Zswap_Entry_List, Zswap_Entry);
+
+static struct Zswap_Entry s_entries[ZSWAP_MAX_ENTRIES];
+static struct Zswap_Entry_List s_freeEntries;
+static struct Zswap_Entry_List s_lruList;	 /* oldest at front */
+
+/*
+ * Compressor work areas.  Only used with interrupts disabled.
+ */
+static ushort_t s_lzHashTable[1 << LZ_HASH_BITS];
+static uchar_t s_compressBuf[ZSWAP_MAX_COMPRESSED];
+
+/*
+ * Page used to hold decompressed data on its way to the paging file.
+ */
+static void *s_spillPage;
+static struct Mutex s_spillLock;
+
+static struct Zswap_Stats s_zswapStats;
+
+/*
+ * Compress srcLen bytes at src into dst.
+ * Returns the compressed length, or -1 if it would exceed dstMax.
+ */
+static int LZ_Compress(const uchar_t *src, int srcLen, uchar_t *dst, int dstMax)
+{
+    int ip = 0, op = 0;
+
+    memset(s_lzHashTable, '\0', sizeof(s_lzHashTable));
+
+    while (ip < srcLen) {
+	int flagPos, bit;
+	uchar_t flags = 0;
+
+	/* Room for a flag byte and eight back references */
+	if (op + 1 + 8 * 2 > dstMax)
+	    return -1;
+	flagPos = op++;
+
+	for (bit = 0; bit < 8 && ip < srcLen; ++bit) {
+	    int len = 0, offset = 0;
+
+	    if (ip + LZ_MIN_MATCH <= srcLen) {
+		uint_t h = LZ_HASH(src + ip);
+		int cand = s_lzHashTable[h] - 1;
+
+		s_lzHashTable[h] = ip + 1;
+		if (cand >= 0 && ip - cand <= LZ_MAX_OFFSET &&
+		    src[cand] == src[ip] && src[cand+1] == src[ip+1] && src[cand+2] == src[ip+2]) {
+		    int max = MIN(LZ_MAX_MATCH, srcLen - ip);
+		    len = LZ_MIN_MATCH;
+		    while (len < max && src[cand + len] == src[ip + len])
+			++len;
+		    offset = ip - cand;
+		}
+	    }
+
+	    if (len > 0) {
+		flags |= (1 << bit);
+		dst[op++] = offset & 0xff;
+		dst[op++] = ((offset >> 8) & 0x0f) | ((len - LZ_MIN_MATCH) << 4);
+		ip += len;
+	    } else {
+		dst[op++] = src[ip++];
+	    }
+	}
+
+	dst[flagPos] = flags;
+    }
+
+    return op;
+}
+
+/*
+ * Decompress srcLen bytes at src into dstLen bytes at dst.
+ */
+static void LZ_Decompress(const uchar_t *src, int srcLen, uchar_t *dst, int dstLen)
+{
+    int ip = 0, op = 0;
+
+    while (ip < srcLen && op < dstLen) {
+	uchar_t flags = src[ip++];
+	int bit;
+
+	for (bit = 0; bit < 8 && ip < srcLen && op < dstLen; ++bit) {
+	    if (flags & (1 << bit)) {
+		int offset = src[ip] | ((src[ip+1] & 0x0f) << 8);
+		int len = (src[ip+1] >> 4) + LZ_MIN_MATCH;
+		ip += 2;
+		KASSERT(offset > 0 && offset <= op && op + len <= dstLen);
+		/* Byte at a time, since the match may overlap the output */
+		while (len-- > 0) {
+		    dst[op] = dst[op - offset];
+		    ++op;
+		}
+	    } else {
+		dst[op++] = src[ip++];
+	    }
+	}
+    }
+
+    KASSERT(op == dstLen);
+}
+
+/*
+ * Is the page entirely zero?
+ */
+static bool Is_Zero_Page(const void *paddr)
+{
+    const ulong_t *p = (const ulong_t*) paddr;
+    int i;
+
+    for (i = 0; i < PAGE_SIZE / sizeof(ulong_t); ++i)
+	if (p[i] != 0)
+	    return false;
+    return true;
+}
+
+/*
+ * Return an entry's data and the entry itself to the free pool.
+ * Interrupts must be disabled.
+ */
+static void Free_Entry(struct Zswap_Entry *zentry)
+{
+    KASSERT(!Interrupts_Enabled());
+
+    if (zentry->data != 0) {
+	Free(zentry->data);
+	zentry->data = 0;
+    }
+    s_zswapStats.poolBytes -= zentry->length;
+    s_zswapStats.poolEntries--;
+    zentry->state = ZSWAP_FREE;
+    zentry->entry = 0;
+    Add_To_Back_Of_Zswap_Entry_List(&s_freeEntries, zentry);
+}
+
+/*
+ * Unpack an entry's contents into given page.
+ */
+static void Decompress_Entry(struct Zswap_Entry *zentry, void *paddr)
+{
+    if (zentry->length == 0)
+	memset(paddr, '\0', PAGE_SIZE);
+    else
+	LZ_Decompress(zentry->data, zentry->length, paddr, PAGE_SIZE);
+}
+
+/*
+ * Does the pool have room for numPages more pages?
+ * Assumes each will compress to half a page.
+ */
+static bool Have_Room(int numPages)
+{
+    return s_zswapStats.poolEntries + numPages <= ZSWAP_MAX_ENTRIES &&
+	s_zswapStats.poolBytes + numPages * (PAGE_SIZE / 2) <= ZSWAP_POOL_SIZE;
+}
+
+/*
+ * Move the oldest page in the pool to the paging file.
+ * Interrupts must be enabled, since the I/O may block.
+ * Returns true if an entry was spilled.
+ */
+static bool Spill_Oldest_Entry(void)
+{
+    struct Zswap_Entry *zentry;
+    int pagefileIndex, rc;
+
+    KASSERT(Interrupts_Enabled());
+
+    Mutex_Lock(&s_spillLock);
+    Disable_Interrupts();
+
+    zentry = Get_Front_Of_Zswap_Entry_List(&s_lruList);
+    if (zentry == 0 || (pagefileIndex = Find_Space_On_Paging_File()) < 0) {
+	Enable_Interrupts();
+	Mutex_Unlock(&s_spillLock);
+	return false;
+    }
+    Remove_From_Zswap_Entry_List(&s_lruList, zentry);
+    zentry->state = ZSWAP_SPILLING;
+    Decompress_Entry(zentry, s_spillPage);
+
+    Enable_Interrupts();
+    rc = Write_Cluster_To_Paging_File(&s_spillPage, 1, pagefileIndex);
+    Disable_Interrupts();
+
+    if (zentry->state == ZSWAP_SPILLING && rc == 0) {
+	/* Redirect the page table entry to the paging file */
+	zentry->entry->kernelInfo = KINFO_PAGE_ON_DISK;
+	zentry->entry->pageBaseAddr = pagefileIndex;
+	s_zswapStats.spilledPages++;
+	Free_Entry(zentry);
+    } else {
+	Free_Space_On_Paging_File(pagefileIndex);
+	if (zentry->state == ZSWAP_DEAD) {
+	    Free_Entry(zentry);
+	} else {
+	    /* Write failed; keep the page in the pool */
+	    zentry->state = ZSWAP_STORED;
+	    Add_To_Back_Of_Zswap_Entry_List(&s_lruList, zentry);
+	}
+    }
+
+    Enable_Interrupts();
+    Mutex_Unlock(&s_spillLock);
+
+    return rc == 0;
+}
+
+/* ----------------------------------------------------------------------
+ * Public functions
+ * ---------------------------------------------------------------------- */
+
+/*
+ * Initialize the compressed pool.
+ */
+void Init_Zswap(void)
+{
+    int i;
+
+    for (i = 0; i < ZSWAP_MAX_ENTRIES; ++i) {
+	s_entries[i].state = ZSWAP_FREE;
+	Add_To_Back_Of_Zswap_Entry_List(&s_freeEntries, &s_entries[i]);
+    }
+
+    s_spillPage = Alloc_Page();
+    if (s_spillPage == 0)
+	Panic("Could not allocate zswap spill page\n");
+    Mutex_Init(&s_spillLock);
+
+    Print("Compressed swap pool: %d KB, %d pages max\n", ZSWAP_POOL_SIZE / 1024, ZSWAP_MAX_ENTRIES);
+}
+
+/*
+ * Spill cold pages to the paging file until the pool
+ * can probably take numPages more pages.
+ * Interrupts must be enabled.
+ */
+void Zswap_Make_Room(int numPages)
+{
+    bool room;
+
+    KASSERT(Interrupts_Enabled());
+
+    for (;;) {
+	Disable_Interrupts();
+	room = Have_Room(numPages);
+	Enable_Interrupts();
+	if (room || !Spill_Oldest_Entry())
+	    break;
+    }
+}
+
+/*
+ * Compress a (locked) page into the pool.
+ * Interrupts must be disabled.
+ * @param paddr physical address of the page
+ * @param entry page table entry that will refer to the pool entry
+ * @return handle of the pool entry, or -1 if the page is
+ *   incompressible or the pool is full
+ */
+int Zswap_Store(void *paddr, pte_t *entry)
+{
+    struct Zswap_Entry *zentry;
+    int length = 0;
+    uchar_t *data = 0;
+
+    KASSERT(!Interrupts_Enabled());
+
+    if (Is_Zero_Page(paddr)) {
+	s_zswapStats.zeroPages++;
+    } else {
+	length = LZ_Compress(paddr, PAGE_SIZE, s_compressBuf, ZSWAP_MAX_COMPRESSED);
+	if (length < 0) {
+	    s_zswapStats.rejectedPages++;
+	    return -1;
+	}
+    }
+
+    if (Is_Zswap_Entry_List_Empty(&s_freeEntries) ||
+	s_zswapStats.poolBytes + length > ZSWAP_POOL_SIZE)
+	return -1;
+
+    if (length > 0) {
+	data = Malloc(length);
+	if (data == 0)
+	    return -1;
+	memcpy(data, s_compressBuf, length);
+    }
+
+    zentry = Get_Front_Of_Zswap_Entry_List(&s_freeEntries);
+    Remove_From_Front_Of_Zswap_Entry_List(&s_freeEntries);
+    zentry->state = ZSWAP_STORED;
+    zentry->length = length;
+    zentry->data = data;
+    zentry->entry = entry;
+    Add_To_Back_Of_Zswap_Entry_List(&s_lruList, zentry);
+
+    s_zswapStats.storedPages++;
+    s_zswapStats.compressedBytes += length;
+    s_zswapStats.poolEntries++;
+    s_zswapStats.poolBytes += length;
+
+    return zentry - s_entries;
+}
+
+/*
+ * Decompress a pool entry into given page, and release the entry.
+ * Interrupts must be disabled.
+ */
+void Zswap_Load(int handle, void *paddr)
+{
+    struct Zswap_Entry *zentry;
+
+    KASSERT(!Interrupts_Enabled());
+    KASSERT(handle >= 0 && handle < ZSWAP_MAX_ENTRIES);
+
+    zentry = &s_entries[handle];
+    KASSERT(zentry->state == ZSWAP_STORED || zentry->state == ZSWAP_SPILLING);
+
+    Decompress_Entry(zentry, paddr);
+    s_zswapStats.loadedPages++;
+    Zswap_Invalidate(handle);
+}
+
+/*
+ * Discard a pool entry whose page is no longer needed.
+ * Interrupts must be disabled.
+ */
+void Zswap_Invalidate(int handle)
+{
+    struct Zswap_Entry *zentry;
+
+    KASSERT(!Interrupts_Enabled());
+    KASSERT(handle >= 0 && handle < ZSWAP_MAX_ENTRIES);
+
+    zentry = &s_entries[handle];
+    if (zentry->state == ZSWAP_SPILLING) {
+	/* The spilling thread will free it when its write completes */
+	zentry->state = ZSWAP_DEAD;
+    } else {
+	KASSERT(zentry->state == ZSWAP_STORED);
+	Remove_From_Zswap_Entry_List(&s_lruList, zentry);
+	Free_Entry(zentry);
+    }
+}
+
+/*
+ * Does given pool entry still hold the page referred to
+ * by given page table entry?
+ * Interrupts must be disabled.
+ */
+bool Zswap_Holds(int handle, pte_t *entry)
+{
+    KASSERT(!Interrupts_Enabled());
+    KASSERT(handle >= 0 && handle < ZSWAP_MAX_ENTRIES);
+
+    return (s_entries[handle].state == ZSWAP_STORED || s_entries[handle].state == ZSWAP_SPILLING) &&
+	s_entries[handle].entry == entry;
+}
+
+/*
+ * Get a snapshot of the compressed pool counters.
+ */
+void Get_Zswap_Stats(struct Zswap_Stats *stats)
+{
+    bool iflag = Begin_Int_Atomic();
+    *stats = s_zswapStats;
+    End_Int_Atomic(iflag);
+}
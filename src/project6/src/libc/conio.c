@@ -8,6 +8,7 @@
  */
 
 #include <geekos/syscall.h>
+#include <geekos/errno.h>
 #include <fmtout.h>
 #include <string.h>
 #include <fileio.h>
@@ -15,20 +16,123 @@
 
 static bool s_echo = true;
 
+/*
+ * Output from Print(), Print_String() and Put_Char() is collected
+ * here and written to the console with a single Write(), rather
+ * than a system call per string or character.  It is flushed when
+ * full, at a newline if line buffered, and before anything which
+ * depends on what is on the screen: reading the keyboard, getting
+ * the cursor, changing the attribute, spawning a process, exiting.
+ */
+#define OUTPUT_BUFFER_SIZE 1024
+static char s_outputBuf[OUTPUT_BUFFER_SIZE];
+static size_t s_outputLen;
+static int s_outputMode = OUTPUT_LINE_BUFFERED;
+
 /* System call wrappers. */
-DEF_SYSCALL(Set_Attr,SYS_SETATTR,int,(int attr),int arg0 = attr;,SYSCALL_REGS_1)
-DEF_SYSCALL(Get_Cursor,SYS_GETCURSOR,int,(int *row, int *col),
+static DEF_SYSCALL(Set_Attr_Syscall,SYS_SETATTR,int,(int attr),int arg0 = attr;,SYSCALL_REGS_1)
+static DEF_SYSCALL(Get_Cursor_Syscall,SYS_GETCURSOR,int,(int *row, int *col),
     int *arg0 = row; int *arg1 = col;,SYSCALL_REGS_2)
 
+/*
+ * Add given bytes to the output buffer, writing it out as needed.
+ * Returns number of bytes output, or error code.
+ */
+static int Buffer_Output(const char *buf, size_t len)
+{
+    bool newline = false;
+    size_t i;
+    int rc;
+
+    if (s_outputMode == OUTPUT_UNBUFFERED) {
+	if ((rc = Flush_Output()) < 0)
+	    return rc;
+	return Write(1, buf, len);
+    }
+
+    if (s_outputLen + len > OUTPUT_BUFFER_SIZE) {
+	if ((rc = Flush_Output()) < 0)
+	    return rc;
+	/* Large writes go straight out */
+	if (len >= OUTPUT_BUFFER_SIZE)
+	    return Write(1, buf, len);
+    }
+
+    for (i = 0; i < len; ++i) {
+	char ch = buf[i];
+	s_outputBuf[s_outputLen++] = ch;
+	if (ch == '\n')
+	    newline = true;
+    }
+
+    if (newline && s_outputMode == OUTPUT_LINE_BUFFERED) {
+	if ((rc = Flush_Output()) < 0)
+	    return rc;
+    }
+    return (int) len;
+}
+
+/*
+ * Write out any buffered console output.
+ * Returns 0 if successful, error code if not.
+ */
+int Flush_Output(void)
+{
+    size_t done = 0;
+
+    while (done < s_outputLen) {
+	int rc = Write(1, s_outputBuf + done, s_outputLen - done);
+	if (rc <= 0) {
+	    s_outputLen = 0;
+	    return rc < 0 ? rc : EIO;
+	}
+	done += rc;
+    }
+    s_outputLen = 0;
+    return 0;
+}
+
+/*
+ * Choose how console output is buffered: OUTPUT_UNBUFFERED,
+ * OUTPUT_LINE_BUFFERED (the default) or OUTPUT_FULLY_BUFFERED.
+ * Returns the previous mode, or error code if given mode is invalid.
+ */
+int Set_Output_Buffering(int mode)
+{
+    int old = s_outputMode;
+
+    if (mode != OUTPUT_UNBUFFERED && mode != OUTPUT_LINE_BUFFERED &&
+	mode != OUTPUT_FULLY_BUFFERED)
+	return EINVALID;
+    Flush_Output();
+    s_outputMode = mode;
+    return old;
+}
+
+int Set_Attr(int attr)
+{
+    Flush_Output();
+    return Set_Attr_Syscall(attr);
+}
+
+int Get_Cursor(int *row, int *col)
+{
+    Flush_Output();
+    return Get_Cursor_Syscall(row, col);
+}
+
 int Print_String(const char *s)
 {
-    return Write(1, s, strlen(s));
+    return Buffer_Output(s, strlen(s));
 }
 
 Keycode Get_Key(void)
 {
     char buf[1];
-    int rc = Read(0, buf, 1);
+    int rc;
+
+    Flush_Output();
+    rc = Read(0, buf, 1);
     return rc == 1 ? ((Keycode) buf[0]) : 0;
 }
 
@@ -46,10 +150,9 @@ int Put_Cursor(int row, int col)
 
 int Put_Char(int ch)
 {
-    char buf[2];
+    char buf[1];
     buf[0] = (char) ch;
-    buf[1] = '\0';
-    return Print_String(buf);
+    return Buffer_Output(buf, 1);
 }
 
 void Echo(bool enable)
@@ -148,9 +251,23 @@ const char *Get_Error_String(int errno)
 	return __strerrTable[errno];
 }
 
-/* Support for Print(). */
-static void Print_Emit(struct Output_Sink *o, int ch) { Put_Char(ch); }
-static void Print_Finish(struct Output_Sink *o) { }
+/*
+ * Support for Print().  Each call's output is collected in the
+ * buffer even when output is unbuffered, and written at the end.
+ */
+static void Print_Emit(struct Output_Sink *o, int ch)
+{
+    if (s_outputLen == OUTPUT_BUFFER_SIZE)
+	Flush_Output();
+    s_outputBuf[s_outputLen++] = (char) ch;
+    if (ch == '\n' && s_outputMode == OUTPUT_LINE_BUFFERED)
+	Flush_Output();
+}
+static void Print_Finish(struct Output_Sink *o)
+{
+    if (s_outputMode == OUTPUT_UNBUFFERED)
+	Flush_Output();
+}
 static struct Output_Sink s_outputSink = { &Print_Emit, &Print_Finish };
 
 void Print(const char *fmt, ...)
@@ -9,10 +9,25 @@
  */
 
 #include <geekos/argblock.h>
+#include <geekos/cpu.h>
+#include <geekos/syscall.h>
+#include <geekos/vdso.h>
 
 int main(int argc, char **argv);
 void Exit(int exitCode);
 
+/*
+ * The kernel accepts sysenter whenever the processor supports it.
+ */
+int g_useSysenter;
+
+/*
+ * Whether the kernel data pages are mapped at VDSO_USER_ADDR.
+ */
+int g_haveVDSO;
+
+static DEF_SYSCALL(Has_VDSO,SYS_HASVDSO,int,(void),,SYSCALL_REGS_0)
+
 /*
  * Entry point.  Calls user program's main() routine, then exits.
  */
@@ -23,6 +38,9 @@ void _Entry(void)
     /* The argument block pointer is in the ESI register. */
     __asm__ __volatile__ ("movl %%esi, %0" : "=r" (argBlock));
 
+    g_haveVDSO = Has_VDSO();
+    g_useSysenter = Has_Sysenter();
+
     /* Call main(), and then exit with whatever value it returns. */
     Exit(main(argBlock->argc, argBlock->argv));
 }
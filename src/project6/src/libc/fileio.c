@@ -48,12 +48,30 @@ DEF_SYSCALL(Seek,SYS_SEEK,int,(int fd, int pos),
 DEF_SYSCALL(Delete,SYS_DELETE,int,(const char *path),
     const char *arg0 = path; size_t arg1 = strlen(path);,
     SYSCALL_REGS_2)
+DEF_SYSCALL(Splice,SYS_SPLICE,int,(int inFd, int outFd, ulong_t len),
+    int arg0 = inFd; int arg1 = outFd; ulong_t arg2 = len;,
+    SYSCALL_REGS_3)
+DEF_SYSCALL(Read_At,SYS_READAT,int, (int fd, ulong_t pos, void *buf, ulong_t len),
+    int arg0 = fd; ulong_t arg1 = pos; void *arg2 = buf; ulong_t arg3 = len;,
+    SYSCALL_REGS_4)
+DEF_SYSCALL(Write_At,SYS_WRITEAT,int, (int fd, ulong_t pos, const void *buf, ulong_t len),
+    int arg0 = fd; ulong_t arg1 = pos; const void *arg2 = buf; ulong_t arg3 = len;,
+    SYSCALL_REGS_4)
+DEF_SYSCALL(Read_Vector,SYS_READVECTOR,int, (int fd, const struct IO_Vector *vec, int count),
+    int arg0 = fd; const struct IO_Vector *arg1 = vec; int arg2 = count;,
+    SYSCALL_REGS_3)
+DEF_SYSCALL(Write_Vector,SYS_WRITEVECTOR,int, (int fd, const struct IO_Vector *vec, int count),
+    int arg0 = fd; const struct IO_Vector *arg1 = vec; int arg2 = count;,
+    SYSCALL_REGS_3)
 
 
 DEF_SYSCALL(Create_Pipe,SYS_CREATEPIPE,int,
     (int *readfd, int *writefd),
     int *arg0 = readfd; int *arg1 = writefd;,
     SYSCALL_REGS_2)
+DEF_SYSCALL(IO_Ring_Enter,SYS_IORINGENTER,int,(struct IO_Ring *ring),
+    struct IO_Ring *arg0 = ring;,
+    SYSCALL_REGS_1)
 
 static bool Copy_String(char *dst, const char *src, size_t len)
 {
@@ -87,3 +105,85 @@ int Mount(const char *devname, const char *prefix, const char *fstype)
     return rc;
 }
 
+/*
+ * Prepare an empty IO_Ring.
+ */
+void IO_Ring_Init(struct IO_Ring *ring)
+{
+    memset(ring, '\0', sizeof(*ring));
+}
+
+/*
+ * Queue a system call on given ring, to be run by the next
+ * IO_Ring_Enter().  Arguments are the register values the
+ * system call takes.  Returns 0, or EBUSY if the ring is full.
+ */
+static int Queue_Op(struct IO_Ring *ring, int op, ulong_t arg0, ulong_t arg1,
+    ulong_t arg2, ulong_t userData)
+{
+    struct IO_Ring_Indices *indices = &ring->indices;
+    struct IO_Ring_SQE *sqe;
+
+    if (indices->sqTail - indices->sqHead == IO_RING_ENTRIES)
+	return EBUSY;
+
+    sqe = &ring->sq[indices->sqTail & (IO_RING_ENTRIES - 1)];
+    sqe->op = op;
+    sqe->args[0] = arg0;
+    sqe->args[1] = arg1;
+    sqe->args[2] = arg2;
+    sqe->args[3] = sqe->args[4] = 0;
+    sqe->userData = userData;
+    ++indices->sqTail;
+    return 0;
+}
+
+int IO_Ring_Prep_Open(struct IO_Ring *ring, const char *path, int mode, ulong_t userData)
+{
+    return Queue_Op(ring, SYS_OPEN, (ulong_t) path, strlen(path), mode, userData);
+}
+
+int IO_Ring_Prep_Close(struct IO_Ring *ring, int fd, ulong_t userData)
+{
+    return Queue_Op(ring, SYS_CLOSE, fd, 0, 0, userData);
+}
+
+int IO_Ring_Prep_Read(struct IO_Ring *ring, int fd, void *buf, ulong_t len, ulong_t userData)
+{
+    return Queue_Op(ring, SYS_READ, fd, (ulong_t) buf, len, userData);
+}
+
+int IO_Ring_Prep_Write(struct IO_Ring *ring, int fd, const void *buf, ulong_t len, ulong_t userData)
+{
+    return Queue_Op(ring, SYS_WRITE, fd, (ulong_t) buf, len, userData);
+}
+
+int IO_Ring_Prep_Seek(struct IO_Ring *ring, int fd, int pos, ulong_t userData)
+{
+    return Queue_Op(ring, SYS_SEEK, fd, pos, 0, userData);
+}
+
+int IO_Ring_Prep_Stat(struct IO_Ring *ring, const char *path, struct VFS_File_Stat *stat, ulong_t userData)
+{
+    return Queue_Op(ring, SYS_STAT, (ulong_t) path, strlen(path), (ulong_t) stat, userData);
+}
+
+int IO_Ring_Prep_FStat(struct IO_Ring *ring, int fd, struct VFS_File_Stat *stat, ulong_t userData)
+{
+    return Queue_Op(ring, SYS_FSTAT, fd, (ulong_t) stat, 0, userData);
+}
+
+/*
+ * Take the next completion from given ring.
+ * Returns false if there are none.
+ */
+bool IO_Ring_Get_Completion(struct IO_Ring *ring, struct IO_Ring_CQE *cqe)
+{
+    struct IO_Ring_Indices *indices = &ring->indices;
+
+    if (indices->cqHead == indices->cqTail)
+	return false;
+    *cqe = ring->cq[indices->cqHead & (IO_RING_ENTRIES - 1)];
+    ++indices->cqHead;
+    return true;
+}
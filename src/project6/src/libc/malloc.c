@@ -0,0 +1,301 @@
+/*
+ * User mode memory allocation
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <stddef.h>
+#include <process.h>
+#include <malloc.h>
+
+/*
+ * The heap follows the data segment, and is grown and shrunk
+ * with the Brk() system call; the kernel maps zeroed pages into
+ * it as they are first touched.  Everything is carved from the
+ * "top" of the heap, the space between the highest block handed
+ * out and the end of the heap.
+ *
+ * Small blocks are rounded up to a size class, and freed blocks
+ * are kept on a free list per class, so allocating and freeing
+ * them is just a push or a pop.  This is the front end a
+ * multithreaded allocator would keep per thread; a process has
+ * only one thread, so there is no shared layer behind it and no
+ * locking.  An empty list is refilled with a batch of blocks
+ * from the top of the heap.
+ *
+ * Larger blocks come from the top of the heap too; when freed
+ * they are kept on an address ordered list, merged with free
+ * neighbours, and reused first fit.  A free block next to the
+ * top rejoins it, and when the top gets large enough the heap
+ * is shrunk, giving its pages back to the kernel.
+ */
+
+/* Every block starts with a header recording its size. */
+struct Block_Header {
+    unsigned long size;			/* Block size, including the header */
+    unsigned long pad;			/* Keeps the payload 8-byte aligned */
+};
+#define HEADER_SIZE		sizeof(struct Block_Header)
+
+/* Block sizes are multiples of this. */
+#define HEAP_QUANTUM		16
+
+/*
+ * Block sizes of the small classes, including the header.
+ * The smallest leaves room for the free list link even when
+ * zero bytes are asked for.
+ */
+#define NUM_CLASSES		13
+static const unsigned long s_classSizes[NUM_CLASSES] = {
+    32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+#define MAX_SMALL		2048
+
+/* Refill an empty class with at least this many bytes of blocks. */
+#define REFILL_BYTES		4096
+
+/* Grow the heap by at least this much at a time. */
+#define GROW_SIZE		(64 * 1024)
+
+/* Shrink the heap when this much is free at the top. */
+#define TRIM_THRESHOLD		(128 * 1024)
+
+/* A free large block, kept in address order. */
+struct Large_Free {
+    struct Block_Header header;
+    struct Large_Free *next;
+};
+
+/* Free blocks of each small class, linked through their first word */
+static void *s_freeLists[NUM_CLASSES];
+
+/* Size class for each block size, in units of HEAP_QUANTUM */
+static unsigned char s_sizeToClass[MAX_SMALL / HEAP_QUANTUM + 1];
+
+static struct Large_Free *s_largeFree;
+
+/* Top of the used part of the heap, and end of the heap */
+static char *s_top, *s_end;
+
+static int s_initialized;
+
+/*
+ * Find the heap and build the size class table.
+ */
+static int Init_Malloc(void)
+{
+    int end = Brk(0);
+    unsigned long size;
+    int i;
+
+    if (end <= 0)
+	return -1;
+
+    /* Round the start up so blocks are aligned */
+    s_top = (char*) (((unsigned long) end + HEAP_QUANTUM - 1) & ~(HEAP_QUANTUM - 1));
+    s_end = (char*) end;
+
+    for (i = 0, size = 0; size <= MAX_SMALL; size += HEAP_QUANTUM) {
+	while (s_classSizes[i] < size)
+	    ++i;
+	s_sizeToClass[size / HEAP_QUANTUM] = i;
+    }
+
+    s_initialized = 1;
+    return 0;
+}
+
+/*
+ * Take given number of bytes from the top of the heap,
+ * growing the heap if necessary.
+ * Returns null if the heap can't grow that far.
+ */
+static char *Take_From_Top(unsigned long size)
+{
+    char *result = s_top;
+
+    if (s_top + size > s_end) {
+	unsigned long grow = (s_top + size) - s_end;
+	int end;
+
+	if (grow < GROW_SIZE)
+	    grow = GROW_SIZE;
+	end = Brk((unsigned long) s_end + grow);
+	if (end < 0) {
+	    /* Try for just what is needed */
+	    end = Brk((unsigned long) s_top + size);
+	    if (end < 0)
+		return 0;
+	}
+	s_end = (char*) end;
+    }
+
+    s_top += size;
+    return result;
+}
+
+/*
+ * Give the top of the heap back to the kernel once enough
+ * of it is unused.
+ */
+static void Trim_Top(void)
+{
+    if (s_end - s_top >= TRIM_THRESHOLD) {
+	int end = Brk((unsigned long) s_top + GROW_SIZE);
+	if (end > 0)
+	    s_end = (char*) end;
+    }
+}
+
+/*
+ * Refill the free list of given class from the top of the heap.
+ * Returns 0 if successful, -1 if out of memory.
+ */
+static int Refill_Class(int cls)
+{
+    unsigned long size = s_classSizes[cls];
+    unsigned long count = REFILL_BYTES / size;
+    char *blocks;
+
+    if (count < 2)
+	count = 2;
+    blocks = Take_From_Top(count * size);
+    if (blocks == 0) {
+	count = 1;
+	blocks = Take_From_Top(size);
+	if (blocks == 0)
+	    return -1;
+    }
+
+    while (count-- > 0) {
+	char *block = blocks + count * size;
+	((struct Block_Header*) block)->size = size;
+	*((void**) (block + HEADER_SIZE)) = s_freeLists[cls];
+	s_freeLists[cls] = block + HEADER_SIZE;
+    }
+    return 0;
+}
+
+/*
+ * Allocate a block of given size (including the header)
+ * too big for the small classes.
+ */
+static void *Alloc_Large(unsigned long size)
+{
+    struct Large_Free **prev, *block;
+    struct Block_Header *header;
+
+    for (prev = &s_largeFree; (block = *prev) != 0; prev = &block->next) {
+	if (block->header.size < size)
+	    continue;
+
+	/* Split off the rest if it is big enough to be a large block */
+	if (block->header.size - size > MAX_SMALL) {
+	    struct Large_Free *rest = (struct Large_Free*) ((char*) block + size);
+	    rest->header.size = block->header.size - size;
+	    rest->next = block->next;
+	    *prev = rest;
+	    block->header.size = size;
+	} else {
+	    *prev = block->next;
+	}
+	return (char*) block + HEADER_SIZE;
+    }
+
+    header = (struct Block_Header*) Take_From_Top(size);
+    if (header == 0)
+	return 0;
+    header->size = size;
+    return (char*) header + HEADER_SIZE;
+}
+
+/*
+ * Free a large block, merging it with its free neighbours,
+ * or with the top of the heap.
+ */
+static void Free_Large(struct Block_Header *header)
+{
+    struct Large_Free *block = (struct Large_Free*) header;
+    struct Large_Free **prev = &s_largeFree, *before = 0, *after;
+
+    while ((after = *prev) != 0 && after < block) {
+	before = after;
+	prev = &after->next;
+    }
+
+    if (after != 0 && (char*) block + block->header.size == (char*) after) {
+	block->header.size += after->header.size;
+	after = after->next;
+    }
+    if (before != 0 && (char*) before + before->header.size == (char*) block) {
+	before->header.size += block->header.size;
+	before->next = after;
+	block = before;
+    } else {
+	block->next = after;
+	*prev = block;
+    }
+
+    /* The last free block may adjoin the top of the heap */
+    if (block->next == 0 && (char*) block + block->header.size == s_top) {
+	if (block == before) {
+	    for (prev = &s_largeFree; *prev != block; prev = &(*prev)->next)
+		;
+	}
+	*prev = 0;
+	s_top = (char*) block;
+	Trim_Top();
+    }
+}
+
+/*
+ * Allocate a buffer of given size.
+ * Returns null if there is not enough memory.
+ */
+void *Malloc(size_t n)
+{
+    unsigned long size;
+
+    if (!s_initialized && Init_Malloc() != 0)
+	return 0;
+    if (n > (size_t) 0x7FFFFFFF)
+	return 0;
+
+    size = (n + HEADER_SIZE + HEAP_QUANTUM - 1) & ~(HEAP_QUANTUM - 1);
+    if (size <= MAX_SMALL) {
+	int cls = s_sizeToClass[size / HEAP_QUANTUM];
+	void *buf = s_freeLists[cls];
+
+	if (buf == 0) {
+	    if (Refill_Class(cls) != 0)
+		return 0;
+	    buf = s_freeLists[cls];
+	}
+	s_freeLists[cls] = *((void**) buf);
+	return buf;
+    }
+
+    return Alloc_Large(size);
+}
+
+/*
+ * Free a buffer allocated with Malloc().
+ */
+void Free(void *buf)
+{
+    struct Block_Header *header;
+
+    if (buf == 0)
+	return;
+
+    header = (struct Block_Header*) ((char*) buf - HEADER_SIZE);
+    if (header->size <= MAX_SMALL) {
+	int cls = s_sizeToClass[header->size / HEAP_QUANTUM];
+	*((void**) buf) = s_freeLists[cls];
+	s_freeLists[cls] = buf;
+    } else {
+	Free_Large(header);
+    }
+}
@@ -12,19 +12,59 @@
 #include <geekos/ktypes.h>
 #include <geekos/syscall.h>
 #include <geekos/errno.h>
+#include <geekos/vdso.h>
 #include <string.h>
 #include <process.h>
+#include <conio.h>
 
 /* System call wrappers */
 DEF_SYSCALL(Null,SYS_NULL,int,(void),,SYSCALL_REGS_0)
-DEF_SYSCALL(Exit,SYS_EXIT,int,(int exitCode), int arg0 = exitCode;, SYSCALL_REGS_1)
-DEF_SYSCALL(Spawn_Program,SYS_SPAWN,int,
+static DEF_SYSCALL(Exit_Syscall,SYS_EXIT,int,(int exitCode), int arg0 = exitCode;, SYSCALL_REGS_1)
+static DEF_SYSCALL(Spawn_Syscall,SYS_SPAWN,int,
     (const char *program, const char *command, int stdinFd, int stdoutFd),
     const char *arg0 = program; size_t arg1 = strlen(program); const char *arg2 = command; size_t arg3 = strlen(command);
     int arg4 = ((stdinFd & 0xffff) | (stdoutFd << 16));,
     SYSCALL_REGS_5)
 DEF_SYSCALL(Wait,SYS_WAIT,int,(int pid),int arg0 = pid;,SYSCALL_REGS_1)
-DEF_SYSCALL(Get_PID,SYS_GETPID,int,(void),,SYSCALL_REGS_0)
+static DEF_SYSCALL(Get_PID_Syscall,SYS_GETPID,int,(void),,SYSCALL_REGS_0)
+DEF_SYSCALL(Get_Heap_Stats,SYS_GETHEAPSTATS,int,(struct Heap_Stats *stats),
+    struct Heap_Stats *arg0 = stats;,SYSCALL_REGS_1)
+DEF_SYSCALL(Brk,SYS_BRK,int,(unsigned long end),unsigned long arg0 = end;,SYSCALL_REGS_1)
+static DEF_SYSCALL(Print_Paging_Stats_Syscall,SYS_PRINTPAGINGSTATS,int,(void),,SYSCALL_REGS_0)
+
+/*
+ * Buffered console output must be written before the process
+ * goes away, and before a child process can write to the console.
+ */
+int Exit(int exitCode)
+{
+    Flush_Output();
+    return Exit_Syscall(exitCode);
+}
+
+int Spawn_Program(const char *program, const char *command, int stdinFd, int stdoutFd)
+{
+    Flush_Output();
+    return Spawn_Syscall(program, command, stdinFd, stdoutFd);
+}
+
+/* The kernel prints these itself, so get our output out first. */
+int Print_Paging_Stats(void)
+{
+    Flush_Output();
+    return Print_Paging_Stats_Syscall();
+}
+
+/*
+ * The pid is in the process's kernel data page,
+ * so no system call is needed if it is mapped.
+ */
+int Get_PID(void)
+{
+    if (!g_haveVDSO)
+	return Get_PID_Syscall();
+    return VDSO_PROCESS_DATA->pid;
+}
 
 #define CMDLEN 79
 
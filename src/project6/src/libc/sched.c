@@ -9,10 +9,75 @@
  */
 
 #include <geekos/syscall.h>
+#include <geekos/sched.h>
+#include <geekos/vdso.h>
+#include <geekos/cpu.h>
 #include <string.h>
+#include <conio.h>
+#include <sched.h>
 
 DEF_SYSCALL(Set_Scheduling_Policy,SYS_SETSCHEDULINGPOLICY,int, (int policy, int quantum),
     int arg0 = policy; int arg1 = quantum;,
     SYSCALL_REGS_2)
-DEF_SYSCALL(Get_Time_Of_Day,SYS_GETTIMEOFDAY,int,(void),,SYSCALL_REGS_0)
+static DEF_SYSCALL(Get_Time_Of_Day_Syscall,SYS_GETTIMEOFDAY,int,(void),,SYSCALL_REGS_0)
+static DEF_SYSCALL(Get_Monotonic_Time_Syscall,SYS_GETMONOTONICTIME,int,(unsigned long long *ns),
+    unsigned long long *arg0 = ns;,SYSCALL_REGS_1)
+DEF_SYSCALL(Sleep,SYS_SLEEP,int,(int us),int arg0 = us;,SYSCALL_REGS_1)
+DEF_SYSCALL(Set_Nice,SYS_SETNICE,int,(int nice),int arg0 = nice;,SYSCALL_REGS_1)
+DEF_SYSCALL(Get_Process_Times,SYS_GETPROCESSTIMES,int,(struct Process_Times *times),
+    struct Process_Times *arg0 = times;,SYSCALL_REGS_1)
 
+/*
+ * The clock is read from the kernel's shared time data page,
+ * so these don't need system calls unless it isn't mapped.
+ */
+int Get_Time_Of_Day(void)
+{
+    if (!g_haveVDSO)
+	return Get_Time_Of_Day_Syscall();
+    return (int) VDSO_TIME_DATA->ticks;
+}
+
+/*
+ * Get nanoseconds since boot.  Same computation as
+ * Get_Monotonic_Time_NS() in the kernel.
+ */
+int Get_Monotonic_Time(unsigned long long *ns)
+{
+    const struct VDSO_Time_Data *timeData = VDSO_TIME_DATA;
+    unsigned long long cycles, lo, hi;
+
+    if (!g_haveVDSO)
+	return Get_Monotonic_Time_Syscall(ns);
+
+    if (!timeData->haveTSC) {
+	*ns = (unsigned long long) timeData->ticks * timeData->nsPerTick;
+	return 0;
+    }
+
+    /* The product cycles * tscMult needs up to 96 bits */
+    cycles = Read_TSC() - timeData->tscBoot;
+    lo = (unsigned long long) (unsigned long) cycles * timeData->tscMult;
+    hi = (unsigned long long) (unsigned long) (cycles >> 32) * timeData->tscMult;
+    *ns = (lo >> timeData->tscShift) + (hi << (32 - timeData->tscShift));
+    return 0;
+}
+
+/*
+ * Print the CPU share and response time (delay before first
+ * being scheduled) of the calling process.
+ */
+void Print_Process_Times(const char *name)
+{
+    struct Process_Times times;
+    unsigned long elapsed;
+
+    if (Get_Process_Times(&times) != 0)
+	return;
+
+    elapsed = times.now - times.startTime;
+    Print("%s: %lu ms CPU in %lu ms (%lu%%), first ran after %lu us\n",
+	name, times.cpuTime / 1000, elapsed / 1000,
+	elapsed >= 100 ? times.cpuTime / (elapsed / 100) : 0,
+	times.firstRunTime - times.startTime);
+}
@@ -0,0 +1,153 @@
+/*
+ * Host-side benchmark for the common library's block memory routines
+ * $Revision: 1.1 $
+ *
+ * The common library objects are linked in with their symbols
+ * prefixed with "geekos_" (see the strbench rule in the build
+ * Makefile), so they can be timed against the host C library
+ * and checked against it for correctness.
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void *geekos_memset(void *s, int c, size_t n);
+void *geekos_memcpy(void *dst, const void *src, size_t n);
+void *geekos_memmove(void *dst, const void *src, size_t n);
+int geekos_memcmp(const void *s1, const void *s2, size_t n);
+
+/* Referenced by strdup() in the common library. */
+void *geekos_Malloc(size_t size)
+{
+    return malloc(size);
+}
+
+#define MAX_SIZE	(64 * 1024)
+#define BYTES_PER_SIZE	(64 * 1024 * 1024)
+
+static unsigned char s_src[MAX_SIZE + 16], s_dst[MAX_SIZE + 16];
+static unsigned char s_ref[MAX_SIZE + 16];
+
+enum { OP_MEMSET, OP_MEMCPY, OP_MEMMOVE, OP_MEMCMP, NUM_OPS };
+static const char *s_opNames[NUM_OPS] = { "memset", "memcpy", "memmove", "memcmp" };
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static volatile int s_sink;
+
+/*
+ * Return throughput in MB/s of given operation on given size buffer,
+ * either for the common library or the host library.
+ */
+static double Time_Op(int op, size_t size, int host)
+{
+    long i, iters = BYTES_PER_SIZE / size;
+    double start = Now(), elapsed;
+
+    for (i = 0; i < iters; ++i) {
+	switch (op) {
+	case OP_MEMSET:
+	    if (host) memset(s_dst, (int) i, size);
+	    else geekos_memset(s_dst, (int) i, size);
+	    break;
+	case OP_MEMCPY:
+	    if (host) memcpy(s_dst, s_src, size);
+	    else geekos_memcpy(s_dst, s_src, size);
+	    break;
+	case OP_MEMMOVE:
+	    if (host) memmove(s_src + 1, s_src, size);
+	    else geekos_memmove(s_src + 1, s_src, size);
+	    break;
+	case OP_MEMCMP:
+	    if (host) s_sink += memcmp(s_dst, s_ref, size);
+	    else s_sink += geekos_memcmp(s_dst, s_ref, size);
+	    break;
+	}
+    }
+    elapsed = Now() - start;
+    return elapsed > 0 ? (double) iters * size / elapsed / 1e6 : 0;
+}
+
+static int Sign(int x)
+{
+    return x < 0 ? -1 : x > 0;
+}
+
+/*
+ * Check the common library against the host for all small
+ * sizes and alignments, and for overlapping moves.
+ */
+static int Check(void)
+{
+    size_t n, so, doff;
+    int errors = 0;
+
+    for (n = 0; n < 80; ++n) {
+	for (so = 0; so < 4; ++so) {
+	    for (doff = 0; doff < 4; ++doff) {
+		size_t i;
+		for (i = 0; i < sizeof(s_src); ++i)
+		    s_src[i] = (unsigned char) (i * 7 + 1);
+
+		memset(s_dst, 0xAA, sizeof(s_dst));
+		geekos_memcpy(s_dst + doff, s_src + so, n);
+		if (memcmp(s_dst + doff, s_src + so, n) != 0 ||
+		    s_dst[doff + n] != 0xAA || (doff > 0 && s_dst[doff - 1] != 0xAA))
+		    ++errors;
+
+		memset(s_ref, 0xAA, sizeof(s_ref));
+		memset(s_ref + doff, (int) n, n);
+		memset(s_dst, 0xAA, sizeof(s_dst));
+		geekos_memset(s_dst + doff, (int) n, n);
+		if (memcmp(s_dst, s_ref, sizeof(s_dst)) != 0)
+		    ++errors;
+
+		memcpy(s_ref, s_src, sizeof(s_ref));
+		memmove(s_ref + doff, s_ref + so, n);
+		geekos_memmove(s_src + doff, s_src + so, n);
+		if (memcmp(s_src, s_ref, sizeof(s_src)) != 0)
+		    ++errors;
+
+		memcpy(s_ref, s_src, sizeof(s_ref));
+		if (n > 0)
+		    s_ref[so + n - 1] ^= 0x80;
+		if (Sign(geekos_memcmp(s_src + so, s_ref + so, n)) !=
+		    Sign(memcmp(s_src + so, s_ref + so, n)))
+		    ++errors;
+	    }
+	}
+    }
+    return errors;
+}
+
+int main(void)
+{
+    size_t size;
+    int op, errors;
+
+    errors = Check();
+    printf("correctness check: %d errors\n", errors);
+    if (errors != 0)
+	return 1;
+
+    printf("%-8s %8s %12s %12s\n", "op", "size", "geekos MB/s", "host MB/s");
+    for (op = 0; op < NUM_OPS; ++op) {
+	memset(s_dst, 0, sizeof(s_dst));
+	memset(s_ref, 0, sizeof(s_ref));
+	for (size = 8; size <= MAX_SIZE; size *= 2) {
+	    printf("%-8s %8lu %12.0f %12.0f\n", s_opNames[op], (unsigned long) size,
+		Time_Op(op, size, 0), Time_Op(op, size, 1));
+	}
+    }
+    return 0;
+}
@@ -13,27 +13,25 @@
 #include <process.h>
 #include <fileio.h>
 
+/* Most to move from stdin in one call */
+#define CHUNK_SIZE (64 * 1024)
+
 int main(int argc, char *argv[])
 {
     int i;
     int ret;
-    int read;
+    int copied;
     int inFd;
     struct VFS_File_Stat stat;
-    char buffer[1024];
 
     if (argc == 1) {
 	/* Just copy stdin to stdout */
 	do {
-	    ret = Read(0, buffer, sizeof(buffer));
+	    ret = Splice(0, 1, CHUNK_SIZE);
 	    if (ret < 0) {
-		Print("Error: Could not read from stdin: %s\n", Get_Error_String(ret));
+		Print("Error: Could not copy stdin: %s\n", Get_Error_String(ret));
 		break;
 	    }
-
-	    if (ret > 0) {
-		Write(1, buffer, ret);
-	    }
 	} while (ret != 0);
 
 	return !(ret == 0);
@@ -59,20 +57,15 @@ int main(int argc, char *argv[])
 	    Exit(1);
 	}
 
-	for (read =0; read < stat.size; read += ret) {
-	    int rc;
-            ret = Read(inFd, buffer, sizeof(buffer));
+	/* Have the kernel copy the file straight to stdout */
+	for (copied = 0; copied < stat.size; copied += ret) {
+            ret = Splice(inFd, 1, stat.size - copied);
 	    if (ret < 0) {
-		Print("error reading file for copy: %s\n", Get_Error_String(ret));
-		Exit(1);
-	    }
-
-	    buffer[ret] = '\0';
-	    rc = Write(1, buffer, ret);
-	    if (rc < 0) {
-		Print("Could not write to stdout: %s\n", Get_Error_String(rc));
+		Print("Could not copy to stdout: %s\n", Get_Error_String(ret));
 		Exit(1);
 	    }
+	    if (ret == 0)
+		break;
 	}
 
 	Close(inFd);
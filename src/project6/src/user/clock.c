@@ -0,0 +1,87 @@
+/*
+ * Check the monotonic clock: it should never go backwards,
+ * should resolve well below a tick, and should agree with
+ * the tick count over a longer interval.  Also report what the
+ * clock and pid queries cost, compared with a null system call;
+ * libc answers them from the kernel's shared data pages.
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <conio.h>
+#include <process.h>
+#include <sched.h>
+
+#define NUM_READS 1000
+#define NUM_CALLS 100000
+
+enum { CALL_NULL, CALL_TIME_OF_DAY, CALL_PID, CALL_MONOTONIC };
+
+/*
+ * Average cost of given call, in nanoseconds.
+ */
+static unsigned long Time_Calls(int which)
+{
+    unsigned long long start, end, ns;
+    int i;
+
+    Get_Monotonic_Time(&start);
+    for (i = 0; i < NUM_CALLS; ++i) {
+	switch (which) {
+	case CALL_NULL: Null(); break;
+	case CALL_TIME_OF_DAY: Get_Time_Of_Day(); break;
+	case CALL_PID: Get_PID(); break;
+	case CALL_MONOTONIC: Get_Monotonic_Time(&ns); break;
+	}
+    }
+    Get_Monotonic_Time(&end);
+    return (unsigned long) (end - start) / NUM_CALLS;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long long prev, now, start;
+    unsigned long delta, minDelta = 0xffffffff;
+    int i, backwards = 0, startTicks, ticks;
+
+    if (Get_Monotonic_Time(&prev) != 0) {
+	Print("Could not read the monotonic clock\n");
+	return 1;
+    }
+
+    /* Back to back reads: resolution and system call cost */
+    start = prev;
+    for (i = 0; i < NUM_READS; ++i) {
+	Get_Monotonic_Time(&now);
+	if (now < prev)
+	    ++backwards;
+	else {
+	    delta = (unsigned long) (now - prev);
+	    if (delta > 0 && delta < minDelta)
+		minDelta = delta;
+	}
+	prev = now;
+    }
+    Print("%d reads in %lu ns, smallest step %lu ns, %d went backwards\n",
+	NUM_READS, (unsigned long) (now - start), minDelta, backwards);
+
+    /* Compare against the tick count across several ticks */
+    startTicks = Get_Time_Of_Day();
+    while (Get_Time_Of_Day() == startTicks)
+	;
+    Get_Monotonic_Time(&start);
+    startTicks = Get_Time_Of_Day();
+    while ((ticks = Get_Time_Of_Day() - startTicks) < 50)
+	;
+    Get_Monotonic_Time(&now);
+    Print("%d ticks took %lu ns\n", ticks, (unsigned long) (now - start));
+
+    Print("Per call: Null() %lu ns, Get_Time_Of_Day() %lu ns, Get_PID() %lu ns, "
+	"Get_Monotonic_Time() %lu ns\n",
+	Time_Calls(CALL_NULL), Time_Calls(CALL_TIME_OF_DAY),
+	Time_Calls(CALL_PID), Time_Calls(CALL_MONOTONIC));
+
+    return backwards == 0 ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+/*
+ * copydir - Copy the small files in a directory, either with one
+ * system call per operation or batched through an IO_Ring, and
+ * report how long it took and how many traps were made.
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <geekos/errno.h>
+#include <conio.h>
+#include <fileio.h>
+#include <process.h>
+#include <sched.h>
+#include <string.h>
+
+#define MAX_FILES	64
+#define SMALL_FILE_MAX	4096
+#define BATCH		(IO_RING_ENTRIES / 2)	 /* two fds per file */
+
+struct Small_File {
+    char src[VFS_MAX_PATH_LEN + 1];
+    char dst[VFS_MAX_PATH_LEN + 1];
+    int size;
+    int inFd, outFd;
+};
+
+static struct Small_File s_files[MAX_FILES];
+static int s_numFiles;
+static char s_buffers[BATCH][SMALL_FILE_MAX];
+static struct IO_Ring s_ring;
+static int s_numTraps;
+
+static int Find_Files(const char *srcDir, const char *dstDir)
+{
+    struct VFS_Dir_Entry entry;
+    int fd, rc;
+
+    fd = Open_Directory(srcDir);
+    if (fd < 0)
+	return fd;
+
+    while (s_numFiles < MAX_FILES && (rc = Read_Entry(fd, &entry)) == 0) {
+	struct Small_File *file = &s_files[s_numFiles];
+
+	if (entry.stats.isDirectory || entry.stats.size > SMALL_FILE_MAX)
+	    continue;
+	if (strlen(srcDir) + strlen(entry.name) + 1 > VFS_MAX_PATH_LEN ||
+	    strlen(dstDir) + strlen(entry.name) + 1 > VFS_MAX_PATH_LEN)
+	    continue;
+
+	strcpy(file->src, srcDir);
+	strcat(file->src, "/");
+	strcat(file->src, entry.name);
+	strcpy(file->dst, dstDir);
+	strcat(file->dst, "/");
+	strcat(file->dst, entry.name);
+	file->size = entry.stats.size;
+	++s_numFiles;
+    }
+
+    Close(fd);
+    return 0;
+}
+
+static void Copy_Plain(void)
+{
+    int i, n;
+
+    for (i = 0; i < s_numFiles; ++i) {
+	struct Small_File *file = &s_files[i];
+
+	file->inFd = Open(file->src, O_READ);
+	file->outFd = Open(file->dst, O_WRITE | O_CREATE);
+	s_numTraps += 2;
+	if (file->inFd >= 0 && file->outFd >= 0) {
+	    n = Read(file->inFd, s_buffers[0], file->size);
+	    if (n > 0)
+		Write(file->outFd, s_buffers[0], n);
+	    s_numTraps += 2;
+	}
+	if (file->inFd >= 0) {
+	    Close(file->inFd);
+	    ++s_numTraps;
+	}
+	if (file->outFd >= 0) {
+	    Close(file->outFd);
+	    ++s_numTraps;
+	}
+    }
+}
+
+/*
+ * Run everything queued on the ring.
+ * Completions carry the file index times 2, plus 1 for the output file.
+ * Returns false if the ring reported an error.
+ */
+static bool Run_Ring(int *results)
+{
+    struct IO_Ring_CQE cqe;
+    int rc;
+
+    while (s_ring.indices.sqHead != s_ring.indices.sqTail) {
+	rc = IO_Ring_Enter(&s_ring);
+	++s_numTraps;
+	if (rc < 0) {
+	    Print("IO_Ring_Enter failed: %s\n", Get_Error_String(rc));
+	    return false;
+	}
+	while (IO_Ring_Get_Completion(&s_ring, &cqe))
+	    results[cqe.userData] = cqe.result;
+    }
+    return true;
+}
+
+static void Copy_Ring(void)
+{
+    int results[BATCH * 2];
+    int first, count, i;
+
+    IO_Ring_Init(&s_ring);
+
+    for (first = 0; first < s_numFiles; first += count) {
+	count = s_numFiles - first;
+	if (count > BATCH)
+	    count = BATCH;
+
+	/* Open all the files in the batch */
+	for (i = 0; i < count; ++i) {
+	    IO_Ring_Prep_Open(&s_ring, s_files[first + i].src, O_READ, i * 2);
+	    IO_Ring_Prep_Open(&s_ring, s_files[first + i].dst, O_WRITE | O_CREATE, i * 2 + 1);
+	}
+	if (!Run_Ring(results))
+	    return;
+	for (i = 0; i < count; ++i) {
+	    s_files[first + i].inFd = results[i * 2];
+	    s_files[first + i].outFd = results[i * 2 + 1];
+	}
+
+	/* Read them */
+	for (i = 0; i < count; ++i) {
+	    struct Small_File *file = &s_files[first + i];
+	    results[i * 2] = -1;
+	    if (file->inFd >= 0 && file->outFd >= 0)
+		IO_Ring_Prep_Read(&s_ring, file->inFd, s_buffers[i], file->size, i * 2);
+	}
+	if (!Run_Ring(results))
+	    return;
+
+	/* Write them */
+	for (i = 0; i < count; ++i) {
+	    if (results[i * 2] > 0)
+		IO_Ring_Prep_Write(&s_ring, s_files[first + i].outFd, s_buffers[i],
+		    results[i * 2], i * 2 + 1);
+	}
+	if (!Run_Ring(results))
+	    return;
+
+	/* Close them */
+	for (i = 0; i < count; ++i) {
+	    struct Small_File *file = &s_files[first + i];
+	    if (file->inFd >= 0)
+		IO_Ring_Prep_Close(&s_ring, file->inFd, i * 2);
+	    if (file->outFd >= 0)
+		IO_Ring_Prep_Close(&s_ring, file->outFd, i * 2 + 1);
+	}
+	if (!Run_Ring(results))
+	    return;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long long start, end;
+    int useRing = 0, rc;
+
+    if (argc == 4 && strcmp(argv[1], "ring") == 0) {
+	useRing = 1;
+	--argc;
+	++argv;
+    }
+    if (argc != 3) {
+	Print("usage: copydir [ring] <srcdir> <dstdir>\n");
+	return 1;
+    }
+
+    rc = Find_Files(argv[1], argv[2]);
+    if (rc < 0) {
+	Print("Error: could not read %s: %s\n", argv[1], Get_Error_String(rc));
+	return 1;
+    }
+    rc = Create_Directory(argv[2]);
+    if (rc < 0 && rc != EEXIST) {
+	Print("Error: could not create %s: %s\n", argv[2], Get_Error_String(rc));
+	return 1;
+    }
+
+    Get_Monotonic_Time(&start);
+    if (useRing)
+	Copy_Ring();
+    else
+	Copy_Plain();
+    Get_Monotonic_Time(&end);
+
+    Print("Copied %d files %s: %lu us, %d system calls\n",
+	s_numFiles, useRing ? "through the ring" : "one call at a time",
+	(unsigned long) (end - start) / 1000, s_numTraps);
+    return 0;
+}
@@ -9,18 +9,24 @@
  * redistribute, and modify it as specified in the file "COPYING".
  */
 
+#include <geekos/cpu.h>
 #include <conio.h>
 #include <process.h>
 #include <fileio.h>
+#include <sched.h>
+
+/* Report throughput when copying at least this much */
+#define REPORT_SIZE (1024 * 1024)
 
 int main(int argc, char *argv[])
 {
     int ret;
-    int read;
+    int copied;
     int inFd;
     int outFd;
     struct VFS_File_Stat stat;
-    char buffer[1024];
+    unsigned long long start, end;
+    unsigned long us;
 
     if (argc != 3) {
         Print("usage: cp <file1> <file2>\n");
@@ -50,22 +56,27 @@ int main(int argc, char *argv[])
 	Exit(1);
     }
 
-    for (read =0; read < stat.size; read += ret) {
-        ret = Read(inFd, buffer, sizeof(buffer));
+    /* The kernel moves the data, without copying it through us */
+    Get_Monotonic_Time(&start);
+    for (copied = 0; copied < stat.size; copied += ret) {
+        ret = Splice(inFd, outFd, stat.size - copied);
 	if (ret < 0) {
-	    Print("Error reading file for copy: %s\n", Get_Error_String(ret));
-	    Exit(1);
-	}
-
-	ret = Write(outFd, buffer, ret);
-	if (ret < 0) {
-	    Print("Error writing file for copy: %s\n", Get_Error_String(ret));
+	    Print("Error copying file: %s\n", Get_Error_String(ret));
 	    Exit(1);
 	}
+	if (ret == 0)
+	    break;
     }
+    Get_Monotonic_Time(&end);
 
     Close(inFd);
     Close(outFd);
 
+    if (copied >= REPORT_SIZE) {
+	us = (unsigned long) Div_64_32(end - start, 1000);
+	Print("%d bytes in %lu ms, %lu KB/s\n", copied, us / 1000,
+	    us > 0 ? (unsigned long) Div_64_32((unsigned long long) copied * 1000000 / 1024, us) : 0);
+    }
+
     return 0;
 }
@@ -0,0 +1,54 @@
+/*
+ * Print kernel heap statistics: pages held, bytes in use, and
+ * how full each size class's slabs are.
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <conio.h>
+#include <process.h>
+
+#define PAGE_SIZE 4096
+
+int main(int argc, char **argv)
+{
+    struct Heap_Stats stats;
+    unsigned long heapBytes, slabBytes = 0, slabUsed = 0;
+    int i;
+
+    if (Get_Heap_Stats(&stats) != 0) {
+	Print("Could not get heap statistics\n");
+	return 1;
+    }
+
+    heapBytes = stats.heapPages * PAGE_SIZE;
+    Print("heap: %lu pages (peak %lu), %lu bytes in use (peak %lu)\n",
+	stats.heapPages, stats.peakHeapPages, stats.bytesInUse, stats.peakBytesInUse);
+    Print("heap: %lu large allocations in %lu pages\n", stats.largeAllocs, stats.largePages);
+    Print("heap: %lu mallocs, %lu frees, %lu failed\n",
+	stats.mallocCalls, stats.freeCalls, stats.failedCalls);
+
+    Print("class  pages  in use   peak  full\n");
+    for (i = 0; i < HEAP_NUM_CLASSES; ++i) {
+	struct Heap_Class_Stats *c = &stats.classes[i];
+	unsigned long bytes = c->slabPages * PAGE_SIZE;
+	unsigned long used = c->objectsInUse * c->objectSize;
+
+	if (c->slabPages == 0 && c->peakObjects == 0)
+	    continue;
+	Print("%5lu %6lu %7lu %6lu %4lu%%\n", c->objectSize, c->slabPages,
+	    c->objectsInUse, c->peakObjects, bytes > 0 ? used * 100 / bytes : 0);
+	slabBytes += bytes;
+	slabUsed += used;
+    }
+
+    /* Space held by the heap but not handed out */
+    if (heapBytes > 0)
+	Print("fragmentation: %lu%% of heap unused (slabs %lu%%)\n",
+	    (heapBytes - stats.bytesInUse) * 100 / heapBytes,
+	    slabBytes > 0 ? (slabBytes - slabUsed) * 100 / slabBytes : 0);
+
+    return 0;
+}
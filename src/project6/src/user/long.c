@@ -18,6 +18,7 @@ int main(int argc, char **argv)
   elapsed = Get_Time_Of_Day() - start;
   P (scr_sem) ;
   Print("Process Long is done at time: %d\n", elapsed) ;
+  Print_Process_Times("Long");
   V(scr_sem);
 
 
@@ -0,0 +1,110 @@
+/*
+ * Allocation throughput benchmark for the user mode heap.
+ * Keeps a working set of blocks of mixed sizes, repeatedly
+ * freeing a random one and allocating a replacement, and checks
+ * that the blocks don't overlap by filling each with a pattern.
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <conio.h>
+#include <string.h>
+#include <sched.h>
+#include <process.h>
+#include <malloc.h>
+
+#define NUM_SLOTS	1024
+#define NUM_OPS		200000
+
+static char *s_blocks[NUM_SLOTS];
+static unsigned long s_sizes[NUM_SLOTS];
+static unsigned long s_seed = 1;
+
+static unsigned long Random(void)
+{
+    s_seed = s_seed * 1103515245 + 12345;
+    return (s_seed >> 16) & 0x7fff;
+}
+
+/*
+ * Mostly small blocks, with the occasional large one.
+ */
+static unsigned long Random_Size(int maxLarge)
+{
+    unsigned long r = Random();
+
+    if (maxLarge > 0 && r % 64 == 0)
+	return 4096 + Random() % maxLarge;
+    return 1 + r % 256;
+}
+
+/*
+ * Run given number of free/allocate pairs over the working set.
+ * Returns the number of corrupted blocks found.
+ */
+static int Churn(int numOps, int maxLarge, unsigned long *ns)
+{
+    unsigned long long start, end;
+    int i, errors = 0;
+
+    Get_Monotonic_Time(&start);
+    for (i = 0; i < numOps; ++i) {
+	int slot = Random() % NUM_SLOTS;
+
+	if (s_blocks[slot] != 0) {
+	    if (s_blocks[slot][0] != (char) slot ||
+		s_blocks[slot][s_sizes[slot] - 1] != (char) slot)
+		++errors;
+	    Free(s_blocks[slot]);
+	}
+	s_sizes[slot] = Random_Size(maxLarge);
+	s_blocks[slot] = Malloc(s_sizes[slot]);
+	if (s_blocks[slot] == 0) {
+	    Print("Malloc(%lu) failed\n", s_sizes[slot]);
+	    ++errors;
+	    break;
+	}
+	s_blocks[slot][0] = (char) slot;
+	s_blocks[slot][s_sizes[slot] - 1] = (char) slot;
+    }
+    Get_Monotonic_Time(&end);
+
+    *ns = (unsigned long) (end - start);
+    return errors;
+}
+
+/*
+ * Free the whole working set.
+ */
+static void Free_All(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_SLOTS; ++i) {
+	Free(s_blocks[i]);
+	s_blocks[i] = 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long ns, heapEnd;
+    int errors;
+
+    errors = Churn(NUM_OPS, 0, &ns);
+    Print("small blocks: %d pairs in %lu us, %lu ns per Malloc/Free\n",
+	NUM_OPS, ns / 1000, ns / NUM_OPS);
+    Free_All();
+
+    errors += Churn(NUM_OPS, 60000, &ns);
+    Print("mixed blocks: %d pairs in %lu us, %lu ns per Malloc/Free\n",
+	NUM_OPS, ns / 1000, ns / NUM_OPS);
+    heapEnd = Brk(0);
+    Free_All();
+
+    Print("heap end %lx while in use, %lx after freeing\n", heapEnd, (unsigned long) Brk(0));
+    Print("%d errors\n", errors);
+    return errors != 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * Print swap statistics: how many pages went to the compressed
+ * pool and to the paging file, how well they compressed, how
+ * long faults on each tier took to service, and how often a
+ * pre-zeroed page was ready when one was wanted.
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <conio.h>
+#include <process.h>
+
+int main(int argc, char **argv)
+{
+    if (Print_Paging_Stats() != 0) {
+	Print("Could not get paging statistics\n");
+	return 1;
+    }
+    return 0;
+}
@@ -10,6 +10,8 @@ int main(int argc , char ** argv)
   int scr_sem; 		/* id of screen semaphore */
   int time; 		/* current and start time */
   int ping,pong;	/* id of semaphores to sync processes b & c */
+  unsigned long long before, after;
+  unsigned long wait, maxWait = 0;	/* time spent waiting for the other process */
 
   time = Get_Time_Of_Day();
   scr_sem = Create_Semaphore ("screen" , 1) ;   /* register for screen use */
@@ -17,7 +19,11 @@ int main(int argc , char ** argv)
   pong = Create_Semaphore ("pong" , 0) ;  
 
   for (i=0; i < 5; i++) {
+       Get_Monotonic_Time(&before);
        P(pong);
+       Get_Monotonic_Time(&after);
+       wait = (unsigned long) (after - before);
+       if (wait > maxWait) maxWait = wait;
        for (j=0; j < 35; j++);
        V(ping);
   }
@@ -25,6 +31,8 @@ int main(int argc , char ** argv)
   time = Get_Time_Of_Day() - time;
   P (scr_sem) ;
   Print ("Process Ping is done at time: %d\n", time) ;
+  Print ("Process Ping waited at most %lu us for its partner\n", maxWait / 1000) ;
+  Print_Process_Times("Ping");
   V(scr_sem);
 
   Destroy_Semaphore(pong);
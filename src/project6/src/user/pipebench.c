@@ -0,0 +1,144 @@
+/*
+ * Pipe benchmarks: throughput to a child process reading a pipe,
+ * for a range of write sizes, and round trip latency of one byte
+ * messages bounced off a child through a pair of pipes.
+ * The child is another copy of this program, run as
+ * "pipebench -sink" or "pipebench -echo".
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <geekos/cpu.h>
+#include <conio.h>
+#include <fileio.h>
+#include <process.h>
+#include <sched.h>
+#include <string.h>
+
+#define PATH "/c:/a"
+#define TOTAL_BYTES (4 * 1024 * 1024)
+#define MAX_CHUNK (64 * 1024)
+#define NUM_ROUND_TRIPS 1000
+
+static char s_buf[MAX_CHUNK];
+
+static const unsigned long s_chunkSizes[] = { 64, 512, 4096, 16384, 65536 };
+#define NUM_CHUNK_SIZES (sizeof(s_chunkSizes) / sizeof(s_chunkSizes[0]))
+
+/*
+ * Read standard input until end of file, optionally writing
+ * everything back to standard output.
+ */
+static int Child(bool echo)
+{
+    int n;
+
+    while ((n = Read(0, s_buf, sizeof(s_buf))) > 0) {
+	if (echo && Write(1, s_buf, n) != n)
+	    return 1;
+    }
+    return n < 0;
+}
+
+/*
+ * Time writing TOTAL_BYTES into a pipe in chunks of given size,
+ * until the reading child has got all of it.
+ * Returns elapsed time in microseconds, or 0 on error.
+ */
+static unsigned long Time_Throughput(unsigned long chunk)
+{
+    unsigned long long start, end;
+    unsigned long done;
+    int readfd, writefd, pid;
+
+    if (Create_Pipe(&readfd, &writefd) != 0)
+	return 0;
+    pid = Spawn_With_Path("pipebench", "pipebench -sink", readfd, 1, PATH);
+    Close(readfd);
+    if (pid < 0) {
+	Close(writefd);
+	return 0;
+    }
+
+    Get_Monotonic_Time(&start);
+    for (done = 0; done < TOTAL_BYTES; done += chunk) {
+	if (Write(writefd, s_buf, chunk) != (int) chunk)
+	    break;
+    }
+    Close(writefd);
+    Wait(pid);
+    Get_Monotonic_Time(&end);
+
+    return done < TOTAL_BYTES ? 0 : (unsigned long) Div_64_32(end - start, 1000);
+}
+
+/*
+ * Time round trips of a byte through an echoing child.
+ * Returns average round trip time in nanoseconds, or 0 on error.
+ */
+static unsigned long Time_Ping_Pong(void)
+{
+    unsigned long long start, end;
+    int toChild[2], fromChild[2], pid, i;
+    char c = 'x';
+
+    if (Create_Pipe(&toChild[0], &toChild[1]) != 0)
+	return 0;
+    if (Create_Pipe(&fromChild[0], &fromChild[1]) != 0) {
+	Close(toChild[0]);
+	Close(toChild[1]);
+	return 0;
+    }
+    pid = Spawn_With_Path("pipebench", "pipebench -echo", toChild[0], fromChild[1], PATH);
+    Close(toChild[0]);
+    Close(fromChild[1]);
+    if (pid < 0) {
+	Close(toChild[1]);
+	Close(fromChild[0]);
+	return 0;
+    }
+
+    Get_Monotonic_Time(&start);
+    for (i = 0; i < NUM_ROUND_TRIPS; ++i) {
+	if (Write(toChild[1], &c, 1) != 1 || Read(fromChild[0], &c, 1) != 1)
+	    break;
+    }
+    Get_Monotonic_Time(&end);
+
+    Close(toChild[1]);
+    Close(fromChild[0]);
+    Wait(pid);
+
+    return i < NUM_ROUND_TRIPS ? 0 : (unsigned long) Div_64_32(end - start, NUM_ROUND_TRIPS);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long i, us, ns;
+
+    if (argc > 1 && strcmp(argv[1], "-sink") == 0)
+	return Child(false);
+    if (argc > 1 && strcmp(argv[1], "-echo") == 0)
+	return Child(true);
+
+    Print("write size   KB/s\n");
+    for (i = 0; i < NUM_CHUNK_SIZES; ++i) {
+	us = Time_Throughput(s_chunkSizes[i]);
+	if (us == 0) {
+	    Print("%10lu   failed\n", s_chunkSizes[i]);
+	    continue;
+	}
+	Print("%10lu %6lu\n", s_chunkSizes[i],
+	    (unsigned long) Div_64_32((unsigned long long) (TOTAL_BYTES / 1024) * 1000000, us));
+    }
+
+    ns = Time_Ping_Pong();
+    if (ns == 0)
+	Print("ping-pong failed\n");
+    else
+	Print("ping-pong: %lu ns per round trip\n", ns);
+
+    return 0;
+}
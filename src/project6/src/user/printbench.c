@@ -0,0 +1,52 @@
+/*
+ * Console output throughput: print many short lines with each
+ * of the libc output buffering modes, and report how long each
+ * took once all the output is done.
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <geekos/cpu.h>
+#include <conio.h>
+#include <sched.h>
+
+#define NUM_LINES 100000
+
+static const char *s_modeNames[] = { "unbuffered", "line buffered", "fully buffered" };
+
+/*
+ * Print the lines in given buffering mode.
+ * Returns elapsed time in microseconds.
+ */
+static unsigned long Print_Lines(int mode)
+{
+    unsigned long long start, end;
+    int i;
+
+    Set_Output_Buffering(mode);
+    Get_Monotonic_Time(&start);
+    for (i = 0; i < NUM_LINES; ++i)
+	Print("%s line %d\n", s_modeNames[mode], i);
+    Flush_Output();
+    Get_Monotonic_Time(&end);
+
+    return (unsigned long) Div_64_32(end - start, 1000);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long us[3];
+    int mode;
+
+    for (mode = OUTPUT_UNBUFFERED; mode <= OUTPUT_FULLY_BUFFERED; ++mode)
+	us[mode] = Print_Lines(mode);
+
+    Set_Output_Buffering(OUTPUT_LINE_BUFFERED);
+    for (mode = OUTPUT_UNBUFFERED; mode <= OUTPUT_FULLY_BUFFERED; ++mode) {
+	Print("%-15s %d lines in %lu ms, %lu lines/s\n", s_modeNames[mode], NUM_LINES,
+	    us[mode] / 1000, us[mode] > 0 ? (unsigned long) Div_64_32(NUM_LINES * 1000000ULL, us[mode]) : 0);
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Random access read benchmarks: read randomly chosen blocks of
+ * a file with Seek() and Read(), then with Read_At(); and gather
+ * runs of blocks into separate buffers with one Read() each, then
+ * with Read_Vector().  Reports the system calls and time each took.
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <geekos/cpu.h>
+#include <geekos/errno.h>
+#include <conio.h>
+#include <fileio.h>
+#include <sched.h>
+
+#define DEFAULT_FILE "/c/shell.exe"
+#define BLOCK_SIZE 512
+#define NUM_READS 4000
+#define GATHER_BLOCKS 8
+
+static char s_blocks[GATHER_BLOCKS][BLOCK_SIZE];
+
+static unsigned long s_seed = 1;
+
+static unsigned long Random(void)
+{
+    s_seed = s_seed * 1103515245 + 12345;
+    return (s_seed >> 16) & 0x7fff;
+}
+
+/* Time and system calls taken by one pass */
+struct Result {
+    const char *name;
+    unsigned long syscalls;
+    unsigned long us;
+    int error;			/* 0, or error code of the call that failed */
+};
+
+static unsigned long long s_start;
+
+static void Start(struct Result *result, const char *name)
+{
+    result->name = name;
+    result->syscalls = 0;
+    result->error = 0;
+    s_seed = 1;
+    Get_Monotonic_Time(&s_start);
+}
+
+static void Finish(struct Result *result)
+{
+    unsigned long long end;
+
+    Get_Monotonic_Time(&end);
+    result->us = (unsigned long) Div_64_32(end - s_start, 1000);
+}
+
+/* Record the first call that didn't return what was expected */
+static void Check(struct Result *result, int rc, int expected)
+{
+    if (rc != expected && result->error == 0)
+	result->error = rc < 0 ? rc : EIO;	/* short read */
+}
+
+static void Seek_Then_Read(int fd, unsigned long numBlocks, struct Result *result)
+{
+    int i;
+
+    Start(result, "Seek + Read");
+    for (i = 0; i < NUM_READS && result->error == 0; ++i) {
+	unsigned long block = Random() % numBlocks;
+	result->syscalls += 2;
+	Check(result, Seek(fd, block * BLOCK_SIZE), 0);
+	Check(result, Read(fd, s_blocks[0], BLOCK_SIZE), BLOCK_SIZE);
+    }
+    Finish(result);
+}
+
+static void Positional_Read(int fd, unsigned long numBlocks, struct Result *result)
+{
+    int i;
+
+    Start(result, "Read_At");
+    for (i = 0; i < NUM_READS && result->error == 0; ++i) {
+	unsigned long block = Random() % numBlocks;
+	result->syscalls += 1;
+	Check(result, Read_At(fd, block * BLOCK_SIZE, s_blocks[0], BLOCK_SIZE), BLOCK_SIZE);
+    }
+    Finish(result);
+}
+
+static void Gather_With_Read(int fd, unsigned long numBlocks, struct Result *result)
+{
+    int i, j;
+
+    Start(result, "Seek + Read x8");
+    for (i = 0; i < NUM_READS / GATHER_BLOCKS && result->error == 0; ++i) {
+	unsigned long block = Random() % (numBlocks - GATHER_BLOCKS + 1);
+	result->syscalls += 1 + GATHER_BLOCKS;
+	Check(result, Seek(fd, block * BLOCK_SIZE), 0);
+	for (j = 0; j < GATHER_BLOCKS; ++j)
+	    Check(result, Read(fd, s_blocks[j], BLOCK_SIZE), BLOCK_SIZE);
+    }
+    Finish(result);
+}
+
+static void Gather_With_Read_Vector(int fd, unsigned long numBlocks, struct Result *result)
+{
+    struct IO_Vector vec[GATHER_BLOCKS];
+    int i;
+
+    for (i = 0; i < GATHER_BLOCKS; ++i) {
+	vec[i].buf = s_blocks[i];
+	vec[i].len = BLOCK_SIZE;
+    }
+
+    Start(result, "Seek + Read_Vector");
+    for (i = 0; i < NUM_READS / GATHER_BLOCKS && result->error == 0; ++i) {
+	unsigned long block = Random() % (numBlocks - GATHER_BLOCKS + 1);
+	result->syscalls += 2;
+	Check(result, Seek(fd, block * BLOCK_SIZE), 0);
+	Check(result, Read_Vector(fd, vec, GATHER_BLOCKS), GATHER_BLOCKS * BLOCK_SIZE);
+    }
+    Finish(result);
+}
+
+static void Print_Result(const struct Result *result)
+{
+    if (result->error != 0)
+	Print("%-20s failed: %s\n", result->name, Get_Error_String(result->error));
+    else
+	Print("%-20s %6lu syscalls %6lu ms\n", result->name, result->syscalls, result->us / 1000);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : DEFAULT_FILE;
+    struct VFS_File_Stat stat;
+    struct Result result;
+    unsigned long numBlocks;
+    int fd, rc;
+
+    fd = Open(path, O_READ);
+    if (fd < 0) {
+	Print("Could not open %s: %s\n", path, Get_Error_String(fd));
+	return 1;
+    }
+    if ((rc = FStat(fd, &stat)) != 0) {
+	Print("Could not stat %s: %s\n", path, Get_Error_String(rc));
+	return 1;
+    }
+    numBlocks = stat.size / BLOCK_SIZE;
+    if (numBlocks < GATHER_BLOCKS) {
+	Print("%s is too small; need at least %d bytes\n", path, GATHER_BLOCKS * BLOCK_SIZE);
+	return 1;
+    }
+
+    Print("%d random %d byte reads from %s:\n", NUM_READS, BLOCK_SIZE, path);
+    Seek_Then_Read(fd, numBlocks, &result);
+    Print_Result(&result);
+    Positional_Read(fd, numBlocks, &result);
+    Print_Result(&result);
+
+    Print("%d random runs of %d blocks into separate buffers:\n",
+	NUM_READS / GATHER_BLOCKS, GATHER_BLOCKS);
+    Gather_With_Read(fd, numBlocks, &result);
+    Print_Result(&result);
+    Gather_With_Read_Vector(fd, numBlocks, &result);
+    Print_Result(&result);
+
+    Close(fd);
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Check that sleeping processes use (almost) no CPU time.
+ * Measures how fast a busy loop runs on its own, then again
+ * while 50 child processes wait out a timeout, either in Sleep()
+ * or, with the "poll" argument, by polling the clock.
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <conio.h>
+#include <process.h>
+#include <sched.h>
+#include <string.h>
+
+#define NUM_SLEEPERS	50
+#define SLEEP_US	20000	 /* per nap */
+#define NUM_NAPS	100
+#define MEASURE_TICKS	100
+
+/*
+ * Count busy loop iterations over a fixed number of ticks.
+ */
+static unsigned long Busy_Loop(void)
+{
+    unsigned long count = 0;
+    int start = Get_Time_Of_Day();
+
+    while (Get_Time_Of_Day() - start < MEASURE_TICKS)
+	++count;
+    return count;
+}
+
+static void Nap(int poll)
+{
+    unsigned long long start, now;
+
+    if (!poll) {
+	Sleep(SLEEP_US);
+	return;
+    }
+
+    Get_Monotonic_Time(&start);
+    do
+	Get_Monotonic_Time(&now);
+    while (now - start < SLEEP_US * 1000ULL);
+}
+
+int main(int argc, char **argv)
+{
+    int pids[NUM_SLEEPERS];
+    int i, poll = 0, numChildren = 0;
+    unsigned long alone, shared;
+
+    if (argc > 1 && strcmp(argv[1], "poll") == 0)
+	poll = 1;
+
+    if (argc > 2 && strcmp(argv[2], "child") == 0) {
+	for (i = 0; i < NUM_NAPS; ++i)
+	    Nap(poll);
+	return 0;
+    }
+
+    alone = Busy_Loop();
+
+    for (i = 0; i < NUM_SLEEPERS; ++i) {
+	pids[i] = Spawn_Program("/c/sleepers.exe",
+	    poll ? "/c/sleepers.exe poll child" : "/c/sleepers.exe sleep child", 0, 1);
+	if (pids[i] < 0) {
+	    Print("Could not spawn sleeper %d: %d\n", i, pids[i]);
+	    break;
+	}
+	++numChildren;
+    }
+
+    shared = Busy_Loop();
+
+    for (i = 0; i < numChildren; ++i)
+	Wait(pids[i]);
+
+    Print("%d %s children: busy loop ran at %lu%% of its solo speed\n",
+	numChildren, poll ? "polling" : "sleeping",
+	alone > 0 ? shared / (alone / 100 + 1) : 0);
+
+    return 0;
+}
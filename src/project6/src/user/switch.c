@@ -0,0 +1,110 @@
+/*
+ * Measure system call round trip and context switch latency.
+ * Null() is timed, in nanoseconds and TSC cycles, through both
+ * the int 0x90 and the sysenter entry paths, when the processor
+ * has sysenter.
+ * The context switch test bounces a pair of semaphores between
+ * this process and a child; each round trip is two switches.
+ * $Revision: 1.1 $
+ *
+ * This is free software.  You are permitted to use,
+ * redistribute, and modify it as specified in the file "COPYING".
+ */
+
+#include <conio.h>
+#include <geekos/syscall.h>
+#include <geekos/cpu.h>
+#include <process.h>
+#include <sched.h>
+#include <sema.h>
+#include <string.h>
+
+#define NUM_CALLS	100000
+#define NUM_ROUNDS	10000
+
+/* Average cost of one Null() system call */
+struct Call_Cost {
+    unsigned long ns;
+    unsigned long cycles;
+};
+
+static void Time_Null_Calls(const char *entry, struct Call_Cost *cost)
+{
+    unsigned long long start, end, startTSC = 0, endTSC = 0;
+    bool haveTSC = Has_TSC();
+    int i;
+
+    Get_Monotonic_Time(&start);
+    if (haveTSC)
+	startTSC = Read_TSC();
+    for (i = 0; i < NUM_CALLS; ++i)
+	Null();
+    if (haveTSC)
+	endTSC = Read_TSC();
+    Get_Monotonic_Time(&end);
+
+    cost->ns = (unsigned long) (end - start) / NUM_CALLS;
+    cost->cycles = (unsigned long) Div_64_32(endTSC - startTSC, NUM_CALLS);
+    if (haveTSC)
+	Print("Null system call (%s): %lu ns, %lu cycles\n", entry, cost->ns, cost->cycles);
+    else
+	Print("Null system call (%s): %lu ns\n", entry, cost->ns);
+}
+
+static void Bounce(int wait, int signal)
+{
+    int i;
+
+    for (i = 0; i < NUM_ROUNDS; ++i) {
+	P(wait);
+	V(signal);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct Call_Cost fast, slow;
+    unsigned long long start, end;
+    int i, ping, pong, pid;
+
+    ping = Create_Semaphore("switch-ping", 0);
+    pong = Create_Semaphore("switch-pong", 0);
+
+    if (argc > 1 && strcmp(argv[1], "child") == 0) {
+	Bounce(ping, pong);
+	return 0;
+    }
+
+    /* Null system calls, through each entry path */
+    if (g_useSysenter) {
+	Time_Null_Calls("sysenter", &fast);
+	g_useSysenter = 0;
+	Time_Null_Calls("int 0x90", &slow);
+	g_useSysenter = 1;
+	if (slow.cycles > fast.cycles)
+	    Print("sysenter saves %lu cycles per call\n", slow.cycles - fast.cycles);
+    } else
+	Time_Null_Calls("int 0x90", &slow);
+
+    pid = Spawn_Program("/c/switch.exe", "/c/switch.exe child", 0, 1);
+    if (pid < 0) {
+	Print("Could not spawn child: %d\n", pid);
+	return 1;
+    }
+
+    /* The child waits on ping first, so we start the ball rolling */
+    Get_Monotonic_Time(&start);
+    for (i = 0; i < NUM_ROUNDS; ++i) {
+	V(ping);
+	P(pong);
+    }
+    Get_Monotonic_Time(&end);
+    Print("Context switch: %lu ns\n",
+	(unsigned long) (end - start) / (NUM_ROUNDS * 2));
+
+    Wait(pid);
+    Destroy_Semaphore(pong);
+    Destroy_Semaphore(ping);
+
+    return 0;
+}
@@ -44,23 +44,25 @@ int main(int argc , char ** argv)
   int policy = -1;
   int start;
   int elapsed;
-  int quantum;
+  int quantum = 0;
   int scr_sem;			/* sid of screen semaphore */
   int id1, id2, id3;    	/* ID of child process */
 
   if (argc == 3) {
       if (!strcmp(argv[1], "rr")) {
-          policy = 0;
+          policy = SCHED_RR;
       } else if (!strcmp(argv[1], "mlf")) {
-          policy = 1;
+          policy = SCHED_MLF;
+      } else if (!strcmp(argv[1], "fair")) {
+          policy = SCHED_FAIR;
       } else {
-	  Print("usage: %s [rr|mlf] <quantum>\n", argv[0]);
+	  Print("usage: %s [rr|mlf|fair] <quantum>\n", argv[0]);
 	  Exit(1);
       }
       quantum = atoi(argv[2]);
       Set_Scheduling_Policy(policy, quantum);
   } else {
-      Print("usage: %s [rr|mlf] <quantum>\n", argv[0]);
+      Print("usage: %s [rr|mlf|fair] <quantum>\n", argv[0]);
       Exit(1);
   }
 
@@ -69,6 +71,7 @@ int main(int argc , char ** argv)
 
   P (scr_sem) ;
   Print ("************* Start Workload Generator *********\n");
+  Print ("Policy %s, quantum %d\n", argv[1], quantum);
   V (scr_sem) ;
 
   id1 = Spawn_Program ("/c/long.exe", "/c/long.exe"